@@ -0,0 +1,73 @@
+// Times the blur kernels behind Canvas::shadow and the shadow cache itself.
+//
+//   blur [--iterations n]
+//
+// Each case runs a fixed number of iterations after one warm up and prints the mean time and the
+// throughput, one line per case.
+
+#include "../src/ui/util/canvas.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+
+namespace {
+    template<typename F>
+    void run(char const* name, int w, int h, float sigma, int iterations, F&& f) {
+        f();
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < iterations; i++)
+            f();
+        double ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() / iterations;
+        std::printf("%-14s %5dx%-5d sigma %5.1f  %10.4f ms  %8.1f Mpx/s\n", name, w, h, sigma, ms, w * h / (ms * 1e3));
+    }
+}
+
+int main(int argc, char** argv)
+{
+    int iterations = 200;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--iterations") && i + 1 < argc) iterations = (std::max)(1, std::atoi(argv[++i]));
+    }
+
+#ifdef UI_BLUR_SSE2
+    std::printf("sse2\n");
+#else
+    std::printf("scalar\n");
+#endif
+
+    for (int size : { 64, 256, 1024 }) {
+        std::vector<uint8_t> src(size_t(size) * size), dst(src.size()), scratch;
+        for (size_t i = 0; i < src.size(); i++)
+            src[i] = uint8_t(i * 2654435761u >> 24);
+
+        for (float sigma : { 2.0f, 8.0f, 32.0f }) {
+            int radius = ui::box_radius(sigma);
+            run("box_blur_v", size, size, sigma, iterations, [&] { ui::box_blur_v(src.data(), dst.data(), size, size, size, radius); });
+            run("gaussian_blur", size, size, sigma, iterations, [&] {
+                dst = src;
+                ui::gaussian_blur(dst.data(), size, size, sigma, scratch);
+            });
+        }
+        run("transpose_8", size, size, 0.0f, iterations, [&] { ui::transpose_8(src.data(), dst.data(), size, size); });
+    }
+
+    // a miss renders the texture, a hit only records the rects
+    auto masks = std::make_shared<ui::ImageAtlas>(), images = std::make_shared<ui::ImageAtlas>();
+    ui::Canvas canvas(masks, images);
+    canvas.setViewport(0, 0, 1920, 1080);
+    run("shadow miss", 400, 300, 8.0f, iterations, [&] {
+        canvas.shadows.cache().clear();
+        canvas.shadow(100, 100, 400, 300, 8, 16, ui::color(0, 0, 0, 128));
+        canvas.clear();
+    });
+    run("shadow hit", 400, 300, 8.0f, iterations, [&] {
+        canvas.shadow(100, 100, 400, 300, 8, 16, ui::color(0, 0, 0, 128));
+        canvas.clear();
+    });
+    std::printf("%zu shadow textures rendered\n", canvas.shadows.renders());
+    return 0;
+}
@@ -0,0 +1,332 @@
+// Drives whole frames through a headless Backend over synthetic widget trees and reports how each
+// phase scales with the size of the tree.
+//
+//   macro [--scene name[,name...]] [--sizes n[,n...]] [--frames n] [--seconds s] [--size WxH]
+//         [--font path] [--idle]
+//
+// Scenes, sized by about n widgets (tree items for tree):
+//   deep    chains of alternating VLayout and HLayout 256 deep at most, a Label at the end of each
+//   fan     a VLayout of HLayout rows of BoxWidgets, sqrt(n) by sqrt(n)
+//   labels  a clipped VLayout of n Labels of fixed height, most of them outside the window
+//   tree    a Tree of sqrt(n) expanded groups of sqrt(n) items
+//   tabs    a Tab of n / 10 pages, each a VLayout of 8 Labels
+//
+// Scripted scenes replay an InputTrace through InputReplay, one frame per step on the backend's
+// manual clock, and run until the script ends or --seconds, ignoring --frames and --idle:
+//   splitter  an HSplitter of two VLayouts of n / 2 Labels, its handle dragged to a quarter of the
+//             window, across to three quarters and back
+//   scroll    a VScroll over a VLayout of n Labels of fixed height, 30 wheel notches down and 30 up
+//   reorder   the tabs scene, each of the first 8 headers dragged onto its right neighbour
+//
+// Every other frame moves the pointer across the window, unless --idle, then runs Backend::update and
+// takes the frame packets the way a renderer would. Runs stop after --frames frames or --seconds
+// seconds, whichever comes first. The output is JSON: per run the p50, p95 and p99 of each phase
+// and of the whole frame in milliseconds, and of the objects and bytes handed to the renderer,
+// one run per line so a run that falls over leaves the earlier ones readable. Bytes count objects
+// as the 24 byte PackedObject the renderer uploads. "widgets" counts widgets and "items" the Tree
+// items, which are not widgets, so the tree scene is one widget holding all of its items.
+
+#include "../src/ui/util/backend.hpp"
+#include "../src/ui/util/trace.hpp"
+#include "../src/ui/layout.hpp"
+#include "../src/ui/label.hpp"
+#include "../src/ui/tree.hpp"
+#include "../src/ui/tab.hpp"
+#include "../src/ui/scroll.hpp"
+#include "../src/ui/splitter.hpp"
+
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace {
+    constexpr int kMaxDepth = 256;
+
+    std::vector<std::string> split(char const* s) {
+        std::vector<std::string> out;
+        std::stringstream ss(s);
+        for (std::string item; std::getline(ss, item, ',');)
+            if (!item.empty())
+                out.push_back(item);
+        return out;
+    }
+
+    int count(ui::Widget* w) {
+        int n = 1;
+        for (auto& c : w->children())
+            n += count(c.get());
+        return n;
+    }
+
+    std::unique_ptr<ui::Widget> deep(int n) {
+        auto root = std::make_unique<ui::HLayout>();
+        int depth = std::clamp(n, 1, kMaxDepth);
+        for (int chain = 0; chain < (std::max)(1, n / depth); chain++) {
+            ui::Widget* w = root.get();
+            for (int d = 1; d < depth; d++)
+                w = d % 2 ? static_cast<ui::Widget*>(w->addChild<ui::VLayout>()) : static_cast<ui::Widget*>(w->addChild<ui::HLayout>());
+            w->addChild<ui::Label>("leaf " + std::to_string(chain));
+        }
+        return root;
+    }
+
+    std::unique_ptr<ui::Widget> fan(int n) {
+        auto root = std::make_unique<ui::VLayout>();
+        int side = (std::max)(1, int(std::lround(std::sqrt(double(n)))));
+        for (int r = 0; r < side; r++) {
+            auto row = root->addChild<ui::HLayout>();
+            for (int c = 0; c < side; c++)
+                row->addChild<ui::BoxWidget>();
+        }
+        return root;
+    }
+
+    std::unique_ptr<ui::Widget> labels(int n) {
+        auto root = std::make_unique<ui::VLayout>();
+        root->setClipsChildren(true);
+        for (int i = 0; i < n; i++)
+            root->addChild<ui::Label>("Label " + std::to_string(i))->setFixedH(24);
+        return root;
+    }
+
+    // Items are not widgets. addItem searches the whole tree for the parent, so each group gets its
+    // first item that way and the rest are appended in place.
+    std::unique_ptr<ui::Widget> tree(int n, int& items) {
+        auto root = std::make_unique<ui::Tree>("root");
+        int side = (std::max)(1, int(std::lround(std::sqrt(double(n)))));
+        for (int g = 0; g < side; g++)
+            root->addItem("root", "group " + std::to_string(g));
+        items = side;
+        for (int g = 0; g < side; g++) {
+            auto first = root->addItem("group " + std::to_string(g), "item " + std::to_string(g) + " 0");
+            ui::Tree::Item* group = first ? first->parent_ : nullptr;
+            if (!group)
+                continue;
+            group->expanded_ = true;
+            for (int i = 1; i < side; i++)
+                group->children_.emplace_back("item " + std::to_string(g) + " " + std::to_string(i), group);
+            items += side;
+        }
+        return root;
+    }
+
+    std::unique_ptr<ui::Widget> tabs(int n) {
+        auto root = std::make_unique<ui::Tab>();
+        for (int t = 0; t < (std::max)(1, n / 10); t++) {
+            auto page = root->addTab<ui::VLayout>("Tab " + std::to_string(t));
+            for (int i = 0; i < 8; i++)
+                page->addChild<ui::Label>("Row " + std::to_string(i));
+        }
+        return root;
+    }
+
+    std::unique_ptr<ui::Widget> splitter(int n) {
+        auto root = std::make_unique<ui::HSplitter>();
+        auto leading = root->setLeading<ui::VLayout>(), trailing = root->setTrailing<ui::VLayout>();
+        for (int i = 0; i < (std::max)(1, n / 2); i++) {
+            leading->addChild<ui::Label>("Left " + std::to_string(i));
+            trailing->addChild<ui::Label>("Right " + std::to_string(i));
+        }
+        return root;
+    }
+
+    std::unique_ptr<ui::Widget> scroll(int n) {
+        auto root = std::make_unique<ui::VScroll>();
+        auto list = root->addChild<ui::VLayout>();
+        for (int i = 0; i < n; i++)
+            list->addChild<ui::Label>("Row " + std::to_string(i))->setFixedH(24);
+        return root;
+    }
+
+    std::unique_ptr<ui::Widget> build(std::string const& scene, int n, int& items) {
+        items = 0;
+        if (scene == "splitter") return splitter(n);
+        if (scene == "scroll") return scroll(n);
+        if (scene == "reorder") return tabs(n);
+        if (scene == "deep") return deep(n);
+        if (scene == "fan") return fan(n);
+        if (scene == "labels") return labels(n);
+        if (scene == "tree") return tree(n, items);
+        if (scene == "tabs") return tabs(n);
+        return nullptr;
+    }
+
+    // The input a scripted scene replays, aimed at the laid out widgets. Empty for the other scenes.
+    ui::InputTrace script(std::string const& scene, ui::Widget* root) {
+        ui::InputTrace trace;
+        int id = root->id();
+        double time = 0.0;
+        if (scene == "splitter") {
+            // the handle sits right of the leading child, moves stay inside it a few pixels at a time
+            int x = root->child(0)->x() + root->child(0)->w() + 40, y = root->y() + root->h() / 2;
+            int quarter = root->w() / 4, steps = (std::max)(1, quarter / 8);
+            time = trace.drag(id, x, y, x - quarter, y, steps, time);
+            time = trace.drag(id, x - quarter, y, x + quarter, y, steps * 2, time + 0.1);
+            trace.drag(id, x + quarter, y, x, y, steps, time + 0.1);
+        }
+        else if (scene == "scroll") {
+            int x = root->x() + root->w() / 2, y = root->y() + root->h() / 2;
+            time = trace.wheel(id, x, y, -120, 30, time);
+            trace.wheel(id, x, y, 120, 30, time + 0.1);
+        }
+        else if (scene == "reorder") {
+            ui::Widget* headers = root->child(0);
+            int count = (std::min)(int(headers->children().size()), 8);
+            for (int i = 0; i + 1 < count; i++) {
+                auto [x0, y0] = headers->child(i)->rect().coord();
+                auto [x1, y1] = headers->child(i + 1)->rect().coord();
+                time = trace.drag(id, x0, y0, x1, y1, 8, time) + 0.1;
+            }
+        }
+        return trace;
+    }
+
+    // nearest rank
+    double percentile(std::vector<double> v, double p) {
+        if (v.empty())
+            return 0.0;
+        std::sort(v.begin(), v.end());
+        size_t rank = size_t(std::ceil(p * v.size()));
+        return v[std::clamp<size_t>(rank, 1, v.size()) - 1];
+    }
+
+    std::string stats(char const* name, std::vector<double> const& v, char const* format) {
+        char buffer[256];
+        std::string f = std::string("\"%s\": {\"p50\": ") + format + ", \"p95\": " + format + ", \"p99\": " + format + "}";
+        std::snprintf(buffer, sizeof(buffer), f.c_str(), name, percentile(v, 0.50), percentile(v, 0.95), percentile(v, 0.99));
+        return buffer;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> scenes = { "deep", "fan", "labels", "tree", "tabs", "splitter", "scroll", "reorder" };
+    std::vector<int> sizes = { 100, 1000, 10000, 100000 };
+    int frames = 100, width = 1920, height = 1080;
+    double seconds = 10.0;
+    bool idle = false;
+    std::string font;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--scene") && i + 1 < argc) scenes = split(argv[++i]);
+        else if (!std::strcmp(argv[i], "--sizes") && i + 1 < argc) {
+            sizes.clear();
+            for (auto const& s : split(argv[++i]))
+                sizes.push_back((std::max)(1, std::atoi(s.c_str())));
+        }
+        else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc) frames = (std::max)(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--seconds") && i + 1 < argc) seconds = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--size") && i + 1 < argc) std::sscanf(argv[++i], "%dx%d", &width, &height);
+        else if (!std::strcmp(argv[i], "--font") && i + 1 < argc) font = argv[++i];
+        else if (!std::strcmp(argv[i], "--idle")) idle = true;
+    }
+
+    // labels need the global font for their text layout
+    std::vector<std::string> fonts = { "C:/Windows/Fonts/calibri.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", "/System/Library/Fonts/Supplemental/Arial.ttf" };
+    if (!font.empty())
+        fonts = { font };
+    for (auto const& f : fonts) {
+        if (std::ifstream(f, std::ios::binary).good()) {
+            uf::LoadGlobal(f, 48);
+            font = f;
+            break;
+        }
+    }
+    if (!uf::gLoaded) {
+        std::fprintf(stderr, "no font found, pass --font path\n");
+        return 1;
+    }
+
+    // parts of the library still log to std::cout, keep stdout to the JSON
+    std::cout.rdbuf(nullptr);
+
+    std::printf("{\"bench\": \"macro\", \"window\": [%d, %d], \"font\": \"%s\", \"input\": %s, \"runs\": [\n", width, height, font.c_str(), idle ? "false" : "true");
+    bool first = true;
+    for (auto const& scene : scenes) {
+        for (int size : sizes) {
+            auto masks = std::make_shared<ui::ImageAtlas>(), images = std::make_shared<ui::ImageAtlas>();
+            ui::Backend backend(masks, images);
+
+            auto start = std::chrono::steady_clock::now();
+            int items = 0;
+            auto root = build(scene, size, items);
+            if (!root) {
+                std::fprintf(stderr, "unknown scene %s\n", scene.c_str());
+                return 1;
+            }
+            double buildMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+            root->makeWindow(0, 0, width, height);
+
+            // lay the scene out once so a script can aim at its widgets, dropping what it painted so
+            // the first measured frame holds one frame's objects
+            backend.update(0.0f);
+            for (auto& [canvas, w, h, surface] : backend.extractCanvases())
+                canvas->clear();
+            ui::InputTrace trace = script(scene, root.get());
+            ui::InputReplay replay(trace);
+            bool scripted = !trace.empty();
+            if (scripted)
+                replay.start(backend);
+
+            std::vector<double> events, animation, layout, postLayout, paint, total, objects, bytes;
+            uint64_t paintVersion = ~0ull;
+            start = std::chrono::steady_clock::now();
+            int frame = 0;
+            for (; scripted || frame < frames; frame++) {
+                if (scripted) {
+                    if (!replay.step(backend))
+                        break;
+                }
+                else {
+                    if (!idle) {
+                        ui::InputEvent move;
+                        move.windowID = root->id(), move.kind = ui::InputEvent::eMouseMove;
+                        move.x = (frame * 37) % width, move.y = (frame * 23) % height;
+                        backend.post(move);
+                    }
+                    backend.update(float(frame / 60.0));
+                }
+
+                // what a renderer takes from the canvases, paints only when they changed
+                size_t n = 0, b = 0;
+                for (auto& [canvas, w, h, surface] : backend.extractCanvases()) {
+                    auto packet = canvas->data();
+                    n += packet.size();
+                    b += packet.size() * sizeof(ui::PackedObject) + packet.data.size() * sizeof(int);
+                    if (packet.paintVersion != paintVersion)
+                        b += packet.paints.size() * sizeof(int), paintVersion = packet.paintVersion;
+                    canvas->clear();
+                }
+
+                auto const& t = backend.frameTimes();
+                events.push_back(t.events), animation.push_back(t.animation), layout.push_back(t.layout);
+                postLayout.push_back(t.postLayout), paint.push_back(t.paint);
+                total.push_back(t.events + t.animation + t.layout + t.postLayout + t.paint);
+                objects.push_back(double(n)), bytes.push_back(double(b));
+
+                if (std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() > seconds) {
+                    frame++;
+                    break;
+                }
+            }
+
+            std::printf("%s  {\"scene\": \"%s\", \"size\": %d, \"widgets\": %d, \"items\": %d, \"build_ms\": %.3f, \"frames\": %d, %s, %s, %s, %s, %s, %s, %s, %s}",
+                first ? "" : ",\n", scene.c_str(), size, count(root.get()), items, buildMs, frame,
+                stats("events", events, "%.4f").c_str(), stats("animation", animation, "%.4f").c_str(), stats("layout", layout, "%.4f").c_str(),
+                stats("postLayout", postLayout, "%.4f").c_str(), stats("paint", paint, "%.4f").c_str(), stats("frame", total, "%.4f").c_str(),
+                stats("objects", objects, "%.0f").c_str(), stats("bytes", bytes, "%.0f").c_str());
+            std::fflush(stdout);
+            first = false;
+        }
+    }
+    std::printf("\n]}\n");
+    return 0;
+}
@@ -0,0 +1,251 @@
+// One group of microbenchmarks per hot path, for comparing an optimization against a baseline.
+//
+//   micro [--filter text] [--scale x] [--font path]...
+//
+// Groups: font (load_metric per font, d_load_character, bitmap_fill per height, load_atlas), image
+// (ImageAtlas build per format and compression), pyramid (downsample_2x2, a cold TiledImage down to
+// its coarsest tile, prefetch of cached tiles, LruCache lookups and inserts), text (TextModel::cache, uf::TextSize and
+// uf::CachedTextSize at 10, 100 and 1000 characters), canvas (recording per primitive), layout (Layout::layout of a vertical and
+// a horizontal layout of N children, marked dirty each time), binning (TileBins::build over 1k, 10k
+// and 100k recorded rects of 8 to 72 pixels) and event (Widget::event down chains of nested widgets).
+//
+// Every case runs a fixed number of iterations, times --scale, in 5 batches after one warm up, and
+// reports the fastest and the median batch in nanoseconds per operation. --filter keeps the cases
+// whose group/name contains the text. The output is JSON, one case per line. Fonts default to the
+// system ones found, image cases read synthetic images written to a temporary folder.
+
+#include "../src/ui/util/canvas.hpp"
+#include "../src/ui/util/widget.hpp"
+#include "../src/ui/layout.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+
+namespace {
+    constexpr int kBatches = 5;
+
+    std::string filter;
+    double scale = 1.0;
+    bool first = true;
+
+    // f runs one iteration of ops operations
+    template<typename F>
+    void run(char const* group, std::string const& name, int iterations, int ops, F&& f) {
+        std::string full = std::string(group) + "/" + name;
+        if (!filter.empty() && full.find(filter) == std::string::npos)
+            return;
+        iterations = (std::max)(1, int(iterations * scale));
+
+        f();
+        double batches[kBatches];
+        for (auto& b : batches) {
+            auto start = std::chrono::steady_clock::now();
+            for (int i = 0; i < iterations; i++)
+                f();
+            b = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now() - start).count() / (double(iterations) * ops);
+        }
+        std::sort(batches, batches + kBatches);
+        std::printf("%s  {\"group\": \"%s\", \"name\": \"%s\", \"iterations\": %d, \"ops\": %d, \"ns_min\": %.1f, \"ns_median\": %.1f}",
+            first ? "" : ",\n", group, name.c_str(), iterations, ops, batches[0], batches[kBatches / 2]);
+        std::fflush(stdout);
+        first = false;
+    }
+
+    std::string text(size_t n) {
+        std::string s;
+        char const* words[] = { "layout ", "widget ", "canvas ", "glyph ", "atlas ", "frame " };
+        for (size_t i = 0; s.size() < n; i++)
+            s += words[i % 6];
+        s.resize(n);
+        return s;
+    }
+
+    // Image files for the atlas cases, a mix of sizes with some structure so compression has work to do.
+    std::string writeImages() {
+        auto folder = std::filesystem::temp_directory_path() / "hexgui_micro_images";
+        std::filesystem::create_directories(folder);
+        for (int i = 0; i < 32; i++) {
+            int w = 16 << (i % 3), h = 16 << ((i / 3) % 3);
+            std::vector<unsigned char> pixels(size_t(w) * h * 4);
+            for (int y = 0; y < h; y++)
+                for (int x = 0; x < w; x++)
+                    for (int c = 0; c < 4; c++)
+                        pixels[(size_t(y) * w + x) * 4 + c] = (unsigned char)((x * (c + 1) * 7 + y * 13 + i * 31) ^ (x * y));
+            ui::save_image((folder / ("img" + std::to_string(i) + ".png")).string(), pixels, w, h, 4);
+        }
+        return folder.string();
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> fonts;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--filter") && i + 1 < argc) filter = argv[++i];
+        else if (!std::strcmp(argv[i], "--scale") && i + 1 < argc) scale = std::atof(argv[++i]);
+        else if (!std::strcmp(argv[i], "--font") && i + 1 < argc) fonts.push_back(argv[++i]);
+    }
+    if (fonts.empty()) {
+        for (char const* f : { "C:/Windows/Fonts/calibri.ttf", "C:/Windows/Fonts/arial.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf",
+            "/usr/share/fonts/truetype/dejavu/DejaVuSerif.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSansMono.ttf" })
+            if (std::ifstream(f, std::ios::binary).good())
+                fonts.push_back(f);
+    }
+    if (fonts.empty()) {
+        std::fprintf(stderr, "no font found, pass --font path\n");
+        return 1;
+    }
+
+    // Widget::event logs to std::cout, keep stdout to the JSON
+    std::cout.rdbuf(nullptr);
+    std::printf("{\"bench\": \"micro\", \"results\": [\n");
+
+    // font
+    for (auto const& f : fonts) {
+        run("font", "load_metric/" + std::filesystem::path(f).stem().string(), 5, 1, [&] { uf::load_metric(f); });
+    }
+    uf::LoadGlobal(fonts[0], 48);
+    std::string alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    run("font", "d_load_character", 200, int(alphabet.size()), [&] {
+        for (char c : alphabet)
+            uf::load_character(uf::gMetric, c);
+    });
+    for (int height : { 12, 24, 48, 96 }) {
+        run("font", "bitmap_fill/" + std::to_string(height), 20, 8, [&] {
+            for (char c : std::string("agWM@&%e"))
+                uf::bitmap_fill(uf::gCharacters[c], height);
+        });
+    }
+    for (int height : { 24, 48 }) {
+        run("font", "load_atlas/" + std::to_string(height), 5, 1, [&] { uf::load_atlas(uf::gMetric, uf::gCharacters, height); });
+    }
+
+    // image
+    std::string folder = writeImages();
+    run("image", "atlas/ALPHA", 20, 1, [&] { ui::ImageAtlas a(folder, ui::ImageAtlas::ALPHA); });
+    run("image", "atlas/RGB", 20, 1, [&] { ui::ImageAtlas a(folder, ui::ImageAtlas::RGB); });
+    run("image", "atlas/RGBA", 20, 1, [&] { ui::ImageAtlas a(folder, ui::ImageAtlas::RGBA); });
+    {
+        ui::ImageAtlas alpha(folder, ui::ImageAtlas::ALPHA), rgb(folder, ui::ImageAtlas::RGB);
+        run("image", "compress/BC4", 5, 1, [&] { alpha.compress(ui::fBC4); });
+        run("image", "compress/BC1", 5, 1, [&] { rgb.compress(ui::fBC1); });
+        run("image", "compress/BC7", 2, 1, [&] { rgb.compress(ui::fBC7); });
+    }
+
+    // pyramid, over a 2048 x 2048 image in memory
+    {
+        std::vector<uint8_t> pixels(size_t(2048) * 2048 * 4);
+        for (size_t i = 0; i < pixels.size(); i++)
+            pixels[i] = uint8_t(i * 2654435761u >> 13);
+        std::vector<uint8_t> half(size_t(128) * 128 * 4);
+        run("pyramid", "downsample_2x2/256", 2000, 1, [&] { ui::downsample_2x2(pixels.data(), 256, 256, 2048 * 4, half.data(), 128 * 4); });
+
+        auto image = [&] { return ui::TiledImage(std::make_unique<ui::MemoryTileSource>(pixels, 2048, 2048, 4), 256); };
+        run("pyramid", "cold_top_tile", 5, 1, [&] {
+            auto tiled = image();
+            tiled.tile(tiled.levels() - 1, 0, 0);
+        });
+        auto tiled = image();
+        tiled.prefetch(0, 0, 0, 7, 7);
+        run("pyramid", "prefetch_cached/64", 20000, 1, [&] { tiled.prefetch(0, 0, 0, 7, 7); });
+
+        ui::LruCache<uint64_t, int> lru(size_t(1) << 20);
+        auto value = std::make_shared<int const>(0);
+        for (uint64_t k = 0; k < 1024; k++)
+            lru.insert(k, value, 1024);
+        uint64_t probe = 0;
+        run("pyramid", "lru_find", 100000, 1, [&] { lru.find(probe++ & 1023); });
+        run("pyramid", "lru_insert_evict", 100000, 1, [&] { lru.insert(1024 + probe++, value, 1024); });
+    }
+
+    // text
+    for (size_t n : { 10, 100, 1000 }) {
+        std::string s = text(n);
+        uf::TextModel model;
+        run("text", "cache/" + std::to_string(n), 20000 / int(n), 1, [&] { model.cache(0, 0, 1920, 40, s, 24); });
+        run("text", "TextSize/" + std::to_string(n), 20000 / int(n), 1, [&] { uf::TextSize(s, 24); });
+        run("text", "CachedTextSize/" + std::to_string(n), 20000 / int(n), 1, [&] { uf::CachedTextSize(s, 24); });
+    }
+
+    // canvas, objects spread over the viewport, cleared after each thousand
+    {
+        auto masks = std::make_shared<ui::ImageAtlas>(folder, ui::ImageAtlas::ALPHA);
+        auto images = std::make_shared<ui::ImageAtlas>(folder, ui::ImageAtlas::RGB);
+        ui::Canvas canvas(masks, images);
+        canvas.setViewport(0, 0, 1920, 1080);
+        uf::TextModel model;
+        std::string label = text(20);
+        ui::Path path;
+        path.moveTo(0, 0).cubicTo(40, 0, 60, 40, 100, 40).lineTo(100, 60).lineTo(0, 60).close();
+
+        auto record = [&](std::string const& name, int iterations, auto&& draw) {
+            run("canvas", name, iterations, 1000, [&] {
+                for (int i = 0; i < 1000; i++)
+                    draw(i % 40 * 48, i / 40 * 40 % 1040);
+                canvas.clear();
+            });
+        };
+        record("rect", 200, [&](int x, int y) { canvas.solid(ui::col.white); canvas.rect(x, y, 40, 30); });
+        record("rect_border", 200, [&](int x, int y) { canvas.solid(ui::col.white); canvas.solid(ui::col.black, 2); canvas.rect(x, y, 40, 30); });
+        record("rrect", 200, [&](int x, int y) { canvas.solid(ui::col.white); canvas.rrect(x, y, 40, 30, 6); });
+        record("circle", 200, [&](int x, int y) { canvas.solid(ui::col.white); canvas.circle(x + 20, y + 15, 12); });
+        record("ellipse", 200, [&](int x, int y) { canvas.solid(ui::col.white); canvas.ellipse(x, y, 40, 30); });
+        record("line", 200, [&](int x, int y) { canvas.solid(ui::col.white); canvas.line(x, y, x + 40, y + 30, 2); });
+        record("image", 200, [&](int x, int y) { canvas.image("img3"); canvas.rect(x, y, 40, 30); });
+        record("text20", 20, [&](int x, int y) { canvas.solid(ui::col.white); canvas.text(model, label, 24, float(x), float(y), 300, 30); });
+        record("ninePatch", 100, [&](int x, int y) { canvas.ninePatch("img4", x, y, 40, 30, { 4, 4, 4, 4 }); });
+        record("shadow", 100, [&](int x, int y) { canvas.shadow(x, y, 40, 30, 6, 8, ui::color(0, 0, 0, 100)); });
+        record("path", 100, [&](int x, int y) { canvas.solid(ui::col.white); canvas.solid(ui::col.black, 2); canvas.path(path, float(x), float(y), 0.4f); });
+    }
+
+    // binning, rects spread over the viewport the way a busy frame records them
+    for (int n : { 1000, 10000, 100000 }) {
+        ui::Canvas canvas(std::make_shared<ui::ImageAtlas>(), std::make_shared<ui::ImageAtlas>());
+        canvas.setViewport(0, 0, 1920, 1080);
+        uint32_t seed = 1;
+        auto next = [&] { return (seed = seed * 1664525u + 1013904223u) >> 8; };
+        for (int i = 0; i < n; i++) {
+            canvas.solid(ui::color(next() & 0xFF, 128, 64, i % 3 ? 255 : 128));
+            canvas.rect(float(next() % 1920), float(next() % 1080), float(8 + next() % 64), float(8 + next() % 64));
+        }
+        auto packet = canvas.data();
+        auto ranges = packet.ranges();
+        ui::TileBins bins;
+        run("binning", "build/" + std::to_string(n), (std::max)(5, 1000000 / n), 1, [&] {
+            bins.build(ranges.data(), ranges.size(), packet.data.data(), packet.paints.data(), 1920, 1080);
+        });
+    }
+
+    // layout
+    for (int n : { 10, 100, 1000, 10000 }) {
+        ui::VLayout vertical;
+        ui::HLayout horizontal;
+        for (int i = 0; i < n; i++)
+            vertical.addChild<ui::BoxWidget>(), horizontal.addChild<ui::BoxWidget>();
+        run("layout", "vertical/" + std::to_string(n), 100000 / n, 1, [&] { vertical.relayout(); vertical.layout(0, 0, 1920, 1080); });
+        run("layout", "horizontal/" + std::to_string(n), 100000 / n, 1, [&] { horizontal.relayout(); horizontal.layout(0, 0, 1920, 1080); });
+    }
+
+    // event, a pointer move inside every widget of the chain
+    for (int depth : { 1, 10, 100, 1000 }) {
+        ui::VLayout root;
+        ui::Widget* w = &root;
+        for (int d = 1; d < depth; d++)
+            w = w->addChild<ui::VLayout>();
+        root.layout(0, 0, 1920, 1080);
+        ui::MouseEvent move(ui::fNoButton, ui::fMove);
+        move.setPos(10, 10);
+        run("event", "depth/" + std::to_string(depth), (std::max)(2, 20000 / depth), 1, [&] { root.event(&move); });
+    }
+
+    std::printf("\n]}\n");
+    return 0;
+}
@@ -5,6 +5,9 @@
 
 #include "src/ui/util/canvas.hpp"
 #include "src/ui/util/backend.hpp"
+#include "src/ui/util/startup.hpp"
+#include "src/ui/util/capture.hpp"
+#include "src/ui/util/trace.hpp"
 #include "src/ui/layout.hpp"
 #include "src/ui/label.hpp"
 #include "src/ui/combobox.hpp"
@@ -17,31 +20,65 @@
 #include "src/ui/tree.hpp"
 #include "src/ui/slider.hpp"
 
+std::string load_file_source(std::string const& filename) {
+    std::ifstream file(filename);
+    if (!file.is_open()) {
+        throw std::runtime_error("Failed to open file: " + filename);
+    }
+    std::ostringstream buffer; buffer << file.rdbuf();
+    return buffer.str();
+}
+
+/*
+    The interface the ui shaders are built against, they are not in this tree so keep them in step:
+        SSBO 0  PackedObject[]  six uint words per draw slot, laid out as in ui/util/packed.hpp
+        SSBO 1  int[]           frame data, the records r1, clip and aux indices point at
+        SSBO 2  int[]           glyph table, kGlyphStride ints per glyph id, see Canvas::glyphTable
+        SSBO 3  int[]           paint table, records starting { eStroke, width, ... } at brush and pen
+        SSBO 4  uint[]          painter's rank per draw slot, written as the slot's depth
+        texture 0 masks, 1 font, 2 images, 3 the canvas' tile page (image tiles, layers, shadows, paths)
+        u_resolution, u_imageDim, u_maskDim, u_fontDim, u_tileDim  sizes in pixels
+        u_unitsPerEm, u_objectCount
+        u_first      first slot of the batch drawn, instances index from it
+        u_batchType  Canvas::eType of every slot in the batch, -1 when it mixes types
+*/
+namespace binding {
+    constexpr GLuint kObjects = 0, kData = 1, kGlyphs = 2, kPaints = 3, kRanks = 4;
+    constexpr GLuint kMaskUnit = 0, kFontUnit = 1, kImageUnit = 2, kTileUnit = 3;
+}
+
 class UiRenderer {
-    std::unique_ptr<ui::Canvas> canvas;
     std::unique_ptr<gl::Program> programInstanced;
     std::unique_ptr<gl::Texture2D> imageTexture;
     std::unique_ptr<gl::Texture2D> maskTexture;
     std::unique_ptr<gl::Texture2D> fontTexture;
+    std::unique_ptr<gl::sbuffer<int>> glyphTable;
+    std::map<ui::Canvas*, std::unique_ptr<gl::Texture2D>> tileTextures;
+    std::vector<ui::PackedObject> packed; // upload staging, keeps its capacity between frames
+    ui::DrawOrder order;
+
+    struct PaintBuffer {
+        uint64_t version = ~0ull;
+        std::unique_ptr<gl::sbuffer<int>> buffer;
+    };
+    std::map<ui::Canvas*, PaintBuffer> paintBuffers;
+    std::map<ui::Canvas*, ui::DamageRegion> lastDamage;
+    std::map<ui::Canvas*, int> captureSources;
 
     gl::Context* context;
 public:
-    UiRenderer(std::string const& asset_str, gl::Context* context) : context(context) {
-		canvas = std::make_unique<ui::Canvas>(asset_str, "C:/Windows/Fonts/Calibri.ttf", 48);
-
-        std::map<GLenum, std::string> uiSource = {
-            {GL_VERTEX_SHADER, load_file_source(asset_str + "shaders/ui/ui.vert")},
-            {GL_GEOMETRY_SHADER, load_file_source(asset_str + "shaders/ui/ui.geom")},
-            {GL_FRAGMENT_SHADER, load_file_source(asset_str + "shaders/ui/ui.frag") },
-        };
+    std::unique_ptr<ui::CaptureWriter> capture; // frames for tools/replay, see HEXUI_CAPTURE in main
 
+    // Only the GL work happens here, sources, atlases and the font atlas are loaded by the startup graph
+    UiRenderer(std::map<GLenum, std::string> const& uiSource, ui::ImageAtlas& masks, ui::ImageAtlas& images, gl::Context* context) : context(context) {
 		programInstanced = std::make_unique<gl::Program>(uiSource);
 
 
         glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-        imageTexture = std::make_unique<gl::Texture2D>(canvas->imageAtlas.w_, canvas->imageAtlas.h_, canvas->imageAtlas.c_, canvas->imageAtlas.data_);
-        maskTexture = std::make_unique<gl::Texture2D>(canvas->maskAtlas.w_, canvas->maskAtlas.h_, canvas->maskAtlas.c_, canvas->maskAtlas.data_);
+        imageTexture = atlasTexture(images);
+        maskTexture = atlasTexture(masks);
         fontTexture = std::make_unique<gl::Texture2D>(uf::gAtlas.w(), uf::gAtlas.h(), 1, uf::gAtlas.pixels());
+        glyphTable = std::make_unique<gl::sbuffer<int>>(ui::Canvas::glyphTable(), GL_STATIC_DRAW);
 
         glEnable(GL_DEPTH_TEST);
         glDepthFunc(GL_LESS);
@@ -52,49 +89,121 @@ public:
     }
 
     void render(ui::Canvas* canvas, int ww, int wh, HDC hdc) {
+        auto frame = canvas->data();
+        if (capture)
+            capture->write(frame, ww, wh, captureSources.emplace(canvas, int(captureSources.size())).first->second);
+
+        // SwapBuffers exchanges front and back, so the back buffer also misses the previous frame's damage
+        ui::DamageRegion region = lastDamage[canvas];
+        region.add(*frame.damage);
+        lastDamage[canvas] = *frame.damage;
+        if (region.empty()) {
+            canvas->clear();
+            return;
+        }
+
         context->makeCurrent(hdc);
 
+        auto [dx, dy, dw, dh] = region.bounds;
         glViewport(0, 0, ww, wh);
+        glEnable(GL_SCISSOR_TEST);
+        glScissor(dx, wh - (dy + dh), dw, dh);
         glClearColor(0.1f, 0.1f, 0.1f, 1.0f);
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-        auto [objects, data] = canvas->data();
-
-        if (!objects.empty()) {
-            std::reverse(objects.begin(), objects.end());
+        if (!frame.empty()) {
+            uploadTiles(canvas);
             programInstanced->use();
             programInstanced->SetUniform("u_resolution", ww, wh);
             programInstanced->SetUniform("u_imageDim", imageTexture->w, imageTexture->h);
             programInstanced->SetUniform("u_maskDim", maskTexture->w, maskTexture->h);
             programInstanced->SetUniform("u_fontDim", fontTexture->w, fontTexture->h);
-
-            glBindTextureUnit(0, maskTexture->id);
-            glBindTextureUnit(1, fontTexture->id);
-            glBindTextureUnit(2, imageTexture->id);
-            glBindTextureUnit(3, 0);
-
-            gl::sbuffer<ui::RenderObject> buffer(objects);
-            buffer.bind_base(0);
-
-            gl::sbuffer<int> data_buffer(data);
-            data_buffer.bind_base(1);
-
-            glDrawArraysInstanced(GL_POINTS, 0, 1, objects.size());
+            programInstanced->SetUniform("u_unitsPerEm", (int)uf::gMetric.unitsPerEm);
+
+            glBindTextureUnit(binding::kMaskUnit, maskTexture->id);
+            glBindTextureUnit(binding::kFontUnit, fontTexture->id);
+            glBindTextureUnit(binding::kImageUnit, imageTexture->id);
+            glBindTextureUnit(binding::kTileUnit, tileTextures[canvas] ? tileTextures[canvas]->id : 0);
+            programInstanced->SetUniform("u_tileDim", canvas->tilePage.width(), canvas->tilePage.height());
+
+            auto ranges = frame.ranges();
+            order.build(ranges.data(), ranges.size(), frame.data.data(), frame.paints.data());
+            packed.resize(order.size());
+            order.encode(packed.data());
+
+            gl::sbuffer<ui::PackedObject> buffer(packed.data(), packed.size());
+            buffer.bind_base(binding::kObjects);
+
+            // slots are drawn out of painter's order, each carries its rank for the depth test
+            gl::sbuffer<uint32_t> depth_buffer(order.order().data(), order.size());
+            depth_buffer.bind_base(binding::kRanks);
+            programInstanced->SetUniform("u_objectCount", (int)order.size());
+
+            gl::sbuffer<int> data_buffer(frame.data.data(), frame.data.size());
+            data_buffer.bind_base(binding::kData);
+            glyphTable->bind_base(binding::kGlyphs);
+
+            // the retained paint table only moves when a new paint appears or it is compacted
+            auto& paints = paintBuffers[canvas];
+            if (paints.version != frame.paintVersion) {
+                paints.buffer = std::make_unique<gl::sbuffer<int>>(frame.paints.data(), frame.paints.size());
+                paints.version = frame.paintVersion;
+            }
+            paints.buffer->bind_base(binding::kPaints);
+
+            // opaque batches front to back without blending, then the rest back to front without depth writes
+            for (auto const& batch : order.batches()) {
+                if (batch.opaque) {
+                    glDisable(GL_BLEND);
+                    glDepthMask(GL_TRUE);
+                }
+                else {
+                    glEnable(GL_BLEND);
+                    glDepthMask(GL_FALSE);
+                }
+                programInstanced->SetUniform("u_first", (int)batch.first);
+                programInstanced->SetUniform("u_batchType", batch.type);
+                glDrawArraysInstanced(GL_POINTS, 0, 1, batch.count);
+            }
+            glEnable(GL_BLEND);
+            glDepthMask(GL_TRUE);
         }
 
+        glDisable(GL_SCISSOR_TEST);
         canvas->clear();
 
         SwapBuffers(hdc);
     }
 
 private:
-    std::string load_file_source(std::string const& filename) {
-        std::ifstream file(filename);
-        if (!file.is_open()) {
-            throw std::runtime_error("Failed to open file: " + filename);
+    // Uploads the tile slots ImageViews placed this frame, the page texture is created on first use
+    void uploadTiles(ui::Canvas* canvas) {
+        auto& page = canvas->tilePage;
+        auto& texture = tileTextures[canvas];
+        if (!page.allocated())
+            return;
+
+        if (!texture) {
+            texture = std::make_unique<gl::Texture2D>(page.width(), page.height(), 4, page.pixels());
         }
-        std::ostringstream buffer; buffer << file.rdbuf();
-        return buffer.str();
+        else if (!page.dirty().empty()) {
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, page.width());
+            for (int slot : page.dirty()) {
+                auto [sx, sy, sw, sh] = page.slotRect(slot);
+                glTextureSubImage2D(texture->id, 0, sx, sy, sw, sh, GL_RGBA, GL_UNSIGNED_BYTE, page.pixels().data() + (size_t(sy) * page.width() + sx) * 4);
+            }
+            glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+        }
+        page.clearDirty();
+    }
+
+    std::unique_ptr<gl::Texture2D> atlasTexture(ui::ImageAtlas& atlas) {
+        if (!atlas.compressed())
+            return std::make_unique<gl::Texture2D>(atlas.w_, atlas.h_, atlas.c_, atlas.data_);
+
+        auto const& blocks = atlas.blocks();
+        GLenum format = blocks.format == ui::fBC4 ? GL_COMPRESSED_RED_RGTC1 : blocks.format == ui::fBC1 ? GL_COMPRESSED_RGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGBA_BPTC_UNORM;
+        return std::make_unique<gl::Texture2D>(blocks.paddedW(), blocks.paddedH(), format, blocks.blocks.data(), blocks.blocks.size());
     }
 };
 
@@ -110,10 +219,41 @@ int main()
 
     std::string asset_str = "C:/Users/Tom/source/repos/repositorys/hexui_v1/hexui_v1/assets/";
 
-    std::unique_ptr<UiRenderer> uRenderer = std::make_unique<UiRenderer>(asset_str, context.get());
-	std::unique_ptr<ui::Backend> uBackend = std::make_unique<ui::Backend>(asset_str, "C:/Windows/Fonts/Calibri.ttf", 58);
+    std::string font_str = "C:/Windows/Fonts/Calibri.ttf";
+
+    // File reads, font parse, glyph rasterization and atlas decode run on workers,
+    // the GL uploads are joined on this thread since the context is current here.
+    std::shared_ptr<ui::ImageAtlas> masks, images;
+    // every key exists before the graph runs, the shader tasks only write their own entry through at()
+    std::map<GLenum, std::string> uiSource = { {GL_VERTEX_SHADER, ""}, {GL_GEOMETRY_SHADER, ""}, {GL_FRAGMENT_SHADER, ""} };
+    std::unique_ptr<UiRenderer> uRenderer;
+
+    ui::TaskGraph startup;
+    auto fontParse = startup.add("font parse", [&] { uf::LoadMetricGlobal(font_str); });
+    auto glyphs = startup.add("glyph raster", [&] { uf::LoadAtlasGlobal(48); }, { fontParse });
+    auto icons = startup.add("icons decode", [&] { masks = ui::ImageAtlas::shared(asset_str + "/icons", ui::ImageAtlas::ALPHA, ui::fBC4); });
+    auto pictures = startup.add("images decode", [&] { images = ui::ImageAtlas::shared(asset_str + "/images", ui::ImageAtlas::RGB, ui::fBC7); });
+    auto vert = startup.add("ui.vert", [&] { uiSource.at(GL_VERTEX_SHADER) = load_file_source(asset_str + "shaders/ui/ui.vert"); });
+    auto geom = startup.add("ui.geom", [&] { uiSource.at(GL_GEOMETRY_SHADER) = load_file_source(asset_str + "shaders/ui/ui.geom"); });
+    auto frag = startup.add("ui.frag", [&] { uiSource.at(GL_FRAGMENT_SHADER) = load_file_source(asset_str + "shaders/ui/ui.frag"); });
+    startup.addMain("gl upload", [&] { uRenderer = std::make_unique<UiRenderer>(uiSource, *masks, *images, context.get()); },
+        { glyphs, icons, pictures, vert, geom, frag });
+    std::cout << startup.run().str();
+
+    // HEXUI_CAPTURE=<file> records every frame handed to the renderer
+    if (char const* path = std::getenv("HEXUI_CAPTURE"))
+        uRenderer->capture = std::make_unique<ui::CaptureWriter>(path, masks.get(), images.get());
+
+	std::unique_ptr<ui::Backend> uBackend = std::make_unique<ui::Backend>(masks, images);
     uBackend->setProcessDpiAware();
 
+    // HEXUI_RECORD=<file> records the input stream for InputReplay
+    std::unique_ptr<ui::InputRecorder> recorder;
+    if (char const* path = std::getenv("HEXUI_RECORD")) {
+        recorder = std::make_unique<ui::InputRecorder>(path);
+        recorder->attach(*uBackend);
+    }
+
 
     std::unique_ptr<ui::VLayout> widget = std::make_unique<ui::VLayout>();
 	widget->makeWindow(50, 50, 800, 600);
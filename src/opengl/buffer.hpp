@@ -15,6 +15,14 @@ namespace gl::detail {
 			mSize = (unsigned int)data.size();
 		}
 
+		// data may be null to allocate count elements for later update_sub calls
+		Buffer(T const* data, size_t count, GLenum flags = GL_DYNAMIC_DRAW) {
+			glGenBuffers(1, &mID);
+			bind();
+			glNamedBufferData(mID, sizeof(T) * count, data, flags);
+			mSize = (unsigned int)count;
+		}
+
 		~Buffer() {
 			glDeleteBuffers(1, &mID);
 		}
@@ -64,6 +72,10 @@ namespace gl::detail {
 			glNamedBufferSubData(mID, offset, sizeof(T) * data.size(), data.data());
 		}
 
+		void update_sub(T const* data, size_t count, size_t offset = 0) {
+			glNamedBufferSubData(mID, offset, sizeof(T) * count, data);
+		}
+
 		GLuint size() const {
 			return mSize;
 		}
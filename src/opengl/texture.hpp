@@ -35,6 +35,18 @@ namespace gl {
             //glGenerateMipmap(GL_TEXTURE_2D);
         }
 
+        // Block compressed upload (GL_COMPRESSED_RED_RGTC1, GL_COMPRESSED_RGBA_BPTC_UNORM, ...), width and height are the padded block dimensions
+        Texture2D(int width, int height, GLenum internalFormat, unsigned char const* blocks, size_t size) : w{ width }, h{ height }, c{ 0 }, bit{ internalFormat } {
+            glGenTextures(1, &id);
+            glBindTexture(GL_TEXTURE_2D, id);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+            glCompressedTexImage2D(GL_TEXTURE_2D, 0, internalFormat, width, height, 0, (GLsizei)size, blocks);
+        }
+
         Texture2D(int w, int h, int c) :w{ w }, h{ h }, c{ c } {
             bit = (c == 1) ? GL_RED : (c == 2) ? GL_RG : (c == 3) ? GL_RGB : GL_RGBA;
             glGenTextures(1, &id);
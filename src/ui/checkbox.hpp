@@ -23,7 +23,8 @@ namespace ui {
 			if (selected_ != s && onChange_)
 				onChange_(s);
 
-			selected_ = s; 
+			if (selected_ != s)
+				selected_ = s, invalidate();
 		}
 
 		void onPaint(Canvas* c) override {
@@ -45,6 +46,12 @@ namespace ui {
 			c->text(tm_, text_, 48, x(), y(), w(), h());
 		}
 
+		SizeHint onMeasure(int, int) override {
+			auto [tw, th] = uf::CachedTextSize(text_, 48);
+			int w = tw + 16, h = th + 16;
+			return { w, h, w, h };
+		}
+
 		bool selected() const { return selected_; }
 	};
 
@@ -47,7 +47,8 @@ namespace ui {
 		void onMousePress(MouseEvent* e) {
 			if (e->left() && dropdown_->window() == nullptr) {
 				auto [wx, wy] = root()->window()->screenPos(x(), y() + h());
-				dropdown_->makeWindow(wx, wy, w(), int(items_.size()) * 80);
+				SizeHint size = dropdown_->measure(w(), h());
+				dropdown_->makeWindow(wx, wy, (std::max)(w(), size.w), size.h);
 				dropdown_->window()->show();
 				dropdown_->window()->removeTitleBarAndButtons();
 			}
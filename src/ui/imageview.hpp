@@ -0,0 +1,138 @@
+#ifndef UI_IMAGE_VIEW
+#define UI_IMAGE_VIEW
+
+#include "util/widget.hpp"
+
+#include <cmath>
+#include <algorithm>
+
+namespace ui {
+	// Pan and zoom view over a TiledImage, only the tiles visible at the current zoom are requested.
+	// Missing tiles are decoded on the WorkerPool, until they arrive the nearest cached coarser level
+	// is drawn in their place.
+	class ImageView : public Widget {
+		std::shared_ptr<TiledImage> image_;
+		std::shared_ptr<bool> alive_ = std::make_shared<bool>(true); // lets requests outlive the view
+		float zoom_ = 0.0f; // screen pixels per image pixel, 0 until the first paint fits the image
+		float panX_ = 0.0f, panY_ = 0.0f; // image pixel at the top left corner of the view
+		int dragX_ = 0, dragY_ = 0;
+	public:
+		ImageView(std::shared_ptr<TiledImage> image) : Widget(), image_(image) {
+			setInitiatesDrag(true);
+			setConsumesDrag(true);
+		}
+
+		void fit() {
+			if (!image_ || w() <= 0 || h() <= 0)
+				return;
+			zoom_ = (std::min)(float(w()) / image_->width(), float(h()) / image_->height());
+			panX_ = (image_->width() - w() / zoom_) / 2.0f;
+			panY_ = (image_->height() - h() / zoom_) / 2.0f;
+		}
+
+		void setZoom(float zoom) { zoom_ = std::clamp(zoom, minZoom(), 32.0f), invalidate(); }
+		void setPan(float px, float py) { panX_ = px, panY_ = py, invalidate(); }
+		float zoom() const { return zoom_; }
+		std::shared_ptr<TiledImage> image() const { return image_; }
+
+		void onMouseWheel(MouseEvent* me) override {
+			if (zoom_ <= 0.0f)
+				return;
+
+			// keep the image pixel under the cursor fixed
+			float ix = panX_ + (me->x() - x()) / zoom_, iy = panY_ + (me->y() - y()) / zoom_;
+			setZoom(zoom_ * (me->wheelUp() ? 1.25f : 0.8f));
+			setPan(ix - (me->x() - x()) / zoom_, iy - (me->y() - y()) / zoom_);
+
+			me->setIgnored(true);
+		}
+
+		void onDragStart(DragEvent* de) override {
+			dragX_ = de->x(), dragY_ = de->y();
+		}
+
+		void onDragMove(DragEvent* de) override {
+			if (zoom_ <= 0.0f)
+				return;
+			setPan(panX_ - (de->x() - dragX_) / zoom_, panY_ - (de->y() - dragY_) / zoom_);
+			dragX_ = de->x(), dragY_ = de->y();
+		}
+
+		void onPaint(Canvas* c) override {
+			c->solid(col.darkGray);
+			c->rect(x(), y(), w(), h());
+
+			if (!image_ || w() <= 0 || h() <= 0)
+				return;
+			if (zoom_ <= 0.0f)
+				fit();
+
+			int level = level_();
+			float tileSpan = float(image_->tileSize() << level); // image pixels covered by one tile
+
+			int tx0 = int(std::floor(panX_ / tileSpan)), ty0 = int(std::floor(panY_ / tileSpan));
+			int tx1 = int(std::floor((panX_ + w() / zoom_) / tileSpan)), ty1 = int(std::floor((panY_ + h() / zoom_) / tileSpan));
+
+			int size = image_->tileSize();
+			auto ready = [this, alive = std::weak_ptr<bool>(alive_)] {
+				if (alive.lock())
+					invalidate();
+			};
+
+			c->clip(x(), y(), w(), h());
+			for (int ty = (std::max)(ty0, 0); ty <= (std::min)(ty1, image_->tilesY(level) - 1); ty++) {
+				for (int tx = (std::max)(tx0, 0); tx <= (std::min)(tx1, image_->tilesX(level) - 1); tx++) {
+					int tw = (std::min)(size, image_->levelWidth(level) - tx * size);
+					int th = (std::min)(size, image_->levelHeight(level) - ty * size);
+
+					// snap both edges so neighbouring tiles share a pixel boundary
+					int sx0 = x() + int(std::floor((tx * tileSpan - panX_) * zoom_));
+					int sy0 = y() + int(std::floor((ty * tileSpan - panY_) * zoom_));
+					int sx1 = x() + int(std::floor((tx * tileSpan + (tw << level) - panX_) * zoom_));
+					int sy1 = y() + int(std::floor((ty * tileSpan + (th << level) - panY_) * zoom_));
+
+					// the tile itself, or the part of the nearest coarser cached tile covering it
+					std::shared_ptr<Tile const> tile;
+					int d = 0;
+					for (; d < image_->levels() - level && !tile; d++) {
+						tile = image_->cached(level + d, tx >> d, ty >> d);
+						if (d == 0 && !tile)
+							image_->request(level, tx, ty, ready);
+					}
+					if (!tile)
+						continue;
+					--d;
+
+					auto region = c->place(image_->key(level + d, tx >> d, ty >> d), *tile);
+					if (!region)
+						continue;
+
+					if (d > 0) {
+						int rx = ((tx * size) >> d) - (tx >> d) * size, ry = ((ty * size) >> d) - (ty >> d) * size;
+						int rw = (std::min)((tw + (1 << d) - 1) >> d, tile->w - rx), rh = (std::min)((th + (1 << d) - 1) >> d, tile->h - ry);
+						if (rw <= 0 || rh <= 0)
+							continue;
+						*region = { (*region)[0] + rx, (*region)[1] + ry, rw, rh };
+					}
+
+					c->tile(*region);
+					c->rect(sx0, sy0, sx1 - sx0, sy1 - sy0);
+				}
+			}
+			c->unclip();
+		}
+
+	private:
+		float minZoom() const {
+			return image_ ? 1.0f / float(1 << image_->levels()) : 1.0f;
+		}
+
+		// Coarsest level whose pixels are still no smaller than a screen pixel.
+		int level_() const {
+			int level = zoom_ >= 1.0f ? 0 : int(std::floor(std::log2(1.0f / zoom_)));
+			return std::clamp(level, 0, image_->levels() - 1);
+		}
+	};
+}
+
+#endif // UI_IMAGE_VIEW
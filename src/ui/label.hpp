@@ -5,6 +5,8 @@
 
 namespace ui {
 	struct Label : public Widget {
+		static constexpr int kTextSize = 24, kPadding = 8;
+
 		std::string text_;
 		uf::TextModel textModel_;
 
@@ -14,13 +16,21 @@ namespace ui {
 
 		void setText(std::string const& text) {
 			text_ = text;
+			invalidate();
+			relayout();
 		}
 		std::string const& text() const {
 			return text_;
 		}
 		virtual void onPaint(Canvas* c) override {
 			c->solid(col.white);
-			c->text(textModel_, text_, 24, x(), y(), w(), h());
+			c->text(textModel_, text_, kTextSize, x(), y(), w(), h());
+		}
+
+		SizeHint onMeasure(int, int) override {
+			auto [tw, th] = uf::CachedTextSize(text_, kTextSize);
+			int w = tw + 2 * kPadding, h = th + 2 * kPadding;
+			return { w, h, w, h };
 		}
 	};
 }
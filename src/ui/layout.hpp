@@ -13,10 +13,10 @@ namespace ui {
 		Layout() = default;
 		Layout(fDirection dir) : direction_(dir) {}
 
-		void setSpacingSize(int size) { spacingSize_ = size; }
-		void setChildAlignment(fAlignment a) { childAlignment_ = a; }
-		void setDirection(fDirection d) { direction_ = d; }
-		void setSpacing(fSpacing s) { spacing_ = s; }
+		void setSpacingSize(int size) { if (spacingSize_ != size) spacingSize_ = size, relayout(); }
+		void setChildAlignment(fAlignment a) { if (childAlignment_ != a) childAlignment_ = a, relayout(); }
+		void setDirection(fDirection d) { if (direction_ != d) direction_ = d, relayout(); }
+		void setSpacing(fSpacing s) { if (spacing_ != s) spacing_ = s, relayout(); }
 
 		fDirection direction() const { return direction_; }
 		fSpacing spacing() const { return spacing_; }
@@ -28,19 +28,45 @@ namespace ui {
 			if (direction_ == fVertical) onLayout_Vertical({ x, y, w, h });
 			if (direction_ == fHorizontal) onLayout_Horizontal({ x, y, w, h });
 		}
+
+		// Children one after another along the direction with the spacing between, the largest across it.
+		SizeHint onMeasure(int maxW, int maxH) override {
+			SizeHint s;
+			for (auto& ch : children()) {
+				SizeHint c = ch->measure(maxW, maxH);
+				if (direction_ == fVertical) {
+					s.minW = (std::max)(s.minW, c.minW), s.w = (std::max)(s.w, c.w);
+					s.minH += c.minH, s.h += c.h;
+				}
+				else if (direction_ == fHorizontal) {
+					s.minW += c.minW, s.w += c.w;
+					s.minH = (std::max)(s.minH, c.minH), s.h = (std::max)(s.h, c.h);
+				}
+				else {
+					s.minW = (std::max)(s.minW, c.minW), s.w = (std::max)(s.w, c.w);
+					s.minH = (std::max)(s.minH, c.minH), s.h = (std::max)(s.h, c.h);
+				}
+			}
+
+			int gaps = direction_ == fStacked || children().empty() ? 0 : int(children().size() - 1) * spacingSize_;
+			if (direction_ == fVertical) s.minH += gaps, s.h += gaps;
+			if (direction_ == fHorizontal) s.minW += gaps, s.w += gaps;
+			return s;
+		}
 	private:
 		void onLayout_Stacked(Rect const& r) {
 			for (int i = 0; i < children().size(); i++) {
 
-				float w = child(i)->xConstraint() == fFlex ? r.w : child(i)->xConstraint() == fRelative ? child(i)->xSize() * r.w : child(i)->xSize();
-				float h = child(i)->yConstraint() == fFlex ? r.h : child(i)->yConstraint() == fRelative ? child(i)->ySize() * r.h : child(i)->ySize();
+				SizeHint content = child(i)->xConstraint() == fContent || child(i)->yConstraint() == fContent ? child(i)->measure(r.w, r.h) : SizeHint{};
+				float w = child(i)->xConstraint() == fFlex ? r.w : child(i)->xConstraint() == fRelative ? child(i)->xSize() * r.w : child(i)->xConstraint() == fContent ? content.w : child(i)->xSize();
+				float h = child(i)->yConstraint() == fFlex ? r.h : child(i)->yConstraint() == fRelative ? child(i)->ySize() * r.h : child(i)->yConstraint() == fContent ? content.h : child(i)->ySize();
 				child(i)->layout( r.x, r.y, int16_t(w), int16_t(h) );
 			}
 		}
 
 		void onLayout_Vertical(Rect const& r) {
 			float yOffset = 0.0, temp_spacing = 0;
-			auto [staticH, totalFlexH, flexCount, staticCount] = dataVertical(r.h);
+			auto [staticH, totalFlexH, flexCount, staticCount] = dataVertical(r);
 
 			if (flexCount == 0) {
 				if (childAlignment() == fLeading && spacing() == fSpaceNormal) yOffset = 0;
@@ -63,6 +89,7 @@ namespace ui {
 				float childH = child->ySize();
 				if (child->yConstraint() == fFlex) childH = totalFlexH * (childH / (float)flexCount);
 				else if (child->yConstraint() == fRelative) childH = childH * r.h;
+				else if (child->yConstraint() == fContent) childH = child->measure(r.w, r.h).h;
 
 				child->layout( r.x, int16_t(r.y + yOffset), r.w, (int16_t)childH);
 				yOffset += childH;
@@ -72,7 +99,7 @@ namespace ui {
 
 		void onLayout_Horizontal(Rect const& r) {
 			float xOffset = 0.0, temp_spacing = 0;
-			auto [staticW, totalFlexW, flexCount, staticCount] = dataHorizontal(r.w);
+			auto [staticW, totalFlexW, flexCount, staticCount] = dataHorizontal(r);
 
 			if (flexCount == 0) {
 				if (childAlignment() == fLeading && spacing() == fSpaceNormal) xOffset = 0;
@@ -96,6 +123,7 @@ namespace ui {
 				float childW = child->xSize();
 				if (child->xConstraint() == fFlex) childW = totalFlexW * (childW / (float)flexCount);
 				else if (child->xConstraint() == fRelative) childW = childW * r.w;
+				else if (child->xConstraint() == fContent) childW = child->measure(r.w, r.h).w;
 
 				child->layout(int16_t(r.x + xOffset), r.y, int16_t(childW) , r.h);
 				xOffset += childW;
@@ -103,7 +131,8 @@ namespace ui {
 			}
 		}
 
-		std::tuple<int, int, int, int> dataVertical(float rh) {
+		std::tuple<int, int, int, int> dataVertical(Rect const& r) {
+			float rh = r.h;
 			int staticH = 0, staticCount = 0, visibleCount = 0, flexCount = 0;
 
 			for (auto& child : children()) {
@@ -111,6 +140,8 @@ namespace ui {
 					staticH += child->ySize(), ++staticCount;
 				if (child->yConstraint() == fRelative)
 					staticH += rh * child->ySize(), ++staticCount;
+				if (child->yConstraint() == fContent)
+					staticH += child->measure(r.w, r.h).h, ++staticCount;
 				if (child->yConstraint() == fFlex)
 					flexCount += child->ySize();
 
@@ -123,7 +154,8 @@ namespace ui {
 			return std::make_tuple(staticH, totalFlexSpace, flexCount, staticCount);
 		}
 
-		std::tuple<int, int, int, int> dataHorizontal(float rw) {
+		std::tuple<int, int, int, int> dataHorizontal(Rect const& r) {
+			float rw = r.w;
 			int staticW = 0, staticCount = 0, visibleCount = 0, flexCount = 0;
 
 			for (auto& child : children()) {
@@ -131,6 +163,8 @@ namespace ui {
 					staticW += child->xSize(), ++staticCount;
 				if (child->xConstraint() == fRelative)
 					staticW += rw * child->xSize(), ++staticCount;
+				if (child->xConstraint() == fContent)
+					staticW += child->measure(r.w, r.h).w, ++staticCount;
 				if (child->xConstraint() == fFlex)
 					flexCount += child->xSize();
 
@@ -34,23 +34,33 @@ namespace ui {
 			}
 		}
 
+		// the widest item by every row
+		SizeHint onMeasure(int, int) override {
+			int w = 0;
+			for (auto const& item : items)
+				w = (std::max)(w, uf::CachedTextSize(item, 48).first + 16);
+			int h = int(items.size()) * itemHeight_;
+			return { w, h, w, h };
+		}
+
 		void onMouseMove(MouseEvent* me) {
-			bool highlighted = false;
+			int index = -1;
 			for (int i = 0; i < items.size(); i++) {
 				if (me->y() >= this->y() + i * itemHeight_ && me->y() <= this->y() + (i + 1) * itemHeight_) {
-					highlightIndex = i, highlighted = true;
+					index = i;
 				}
 			}
 
-			if (!highlighted) 
-				highlightIndex = -1;
+			if (highlightIndex != index)
+				highlightIndex = index, invalidate();
 		}
 
 		void onMousePress(MouseEvent* me) override {
 			if (me->left()) {
 				int index = indexAt(me->x(), me->y());
 				if (index != -1 && onSelect_) {
-					selectedIndex = index;
+					if (selectedIndex != index)
+						selectedIndex = index, invalidate();
 					onSelect_(items[index]);
 				}
 			}
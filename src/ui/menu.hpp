@@ -60,7 +60,8 @@ namespace ui {
 		void onMousePress(MouseEvent* me) override {
 			if (submenu->window() == nullptr) {
 				auto [wx, wy] = root()->window()->screenPos(x() + w(), y());
-				submenu->makeWindow(wx, wy, w(), 50 * submenu->children().size(), fTransient);
+				SizeHint size = submenu->measure(w(), h());
+				submenu->makeWindow(wx, wy, (std::max)(w(), size.w), size.h, fTransient);
 				submenu->window()->show();
 				submenu->window()->removeTitleBarAndButtons();
 			}
@@ -21,7 +21,7 @@ namespace ui {
 		}
 
 		void onMouseWheel(MouseEvent* me) override {
-			scrollOffset_ += me->wheelUp() ? -20 : 20;
+			setScrollOffset(scrollOffset_ + (me->wheelUp() ? -20 : 20));
 
 			me->setIgnored(true);
 		}
@@ -38,6 +38,8 @@ namespace ui {
 
 		void setScrollOffset(int offset) {
 			scrollOffset_ = offset;
+			invalidate();
+			relayout();
 		}
 
 		int scrollOffset() const {
@@ -46,6 +48,7 @@ namespace ui {
 
 		void setScrollbarVisible(bool v) {
 			scrollbarVisible_ = v;
+			invalidate();
 		}
 
 		bool scrollbarVisible() const {
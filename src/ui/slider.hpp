@@ -19,7 +19,9 @@ namespace ui {
 		}
 
 		void onDragMove(DragEvent* e) {
-			weight_ = float((e->x() - x())) / float(w());
+			float weight = float((e->x() - x())) / float(w());
+			if (weight_ != weight)
+				weight_ = weight, invalidate();
 		}
 
 		void onPaint(Canvas* c) {
@@ -45,6 +45,7 @@ namespace ui {
 				return;
 
 			handleWeight = std::clamp(newWeight(de->y()), minWeight, maxWeight);
+			relayout();
 		}
 
 	private:
@@ -97,6 +98,7 @@ namespace ui {
 				return;
 
 			handleWeight = std::clamp(newWeight(de->x()), minWeight, maxWeight);
+			relayout();
 		}
 
 	private:
@@ -68,6 +68,8 @@ namespace ui {
 				return;
 			std::swap(headerRow_->children()[index1], headerRow_->children()[index2]);
 			std::swap(content_->children()[index1], content_->children()[index2]);
+			headerRow_->relayout();
+			content_->relayout();
 			
 			if (currentIndex_ == index1)
 				changeTab_(index2);
@@ -56,6 +56,7 @@ namespace ui {
 
             parent->children_.emplace_back(text, parent);
             Item* added = &parent->children_.back();
+            invalidate();
 
             if (itemAdded)
                 itemAdded(added);
@@ -74,6 +75,7 @@ namespace ui {
                     [&](Item const& c) { return c.text_ == text; }),
                 siblings.end()
             );
+            invalidate();
 
             if (itemRemoved)
                 itemRemoved(item);
@@ -84,7 +86,8 @@ namespace ui {
             if (!item)
                 return;
 
-            item->selected_ = true;
+            if (!item->selected_)
+                item->selected_ = true, invalidate();
             if (itemSelected)
                 itemSelected(item);
         }
@@ -126,6 +129,7 @@ namespace ui {
 
             if (Item* item = itemAt(me->x(), me->y())) {
                 item->selected_ = !item->selected_;
+                invalidate();
                 if (itemSelected)
                     itemSelected(item);
             }
@@ -137,6 +141,7 @@ namespace ui {
 
             if (Item* item = itemAt(me->x(), me->y())) {
                 item->expanded_ = !item->expanded_;
+                invalidate();
             }
         }
 
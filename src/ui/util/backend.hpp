@@ -8,6 +8,9 @@
 #include "widget.hpp"
 
 #include <set>
+#include <deque>
+#include <queue>
+#include <chrono>
 
 namespace ui {
 	/*
@@ -18,12 +21,18 @@ namespace ui {
 	*/
 	class Backend {
 		std::unique_ptr<ui::Canvas> canvas_;
+		std::shared_ptr<ImageAtlas> masks_, images_;
 
 		std::optional<int> FocusWidgetID;
 		std::optional<int> DragStartWidgetID;
 		std::optional<int> ModalWidgetID;
 
+#ifdef UI_PLATFORM_WIN32
 		std::queue<WindowMessage> messages;
+#endif
+		std::deque<InputEvent> input_;
+		Clock clock_;
+		LayerCache layers_;
 
 		std::map<size_t, std::unique_ptr<Native>> windows;
 		std::map<size_t, Widget*> widgets;
@@ -32,32 +41,46 @@ namespace ui {
 		std::set<int> windowsToErase;
 		std::set<Widget*> widgetsToErase;
 	public:
-		Backend(std::string const& asset_str, std::string font_name, int fSize) {
-			canvas_ = std::make_unique<ui::Canvas>(asset_str, font_name, fSize);
+		// Wall time of each phase of the last update(), in milliseconds.
+		struct FrameTimes {
+			double events = 0, animation = 0, layout = 0, postLayout = 0, paint = 0;
+		};
 
+		// Every input as it is translated with the clock's time, platform messages included. See InputRecorder.
+		std::optional<std::function<void(double, InputEvent const&)>> onInput;
+
+		Backend(std::string const& asset_str, std::string font_name, int fSize) :
+			Backend(ImageAtlas::shared(asset_str + "/icons", ImageAtlas::ALPHA), ImageAtlas::shared(asset_str + "/images", ImageAtlas::RGB)) {
+			if (!uf::gLoaded)
+				uf::LoadGlobal(font_name, fSize);
+		}
+
+		// Every window canvas shares these atlases, nothing is reloaded per window.
+		Backend(std::shared_ptr<ImageAtlas> masks, std::shared_ptr<ImageAtlas> images) : masks_(masks), images_(images) {
+			canvas_ = std::make_unique<ui::Canvas>(masks_, images_);
+			Widget::layerCache = &layers_;
+
+#ifdef UI_PLATFORM_WIN32
 			onMessage = [&](WindowMessage const& wm) {
 				messages.emplace(wm);
 				
-				if (wm.msg == WM_SETFOCUS && windows[wm.wID]->type() == fPersistent) {
-					for (auto& [id, widget] : widgets) {
-						if (windows[id]->type() == fTransient) {
-							windowsToErase.insert(id);
-						}
-					}
-				}
+				if (wm.msg == WM_SETFOCUS)
+					focusChanged_(wm.wID);
 			};
+#endif
 
 			onEvent = [&](Event* e) {
-				std::cout << e->description() << std::endl;
 				for (auto& [id, widget] : widgets) 
 					if (e->windowID() == id) widget->event(e);
 			};
 
-			Widget::onMakeTopLevel = [&, a = asset_str, fn = font_name, fs = fSize](Widget* w, int x, int y, int w_, int h_, eNativeType type) {
+			Widget::onMakeTopLevel = [&](Widget* w, int x, int y, int w_, int h_, eNativeType type) {
 				windows[w->id()] = std::make_unique<Native>(w->id(), x, y, w_, h_, type);
 				widgets[w->id()] = w;
-				canvases[w->id()] = std::make_unique<Canvas>(a, fn, fs);
+				canvases[w->id()] = std::make_unique<Canvas>(masks_, images_);
+#ifdef UI_PLATFORM_WIN32
 				setMouseTracking(true, windows[w->id()]->hwnd());
+#endif
 			};
 
 			Widget::onRemoveTopLevel = [&](int id) {
@@ -73,37 +96,80 @@ namespace ui {
 			};
 		}
 
+		~Backend() {
+			if (Widget::layerCache == &layers_)
+				Widget::layerCache = nullptr;
+		}
+
+		// Runs one frame with the backend's clock as the animation time.
+		bool update() {
+			return update(float(clock_.now()));
+		}
+
+		// dt is the animation time in seconds, see Animate::Update.
 		bool update(float dt) {
+			auto mark = std::chrono::steady_clock::now();
+			auto phase = [&](double& ms) {
+				auto now = std::chrono::steady_clock::now();
+				ms = std::chrono::duration<double, std::milli>(now - mark).count();
+				mark = now;
+			};
+
 			// Event Handling
+#ifdef UI_PLATFORM_WIN32
 			while (!messages.empty()) {
 				auto& wm = messages.front();
+				if (onInput) {
+					if (auto in = MsgToInput(wm.wID, wm.msg, wm.wp, wm.lp))
+						onInput.value()(clock_.now(), *in);
+				}
 				RawMsgToEvent(wm.wID, wm.hwnd, wm.msg, wm.wp, wm.lp);
 				messages.pop();
 			}
+#endif
+
+			// Injected input, after the platform's own so a replay sees a settled queue
+			while (!input_.empty()) {
+				InputEvent in = input_.front();
+				input_.pop_front();
+				translate_(in);
+			}
 			
+#ifdef UI_PLATFORM_WIN32
 			// Event Polling
 			MSG msg;
 			while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
 				TranslateMessage(&msg);
 				DispatchMessage(&msg);
 			}
+#endif
+
+			// Work other threads handed back, decoded tiles and the like
+			UiQueue::shared().run();
+
+			phase(times_.events);
 
 			// Animations
 			Animate::Update(dt);
+			phase(times_.animation);
 
 			// Layout
 			for (auto& [id, widget] : widgets) {
 				widget->layout(0, 0, windows[id]->width(), windows[id]->height());
 			}
+			phase(times_.layout);
 
 			for (auto& [id, widget] : widgets) {
 				widget->postLayout();
 			}
+			phase(times_.postLayout);
 			
 			// Extracting Paint Data
 			for (auto& [id, widget] : widgets) {
+				canvases[id]->setViewport(0, 0, windows[id]->width(), windows[id]->height());
 				widget->paint(canvases[id].get());
 			}
+			phase(times_.paint);
 			
 
 			// Deleteing Windows
@@ -127,6 +193,21 @@ namespace ui {
 			return canvas_.get();
 		}
 
+		// Queues input for the next update(), translated in order as if the window system sent it.
+		void post(InputEvent const& e) {
+			input_.push_back(e);
+		}
+
+		Clock& clock() { return clock_; }
+		LayerCache& layers() { return layers_; }
+		FrameTimes const& frameTimes() const { return times_; }
+
+		Native* window(int id) {
+			auto it = windows.find(id);
+			return it == windows.end() ? nullptr : it->second.get();
+		}
+
+#ifdef UI_PLATFORM_WIN32
 		void setMouseTracking(bool enable, HWND hwnd, UINT hoverTimeMs = HOVER_DEFAULT) {
 			TRACKMOUSEEVENT tme = { sizeof(TRACKMOUSEEVENT) };
 
@@ -152,9 +233,13 @@ namespace ui {
 			// Try modern API first
 			SetProcessDPIAware();	
 		}
+#else
+		void setMouseDoubleClickTime(unsigned) {}
+		void setProcessDpiAware() {}
+#endif
 
-		std::vector<std::tuple<Canvas*, int, int, HDC>> extractCanvases() {
-			std::vector<std::tuple<Canvas*, int, int, HDC>> result;
+		std::vector<std::tuple<Canvas*, int, int, Surface>> extractCanvases() {
+			std::vector<std::tuple<Canvas*, int, int, Surface>> result;
 			for (auto& [id, canvas] : canvases) {
 				result.emplace_back(canvas.get(), windows[id]->width(), windows[id]->height(), windows[id]->hdc());
 			}
@@ -162,8 +247,50 @@ namespace ui {
 		}
 
 	private:
+		FrameTimes times_;
+
+		// Focusing a persistent window closes the transient ones, menus and dropdowns.
+		void focusChanged_(int windowID) {
+			auto it = windows.find(windowID);
+			if (it == windows.end() || it->second->type() != fPersistent)
+				return;
+			for (auto& [id, widget] : widgets) {
+				if (windows[id]->type() == fTransient) {
+					windowsToErase.insert(id);
+				}
+			}
+		}
+
+		void translate_(InputEvent const& in) {
+			if (onInput)
+				onInput.value()(clock_.now(), in);
+
+			auto it = windows.find(in.windowID);
+			if (it == windows.end())
+				return;
+
+			switch (in.kind) {
+			case InputEvent::eResize:
+				it->second->setSize(in.x, in.y);
+				break;
+			case InputEvent::eFocus:
+				focusChanged_(in.windowID);
+				break;
+#ifdef UI_PLATFORM_HEADLESS
+			case InputEvent::eMouseMove: case InputEvent::eMousePress: case InputEvent::eMouseRelease: case InputEvent::eMouseDoublePress:
+				it->second->setMousePos(in.x, in.y);
+				break;
+#endif
+			default:
+				break;
+			}
+			InputToEvent(in);
+		}
+
 		void deleteWidget(Widget* w) {
 			if (w->parent() != nullptr) {
+				w->parent()->invalidate();
+				w->parent()->relayout();
 				auto& siblings = w->parent()->children();
 				siblings.erase(std::remove_if(siblings.begin(), siblings.end(),
 					[&](const std::unique_ptr<Widget>& child) { return child.get() == w; }), siblings.end());
@@ -173,4 +300,4 @@ namespace ui {
 }
 
 
-#endif UI_BACKEND
\ No newline at end of file
+#endif // UI_BACKEND
\ No newline at end of file
@@ -0,0 +1,199 @@
+#ifndef UI_BATCH
+#define UI_BATCH
+
+#include "packed.hpp"
+
+#include <vector>
+#include <cstdint>
+#include <utility>
+#include <algorithm>
+
+namespace ui {
+	// One axis of a nine-patch, screen edges and region texels of its lead, middle and trail parts.
+	// Insets keep their texel size on screen, a rect shorter than both shrinks them in proportion.
+	// With no insets it is a plain stretch of the region over the rect.
+	struct NinePatchAxis {
+		int edges[4], texels[4];
+	};
+
+	inline NinePatchAxis nine_patch_axis(int pos, int length, int src, int srcLength, int lead, int trail) {
+		lead = std::clamp(lead, 0, (std::max)(srcLength, 0)), trail = std::clamp(trail, 0, (std::max)(srcLength - lead, 0));
+		int sl = lead, st = trail;
+		if (lead + trail > length) {
+			sl = length > 0 ? lead * length / (lead + trail) : 0;
+			st = (std::max)(length, 0) - sl;
+		}
+		return { { pos, pos + sl, pos + length - st, pos + length }, { src, src + lead, src + srcLength - trail, src + srcLength } };
+	}
+
+	// Consecutive draw slots that share a GPU path, type is -1 when the run mixes primitives.
+	struct DrawBatch {
+		uint32_t first, count;
+		int type;
+		bool opaque;
+	};
+
+	/*
+		Turns the recorded layers into the order the renderer draws in. Opaque objects go first, front
+		to back and sorted by primitive type then brush, so each type is one batch and early-z rejects
+		whatever they cover. The rest follow back to front in painter's order, blended, without depth
+		writes. Every slot keeps the depth of its recorded position, so overlapping objects resolve as
+		painted whichever pass draws them. Both passes are O(n), the opaque one is an LSD radix sort.
+	*/
+	class DrawOrder {
+	public:
+		static constexpr int kPaintSolid = 0, kPaintLinear = 1, kPaintRadial = 2, kPaintConical = 3, kPaintImage = 4; // Canvas::eStroke values
+		static constexpr int kRect = 1, kNinePatch = 7; // Canvas::eType values
+
+		using Range = std::pair<RenderObject const*, size_t>;
+
+		// ranges are the layers top first, each newest first, as FramePacket::ranges() gives them.
+		// Nine-patches are split into a plain rect per cell here, drawn with the cell paints their
+		// record lists, so the GPU only ever sees rects sampling a region.
+		void build(Range const* ranges, size_t count, int const* data, int const* paints) {
+			sources_.clear();
+			keys_.clear();
+			translucent_.clear();
+			order_.clear();
+			batches_.clear();
+			cells_.clear();
+
+			size_t patches = 0;
+			for (size_t r = 0; r < count; r++)
+				for (size_t i = 0; i < ranges[r].second; i++)
+					patches += ranges[r].first[i].type == kNinePatch;
+			cells_.reserve(patches * 9); // sources_ points into it
+
+			auto add = [&](RenderObject const* ro) {
+				uint32_t rank = uint32_t(sources_.size());
+				sources_.push_back(ro);
+				if (opaque_(*ro, paints))
+					keys_.push_back({ uint32_t(ro->type & 0xFF) << 24 | (uint32_t(ro->brushIndex) & 0xFFFFFF), rank });
+				else
+					translucent_.push_back(rank);
+			};
+
+			for (size_t r = 0; r < count; r++) {
+				auto [objects, n] = ranges[r];
+				for (size_t i = 0; i < n; i++) {
+					if (objects[i].type != kNinePatch) {
+						add(objects + i);
+						continue;
+					}
+					size_t first = cells_.size();
+					split_(objects[i], data, paints);
+					for (size_t c = first; c < cells_.size(); c++)
+						add(&cells_[c]);
+				}
+			}
+
+			sort_();
+			for (auto const& k : keys_) {
+				int type = int(k.key >> 24);
+				if (batches_.empty() || batches_.back().type != type)
+					batches_.push_back({ uint32_t(order_.size()), 0, type, true });
+				batches_.back().count++;
+				order_.push_back(k.rank);
+			}
+
+			if (!translucent_.empty()) {
+				DrawBatch batch{ uint32_t(order_.size()), uint32_t(translucent_.size()), sources_[translucent_.back()]->type, false };
+				for (auto it = translucent_.rbegin(); it != translucent_.rend(); ++it) {
+					if (sources_[*it]->type != batch.type)
+						batch.type = -1;
+					order_.push_back(*it);
+				}
+				batches_.push_back(batch);
+			}
+		}
+
+		// Per draw slot the object's painter's rank, 0 frontmost. Uploaded as the slot's depth.
+		std::vector<uint32_t> const& order() const { return order_; }
+		std::vector<DrawBatch> const& batches() const { return batches_; }
+		size_t size() const { return order_.size(); }
+
+		RenderObject const& operator[](size_t slot) const { return *sources_[order_[slot]]; }
+
+		void encode(PackedObject* out) const {
+			for (size_t i = 0; i < order_.size(); i++)
+				out[i] = ui::encode(*sources_[order_[i]]);
+		}
+
+	private:
+		struct Key {
+			uint32_t key, rank;
+		};
+
+		std::vector<RenderObject const*> sources_;
+		std::vector<RenderObject> cells_;
+		std::vector<Key> keys_, scratch_;
+		std::vector<uint32_t> translucent_, order_;
+		std::vector<DrawBatch> batches_;
+
+		// record at r1: left, top, right, bottom insets then the nine cell paints row by row, -1 when empty
+		void split_(RenderObject const& ro, int const* data, int const* paints) {
+			if (ro.brushIndex < 0 || ro.r1 < 0)
+				return;
+			int const* region = paints + ro.brushIndex + 2;
+			int const* record = data + ro.r1;
+			NinePatchAxis ax = nine_patch_axis(ro.x, ro.w, region[0], region[2], record[0], record[2]);
+			NinePatchAxis ay = nine_patch_axis(ro.y, ro.h, region[1], region[3], record[1], record[3]);
+			for (int j = 0; j < 3; j++) {
+				for (int i = 0; i < 3; i++) {
+					RenderObject cell = ro;
+					cell.type = kRect, cell.brushIndex = record[4 + j * 3 + i], cell.penIndex = -1, cell.maskIndex = -1, cell.r1 = 0;
+					cell.x = ax.edges[i], cell.w = ax.edges[i + 1] - ax.edges[i];
+					cell.y = ay.edges[j], cell.h = ay.edges[j + 1] - ay.edges[j];
+					if (cell.brushIndex >= 0 && cell.w > 0 && cell.h > 0)
+						cells_.push_back(cell);
+				}
+			}
+		}
+
+		static bool opaqueColor_(int c) {
+			return (c & 0xFF) == 0xFF;
+		}
+
+		// image pages are RGB, tiles and render targets may carry alpha
+		static bool opaquePaint_(int const* p) {
+			switch (p[0]) {
+			case kPaintSolid: return opaqueColor_(p[2]);
+			case kPaintLinear: case kPaintRadial: case kPaintConical: return opaqueColor_(p[2]) && opaqueColor_(p[3]);
+			case kPaintImage: return true;
+			default: return false;
+			}
+		}
+
+		// Only plain filled rects cover every pixel of their rect, the other primitives antialias
+		// their edges and borders may too.
+		static bool opaque_(RenderObject const& ro, int const* paints) {
+			return ro.type == kRect && ro.brushIndex >= 0 && ro.penIndex < 0 && ro.maskIndex < 0 && opaquePaint_(paints + ro.brushIndex);
+		}
+
+		// Stable, 8 bits per pass. Passes where every key has the same digit are skipped, which
+		// is most of them since keys only differ by type and brush.
+		void sort_() {
+			size_t n = keys_.size();
+			scratch_.resize(n);
+			for (int shift = 0; shift < 32; shift += 8) {
+				uint32_t counts[256] = {};
+				for (auto const& k : keys_)
+					counts[(k.key >> shift) & 0xFF]++;
+				if (n == 0 || counts[(keys_[0].key >> shift) & 0xFF] == n)
+					continue;
+
+				uint32_t offset = 0;
+				for (auto& c : counts) {
+					uint32_t next = offset + c;
+					c = offset;
+					offset = next;
+				}
+				for (auto const& k : keys_)
+					scratch_[counts[(k.key >> shift) & 0xFF]++] = k;
+				keys_.swap(scratch_);
+			}
+		}
+	};
+}
+
+#endif // UI_BATCH
@@ -0,0 +1,214 @@
+#ifndef UI_BINNING
+#define UI_BINNING
+
+#include "misc.hpp"
+#include "parallel.hpp"
+#include "damage.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <array>
+#include <utility>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UI_BINNING_SSE2
+#endif
+
+namespace ui {
+	/*
+		Which objects touch each kTileSize screen tile, as one index list per tile stored back to back
+		(offsets() has tileCount() + 1 entries). Indices are positions in the concatenated ranges,
+		the same painter's rank DrawOrder uses, and every list is ascending, so front to back.
+
+		Objects are split into chunks that are binned on their own threads: a count pass, a prefix
+		sum over (tile, chunk) and a scatter pass. Chunks are placed in order within each tile, which
+		keeps the lists sorted without a merge.
+	*/
+	class TileBins {
+	public:
+		static constexpr int kTileShift = 6, kTileSize = 1 << kTileShift;
+		static constexpr size_t kChunkObjects = 8192; // fewer objects per thread than this is not worth waking a pool worker
+
+		using Range = std::pair<RenderObject const*, size_t>;
+
+		void build(Range const* ranges, size_t count, int const* data, int const* paints, int viewportW, int viewportH) {
+			viewportW_ = viewportW, viewportH_ = viewportH;
+			tilesX_ = (std::max)(0, (viewportW + kTileSize - 1) >> kTileShift);
+			tilesY_ = (std::max)(0, (viewportH + kTileSize - 1) >> kTileShift);
+			int tiles = tilesX_ * tilesY_;
+
+			objects_.clear();
+			for (size_t r = 0; r < count; r++)
+				for (size_t i = 0; i < ranges[r].second; i++)
+					objects_.push_back(ranges[r].first + i);
+
+			size_t n = objects_.size();
+			int chunks = int((std::max)(size_t(1), (std::min)(size_t(hardware_threads()), (n + kChunkObjects - 1) / kChunkObjects)));
+			size_t per = (n + chunks - 1) / chunks;
+
+			rects_.resize(n);
+			counts_.assign(size_t(chunks) * tiles, 0);
+			offsets_.assign(size_t(tiles) + 1, 0);
+			if (tiles == 0 || n == 0) {
+				indices_.clear();
+				return;
+			}
+
+			int stride = tilesX_;
+			parallel_for(0, chunks, [&](int c) {
+				uint32_t* counts = counts_.data() + size_t(c) * tiles;
+				TileRect* rects = rects_.data();
+				RenderObject const* const* objects = objects_.data();
+				size_t i = c * per, end = (std::min)(n, (c + 1) * per);
+#ifdef UI_BINNING_SSE2
+				for (; i + 4 <= end; i += 4) {
+					alignas(16) int edges[4][4]; // edge, then object
+					for (int k = 0; k < 4; k++) {
+						auto b = DamageTracker::bounds(*objects[i + k], data, paints);
+						edges[0][k] = b[0], edges[1][k] = b[1], edges[2][k] = b[2], edges[3][k] = b[3];
+					}
+					tileRects4_(edges, rects + i);
+				}
+#endif
+				for (; i < end; i++)
+					tileRect_(DamageTracker::bounds(*objects[i], data, paints), rects[i]);
+
+				for (i = c * per; i < end; i++) {
+					TileRect t = rects[i];
+					if (t.x0 == t.x1 && t.y0 == t.y1) {
+						counts[t.y0 * stride + t.x0]++;
+						continue;
+					}
+					for (int ty = t.y0; ty <= t.y1; ty++)
+						for (int tx = t.x0; tx <= t.x1; tx++)
+							counts[ty * stride + tx]++;
+				}
+			});
+
+			// counts become each chunk's write position within the tile
+			uint32_t total = 0;
+			for (int t = 0; t < tiles; t++) {
+				offsets_[t] = total;
+				for (int c = 0; c < chunks; c++) {
+					uint32_t& k = counts_[size_t(c) * tiles + t];
+					uint32_t next = total + k;
+					k = total;
+					total = next;
+				}
+			}
+			offsets_[tiles] = total;
+			indices_.resize(total);
+
+			parallel_for(0, chunks, [&](int c) {
+				uint32_t* cursor = counts_.data() + size_t(c) * tiles;
+				uint32_t* indices = indices_.data();
+				TileRect const* rects = rects_.data();
+				for (size_t i = c * per, end = (std::min)(n, (c + 1) * per); i < end; i++) {
+					TileRect t = rects[i];
+					if (t.x0 == t.x1 && t.y0 == t.y1) {
+						indices[cursor[t.y0 * stride + t.x0]++] = uint32_t(i);
+						continue;
+					}
+					for (int ty = t.y0; ty <= t.y1; ty++)
+						for (int tx = t.x0; tx <= t.x1; tx++)
+							indices[cursor[ty * stride + tx]++] = uint32_t(i);
+				}
+			});
+		}
+
+		int tilesX() const { return tilesX_; }
+		int tilesY() const { return tilesY_; }
+		int tileCount() const { return tilesX_ * tilesY_; }
+
+		// Objects touching a tile, front to back.
+		Span<uint32_t const> tile(int tx, int ty) const {
+			int t = ty * tilesX_ + tx;
+			return { indices_.data() + offsets_[t], size_t(offsets_[t + 1] - offsets_[t]) };
+		}
+
+		RenderObject const& object(uint32_t index) const { return *objects_[index]; }
+
+		// x, y, w, h of a tile in pixels, edge tiles reach past the viewport.
+		std::array<int, 4> tileRect(int tx, int ty) const {
+			return { tx << kTileShift, ty << kTileShift, kTileSize, kTileSize };
+		}
+
+		// Tiles a damage region overlaps, each listed once.
+		void tiles(DamageRegion const& region, std::vector<int>& out) const {
+			out.clear();
+			stamps_.assign(size_t(tileCount()), 0);
+			for (auto const& [x, y, w, h] : region.rects) {
+				TileRect t;
+				if (!tileRect_({ x, y, x + w, y + h }, t))
+					continue;
+				for (int ty = t.y0; ty <= t.y1; ty++)
+					for (int tx = t.x0; tx <= t.x1; tx++)
+						if (!stamps_[ty * tilesX_ + tx])
+							stamps_[ty * tilesX_ + tx] = 1, out.push_back(ty * tilesX_ + tx);
+			}
+		}
+
+		std::vector<uint32_t> const& offsets() const { return offsets_; }
+		std::vector<uint32_t> const& indices() const { return indices_; }
+
+	private:
+		// inclusive tile range, empty when x1 < x0
+		struct TileRect {
+			int x0, y0, x1, y1;
+		};
+
+		int viewportW_ = 0, viewportH_ = 0, tilesX_ = 0, tilesY_ = 0;
+		std::vector<RenderObject const*> objects_;
+		std::vector<TileRect> rects_;
+		std::vector<uint32_t> counts_, offsets_, indices_;
+		mutable std::vector<uint8_t> stamps_;
+
+		// Pixel edges to the inclusive tile range, clamped to the grid. Returns false, with an
+		// empty range, when the bounds are empty or off screen.
+		bool tileRect_(std::array<int, 4> const& b, TileRect& t) const {
+			t = { 0, 0, -1, -1 };
+			if (b[2] <= b[0] || b[3] <= b[1] || b[2] <= 0 || b[3] <= 0 || b[0] >= viewportW_ || b[1] >= viewportH_)
+				return false;
+			t.x0 = (std::max)(b[0] >> kTileShift, 0), t.y0 = (std::max)(b[1] >> kTileShift, 0);
+			t.x1 = (std::min)((b[2] - 1) >> kTileShift, tilesX_ - 1), t.y1 = (std::min)((b[3] - 1) >> kTileShift, tilesY_ - 1);
+			return true;
+		}
+
+#ifdef UI_BINNING_SSE2
+		static __m128i clamp_(__m128i v, __m128i hi) {
+			v = _mm_and_si128(v, _mm_cmpgt_epi32(v, _mm_setzero_si128()));
+			__m128i over = _mm_cmpgt_epi32(v, hi);
+			return _mm_or_si128(_mm_and_si128(over, hi), _mm_andnot_si128(over, v));
+		}
+
+		// tileRect_ for four objects at once, edges holds x0, y0, x1, y1 rows of four.
+		void tileRects4_(int const (&edges)[4][4], TileRect* out) const {
+			__m128i x0 = _mm_load_si128((__m128i const*)edges[0]), y0 = _mm_load_si128((__m128i const*)edges[1]);
+			__m128i x1 = _mm_load_si128((__m128i const*)edges[2]), y1 = _mm_load_si128((__m128i const*)edges[3]);
+			__m128i zero = _mm_setzero_si128(), one = _mm_set1_epi32(1);
+
+			__m128i visible = _mm_and_si128(_mm_cmpgt_epi32(x1, x0), _mm_cmpgt_epi32(y1, y0));
+			visible = _mm_and_si128(visible, _mm_and_si128(_mm_cmpgt_epi32(x1, zero), _mm_cmpgt_epi32(y1, zero)));
+			visible = _mm_and_si128(visible, _mm_and_si128(_mm_cmplt_epi32(x0, _mm_set1_epi32(viewportW_)), _mm_cmplt_epi32(y0, _mm_set1_epi32(viewportH_))));
+
+			__m128i hx = _mm_set1_epi32(tilesX_ - 1), hy = _mm_set1_epi32(tilesY_ - 1);
+			__m128i tx0 = _mm_and_si128(clamp_(_mm_srai_epi32(x0, kTileShift), hx), visible);
+			__m128i ty0 = _mm_and_si128(clamp_(_mm_srai_epi32(y0, kTileShift), hy), visible);
+			__m128i tx1 = _mm_or_si128(clamp_(_mm_srai_epi32(_mm_sub_epi32(x1, one), kTileShift), hx), _mm_xor_si128(visible, _mm_set1_epi32(-1)));
+			__m128i ty1 = _mm_or_si128(clamp_(_mm_srai_epi32(_mm_sub_epi32(y1, one), kTileShift), hy), _mm_xor_si128(visible, _mm_set1_epi32(-1)));
+
+			// rows of four objects to one TileRect per object
+			__m128i a = _mm_unpacklo_epi32(tx0, ty0), b = _mm_unpacklo_epi32(tx1, ty1);
+			__m128i c = _mm_unpackhi_epi32(tx0, ty0), d = _mm_unpackhi_epi32(tx1, ty1);
+			_mm_storeu_si128((__m128i*)(out + 0), _mm_unpacklo_epi64(a, b));
+			_mm_storeu_si128((__m128i*)(out + 1), _mm_unpackhi_epi64(a, b));
+			_mm_storeu_si128((__m128i*)(out + 2), _mm_unpacklo_epi64(c, d));
+			_mm_storeu_si128((__m128i*)(out + 3), _mm_unpackhi_epi64(c, d));
+		}
+#endif
+	};
+}
+
+#endif // UI_BINNING
@@ -0,0 +1,144 @@
+#ifndef UI_BLUR
+#define UI_BLUR
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UI_BLUR_SSE2
+#endif
+
+namespace ui {
+	/*
+		Separable blurs of single channel 8 bit images, used for shadow and coverage textures.
+
+		box_blur_v      - one vertical box pass, 16 columns at a time with SSE2
+		transpose_8     - swaps rows and columns in 16 x 16 blocks, so horizontal passes run as vertical ones
+		gaussian_blur   - three box passes each way, close to a Gaussian of the given sigma
+
+		Pixels outside the image count as 0. Box windows are at most kMaxBoxWindow wide so the running
+		sums fit 16 bit lanes, wider radii are clamped.
+	*/
+	constexpr int kMaxBoxWindow = 255;
+
+	// Window sums are divided with a 16 bit reciprocal, the scalar and SSE2 paths round the same way.
+	inline uint8_t box_divide_(uint32_t sum, uint32_t half, uint32_t inv) {
+		return uint8_t(((sum + half) * inv) >> 16);
+	}
+
+	// dst row y is the mean of src rows y - radius to y + radius. src and dst may not overlap.
+	inline void box_blur_v(uint8_t const* src, uint8_t* dst, int w, int h, int stride, int radius) {
+		radius = std::clamp(radius, 0, (kMaxBoxWindow - 1) / 2);
+		if (radius == 0) {
+			for (int y = 0; y < h; y++)
+				std::memcpy(dst + size_t(y) * stride, src + size_t(y) * stride, w);
+			return;
+		}
+
+		int n = 2 * radius + 1;
+		uint32_t inv = 65536u / n, half = uint32_t(n / 2);
+		int x = 0;
+
+#ifdef UI_BLUR_SSE2
+		__m128i zero = _mm_setzero_si128(), vinv = _mm_set1_epi16(short(inv)), vhalf = _mm_set1_epi16(short(half));
+		for (; x + 16 <= w; x += 16) {
+			__m128i lo = zero, hi = zero;
+			for (int y = 0; y <= radius && y < h; y++) {
+				__m128i v = _mm_loadu_si128((__m128i const*)(src + size_t(y) * stride + x));
+				lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+				hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+			}
+			for (int y = 0; y < h; y++) {
+				__m128i a = _mm_mulhi_epu16(_mm_add_epi16(lo, vhalf), vinv);
+				__m128i b = _mm_mulhi_epu16(_mm_add_epi16(hi, vhalf), vinv);
+				_mm_storeu_si128((__m128i*)(dst + size_t(y) * stride + x), _mm_packus_epi16(a, b));
+
+				if (y + radius + 1 < h) {
+					__m128i v = _mm_loadu_si128((__m128i const*)(src + size_t(y + radius + 1) * stride + x));
+					lo = _mm_add_epi16(lo, _mm_unpacklo_epi8(v, zero));
+					hi = _mm_add_epi16(hi, _mm_unpackhi_epi8(v, zero));
+				}
+				if (y - radius >= 0) {
+					__m128i v = _mm_loadu_si128((__m128i const*)(src + size_t(y - radius) * stride + x));
+					lo = _mm_sub_epi16(lo, _mm_unpacklo_epi8(v, zero));
+					hi = _mm_sub_epi16(hi, _mm_unpackhi_epi8(v, zero));
+				}
+			}
+		}
+#endif
+		for (; x < w; x++) {
+			uint32_t sum = 0;
+			for (int y = 0; y <= radius && y < h; y++)
+				sum += src[size_t(y) * stride + x];
+			for (int y = 0; y < h; y++) {
+				dst[size_t(y) * stride + x] = box_divide_(sum, half, inv);
+				if (y + radius + 1 < h)
+					sum += src[size_t(y + radius + 1) * stride + x];
+				if (y - radius >= 0)
+					sum -= src[size_t(y - radius) * stride + x];
+			}
+		}
+	}
+
+	// dst is h x w, in 16 x 16 blocks to keep both sides in cache.
+	inline void transpose_8(uint8_t const* src, uint8_t* dst, int w, int h) {
+		for (int by = 0; by < h; by += 16) {
+			for (int bx = 0; bx < w; bx += 16) {
+				int ey = (std::min)(by + 16, h), ex = (std::min)(bx + 16, w);
+#ifdef UI_BLUR_SSE2
+				// interleaving rows i and i + 8 four times over transposes a full block
+				if (ey - by == 16 && ex - bx == 16) {
+					__m128i r[16], t[16];
+					for (int i = 0; i < 16; i++)
+						r[i] = _mm_loadu_si128((__m128i const*)(src + size_t(by + i) * w + bx));
+					for (int pass = 0; pass < 4; pass++) {
+						for (int i = 0; i < 8; i++) {
+							t[2 * i] = _mm_unpacklo_epi8(r[i], r[i + 8]);
+							t[2 * i + 1] = _mm_unpackhi_epi8(r[i], r[i + 8]);
+						}
+						std::memcpy(r, t, sizeof(r));
+					}
+					for (int i = 0; i < 16; i++)
+						_mm_storeu_si128((__m128i*)(dst + size_t(bx + i) * h + by), r[i]);
+					continue;
+				}
+#endif
+				for (int y = by; y < ey; y++)
+					for (int x = bx; x < ex; x++)
+						dst[size_t(x) * h + y] = src[size_t(y) * w + x];
+			}
+		}
+	}
+
+	// Box radius whose three passes have about the variance of a Gaussian of sigma.
+	inline int box_radius(float sigma) {
+		if (sigma <= 0.0f)
+			return 0;
+		return (std::max)(1, int(std::lround((std::sqrt(4.0f * sigma * sigma + 1.0f) - 1.0f) / 2.0f)));
+	}
+
+	// In place on a tightly packed w x h image. The blur reaches 3 * box_radius(sigma) pixels, images
+	// that should fade out completely need that much empty border.
+	inline void gaussian_blur(uint8_t* pixels, int w, int h, float sigma, std::vector<uint8_t>& scratch) {
+		int radius = box_radius(sigma);
+		if (radius == 0 || w <= 0 || h <= 0)
+			return;
+		scratch.resize(size_t(w) * h * 2);
+		uint8_t* a = scratch.data(), * b = scratch.data() + size_t(w) * h;
+
+		box_blur_v(pixels, a, w, h, w, radius);
+		box_blur_v(a, b, w, h, w, radius);
+		box_blur_v(b, a, w, h, w, radius);
+		transpose_8(a, b, w, h);
+		box_blur_v(b, a, h, w, h, radius);
+		box_blur_v(a, b, h, w, h, radius);
+		box_blur_v(b, a, h, w, h, radius);
+		transpose_8(a, pixels, h, w);
+	}
+}
+
+#endif // UI_BLUR
@@ -4,54 +4,290 @@
 #include "misc.hpp"
 #include "font.hpp"
 #include "image.hpp"
+#include "pyramid.hpp"
+#include "packed.hpp"
+#include "damage.hpp"
+#include "batch.hpp"
+#include "binning.hpp"
+#include "shadow.hpp"
+#include "path.hpp"
+
+#include <climits>
+#include <array>
+#include <utility>
 
 namespace ui {
-	struct RenderObject {
-		int x, y, w, h;
-		int type, brushIndex = -1, penIndex = -1, clipIndex = -1;
-		int maskIndex = -1, boundsIndex = -1, r1, r2;
+	// Paint records retained across frames. Identical records intern to one offset, so a list
+	// that paints every row white adds one record, not one per row. version() changes only
+	// when the table does, the renderer re-uploads on that. Lookup is an open addressed table
+	// kept at most half full, and the rebuild reuses its buffers, so once the table has reached
+	// its working size interning new records allocates nothing.
+	class PaintTable {
+		struct Entry {
+			int offset, size;
+			uint64_t lastFrame, hash;
+		};
+
+		std::vector<int> data_;
+		std::vector<int> owner_; // entry starting at each offset, -1 inside a record
+		std::vector<Entry> entries_;
+		std::vector<int> slots_; // entry + 1 per slot, 0 when free, linear probing
+		std::vector<int> rebuildData_; // swapped with data_ and entries_ by nextFrame()
+		std::vector<Entry> rebuildEntries_;
+		uint64_t frame_ = 0, version_ = 0, epoch_ = 0;
+
+		static uint64_t hash_(int const* v, size_t n) {
+			uint64_t h = 14695981039346656037ull ^ n;
+			for (size_t i = 0; i < n; i++)
+				h = (h ^ uint32_t(v[i])) * 1099511628211ull;
+			return h;
+		}
+
+		void link_(int entry) {
+			size_t mask = slots_.size() - 1;
+			for (size_t i = size_t(entries_[entry].hash) & mask;; i = (i + 1) & mask) {
+				if (!slots_[i]) {
+					slots_[i] = entry + 1;
+					return;
+				}
+			}
+		}
+
+		// Empties the slots, doubling them while the entries would fill more than half, and links
+		// every entry again.
+		void relink_(size_t entries) {
+			size_t size = (std::max)(slots_.size(), size_t(64));
+			while (entries * 2 > size)
+				size *= 2;
+			slots_.assign(size, 0);
+			for (int e = 0; e < int(entries_.size()); e++)
+				link_(e);
+		}
+
+	public:
+		int intern(std::initializer_list<int> record) {
+			uint64_t h = hash_(record.begin(), record.size());
+			if (!slots_.empty()) {
+				size_t mask = slots_.size() - 1;
+				for (size_t i = size_t(h) & mask; slots_[i]; i = (i + 1) & mask) {
+					auto& e = entries_[slots_[i] - 1];
+					if (e.hash == h && e.size == int(record.size()) && std::equal(record.begin(), record.end(), data_.begin() + e.offset)) {
+						e.lastFrame = frame_;
+						return e.offset;
+					}
+				}
+			}
+
+			int offset = int(data_.size());
+			data_.insert(data_.end(), record.begin(), record.end());
+			owner_.resize(data_.size(), -1);
+			owner_[offset] = int(entries_.size());
+			entries_.push_back({ offset, int(record.size()), frame_, h });
+			if (entries_.size() * 2 > slots_.size())
+				relink_(entries_.size());
+			else
+				link_(int(entries_.size()) - 1);
+			version_++;
+			return offset;
+		}
+
+		// Keeps a record alive this frame without re-interning it, used by display list replay.
+		void touch(int offset) {
+			if (offset >= 0 && offset < int(owner_.size()) && owner_[offset] >= 0)
+				entries_[owner_[offset]].lastFrame = frame_;
+		}
+
+		// Called between frames. Once most of the table went unused last frame (animated colours),
+		// it is rebuilt from the live records, which renumbers them, so nothing recorded earlier
+		// may be drawn against it afterwards.
+		void nextFrame(size_t minSize = 4096) {
+			size_t live = 0;
+			for (auto const& e : entries_)
+				live += e.lastFrame == frame_ ? e.size : 0;
+
+			if (data_.size() > minSize && live * 2 < data_.size()) {
+				auto& data = rebuildData_;
+				auto& entries = rebuildEntries_;
+				data.clear(), entries.clear();
+				owner_.clear();
+				for (auto const& e : entries_) {
+					if (e.lastFrame != frame_)
+						continue;
+					owner_.resize(data.size() + e.size, -1);
+					owner_[data.size()] = int(entries.size());
+					entries.push_back({ int(data.size()), e.size, e.lastFrame, e.hash });
+					data.insert(data.end(), data_.begin() + e.offset, data_.begin() + e.offset + e.size);
+				}
+				data_.swap(data);
+				entries_.swap(entries);
+				relink_(entries_.size());
+				version_++, epoch_++;
+			}
+			frame_++;
+		}
+
+		uint64_t version() const { return version_; }
+		uint64_t epoch() const { return epoch_; } // changes when offsets are renumbered
+		size_t records() const { return entries_.size(); }
+		Span<int const> span() const { return { data_.data(), data_.size() }; }
+	};
+
+	// Z-layers a canvas records into, a higher layer is drawn over everything in the lower ones.
+	constexpr int kLayers = 4;
+
+	// One recorded frame, each layer's objects newest first. Views stay valid until the second
+	// clear() after data() was called, except paints which are the canvas' retained table and
+	// only valid until the next paint is recorded.
+	struct FramePacket {
+		std::array<Span<RenderObject const>, kLayers> layers; // bottom layer first
+		Span<int const> data;
+		Span<int const> paints; // brushIndex and penIndex point here
+		uint64_t paintVersion = 0;
+		DamageRegion const* damage = nullptr; // changed since the previous packet, empty when nothing did
+		TileBins const* bins = nullptr; // objects per screen tile, indexed like ranges() concatenated, see Canvas::bins()
+
+		// Layers top first, so concatenated they run front to back.
+		std::array<std::pair<RenderObject const*, size_t>, kLayers> ranges() const {
+			std::array<std::pair<RenderObject const*, size_t>, kLayers> r;
+			for (int i = 0; i < kLayers; i++)
+				r[i] = { layers[kLayers - 1 - i].data(), layers[kLayers - 1 - i].size() };
+			return r;
+		}
+
+		size_t size() const {
+			size_t n = 0;
+			for (auto const& l : layers)
+				n += l.size();
+			return n;
+		}
+		bool empty() const { return size() == 0; }
+	};
+
+	// What a widget subtree recorded, objects newest first as in the frame buffers. Data indices are
+	// relative to the list's own data, kExternalClip marks the clip the subtree was recorded inside.
+	struct DisplayList {
+		static constexpr int kExternalClip = -2;
+
+		std::array<std::vector<RenderObject>, kLayers> layers;
+		std::vector<int> data;
+		std::vector<int> paints; // distinct paint offsets, touched on replay
+		std::vector<uint64_t> tiles; // tile page keys its tile paints sample, kept placed on replay
+		std::array<int, 4> visible{}; // visible area at record time
+		uint64_t paintEpoch = ~0ull;
+
+		void reset() { paintEpoch = ~0ull; }
+		bool empty() const {
+			for (auto const& l : layers)
+				if (!l.empty())
+					return false;
+			return true;
+		}
 	};
 
 	struct Canvas {
-		ImageAtlas maskAtlas, imageAtlas;
+		std::shared_ptr<ImageAtlas> maskAtlas, imageAtlas;
+		TilePage tilePage;
+		PaintTable paints;
+		ShadowCache shadows;
+		PathCache paths;
 		//uf::UFont font;
 
 		enum eType { 
-			eText, eRect, eRRect, eCircle, eEllipse, eLine
+			eText, eRect, eRRect, eCircle, eEllipse, eLine, eTextRun, eNinePatch
 		};
 
+		// Glyphs per eTextRun object, bounded by what the geometry shader may emit per point.
+		static constexpr int kRunGlyphs = 32;
+		static constexpr int kGlyphStride = 8;
+
+		// eNinePatch r1 record, see ninePatch().
+		static constexpr int kNinePatchRecord = 13;
+
 		enum eStroke {
-			eSolid, eLinear, eRadial, eConical, eImage, eRender 
+			eSolid, eLinear, eRadial, eConical, eImage, eRender, eTile
 		};
 
-		Canvas(std::string const& src, std::string const& font_name, int fSize) {
-			maskAtlas = ImageAtlas(src + "/icons", ImageAtlas::ALPHA);
-			imageAtlas = ImageAtlas(src + "/images", ImageAtlas::RGB);
-
-			static bool fontLoaded = false;
+		enum eLayer {
+			eContentLayer = 0, eOverlayLayer = kLayers - 1
+		};
 
-			if (!fontLoaded) {
+		static_assert(DamageTracker::kTextRun == eTextRun && DamageTracker::kRRect == eRRect && DamageTracker::kLine == eLine
+			&& DamageTracker::kNinePatch == eNinePatch && DamageTracker::kNinePatchRecord == kNinePatchRecord, "DamageTracker mirrors eType");
+		static_assert(DamageTracker::kPaintRender == eRender && DamageTracker::kPaintTile == eTile, "DamageTracker mirrors eStroke");
+		static_assert(DrawOrder::kRect == eRect && DrawOrder::kNinePatch == eNinePatch && DrawOrder::kPaintSolid == eSolid && DrawOrder::kPaintLinear == eLinear && DrawOrder::kPaintRadial == eRadial
+			&& DrawOrder::kPaintConical == eConical && DrawOrder::kPaintImage == eImage, "DrawOrder mirrors eType and eStroke");
+
+		// compression selects the image page encoding (fBC1 or fBC7), mask pages are then encoded as BC4
+		Canvas(std::string const& src, std::string const& font_name, int fSize, eCompression compression = fUncompressed) :
+			Canvas(ImageAtlas::shared(src + "/icons", ImageAtlas::ALPHA, compression == fUncompressed ? fUncompressed : fBC4),
+				ImageAtlas::shared(src + "/images", ImageAtlas::RGB, compression)) {
+			if (!uf::gLoaded)
 				uf::LoadGlobal(font_name, fSize);
-				fontLoaded = true;
-			}
 		}
 
-		void text(uf::TextModel tm, std::string const& s, int size, float x, float y, float w, float h) {
-			tm.cache(x, y, w, h, s, size);
-			bounds(x, y, w, h);
+		// Atlases already loaded by the startup graph, the global font must be loaded too.
+		Canvas(std::shared_ptr<ImageAtlas> masks, std::shared_ptr<ImageAtlas> images) : maskAtlas(masks), imageAtlas(images) {}
 
-			int j = 0;
-			for (auto& c : tm.characters()) {
-
-				int fIndex = mData.size();
-				auto& region = uf::gAtlas.position(s[j++]);
-				mData.insert(mData.end(), { region[0], region[1], region[2], region[3] });
-				auto back = createRO(c.x, c.y, c.w, c.h, eText, false);
-				if (back) back->r1 = fIndex;
+		// tm is laid out in place so its glyph quads keep their capacity between frames.
+		// Glyphs are packed into eTextRun objects whose rect is the extent of their glyphs. r1 points at
+		// { originX, originY, size, count } followed by count of (x offset << 8 | glyph id),
+		// glyph ids index glyphTable(). Blank glyphs and glyphs outside the visible area are not recorded.
+		void text(uf::TextModel& tm, std::string const& s, int size, float x, float y, float w, float h) {
+			tm.cache(x, y, w, h, s, size);
+			float scale = (float)size / (float)uf::gMetric.unitsPerEm;
+			ClipRect visible = visible_();
+
+			auto& quads = tm.characters();
+			int n = int(quads.size());
+			for (int j = 0; j < n;) {
+				int first = j, end = j, count = 0;
+				int x0 = INT_MAX, y0 = INT_MAX, x1 = INT_MIN, y1 = INT_MIN;
+				for (; end < n && count < kRunGlyphs; end++) {
+					auto const& q = quads[end];
+					if (!drawable_(q, visible))
+						continue;
+					x0 = (std::min)(x0, q.x), y0 = (std::min)(y0, q.y), x1 = (std::max)(x1, q.x + q.w), y1 = (std::max)(y1, q.y + q.h);
+					count++;
+				}
+				j = end;
+				if (count == 0)
+					continue;
+
+				auto obj = createRO(x0, y0, x1 - x0, y1 - y0, eTextRun, false);
+				if (!obj)
+					continue;
+
+				int header = -1;
+				for (int k = first; k < end; k++) {
+					auto const& q = quads[k];
+					if (!drawable_(q, visible))
+						continue;
+					if (header < 0) {
+						int originY = q.y + uf::gCharacters[s[k]].scale_metrics(scale).bearingV();
+						header = mData.write({ q.x, originY, size, 0 });
+						obj->r1 = header;
+					}
+					*mData.alloc(1) = (q.x - mData[header]) << 8 | (unsigned char)s[k];
+					mData[header + 3]++;
+				}
 			}
 			post();
 		}
 
+		// Per glyph id: atlas region then bearingV, width and height in font units.
+		// Built once after the font is loaded, eTextRun objects look regions up here instead of
+		// carrying them every frame.
+		static std::vector<int> glyphTable() {
+			std::vector<int> table(256 * kGlyphStride, 0);
+			for (auto const& [c, ch] : uf::gCharacters) {
+				auto const& region = uf::gAtlas.position(c);
+				int* g = table.data() + (unsigned char)c * kGlyphStride;
+				g[0] = region[0], g[1] = region[1], g[2] = region[2], g[3] = region[3];
+				g[4] = ch.bearingV(), g[5] = ch.width(), g[6] = ch.height();
+			}
+			return table;
+		}
+
 		void rect(float x, float y, float w, float h) {
 			createRO(x, y, w, h, eRect);
 		}
@@ -62,8 +298,7 @@ namespace ui {
 
 		void rrect(int x, int y, int w, int h, int tl, int tr, int br, int bl) {
 			auto obj = createRO(x, y, w, h, eRRect);
-			if (obj) obj->r1 = mData.size();
-			mData.insert(mData.end(), { tl, tr, br, bl });
+			if (obj) obj->r1 = mData.write({ tl, tr, br, bl });
 		}
 
 		void circle(int x, int y, int r) {
@@ -75,10 +310,29 @@ namespace ui {
 		}
 
 		void line(int x1, int y1, int x2, int y2, int thickness) {
-			auto obj = createRO(x1, y1, x2, y2, eLine);
+			auto obj = createRO(x1, y1, x2, y2, eLine, true, (thickness + 1) / 2);
 			if (obj) obj->r1 = thickness;
 		}
 
+		// An image stretched over the rect except for its insets (left, top, right, bottom, in
+		// texels), which keep their size, so one object draws a skinned panel or button at any size.
+		// The brush is the whole region, r1 points at the insets followed by the nine cell paints
+		// row by row (-1 for empty cells) that DrawOrder splits it into for the GPU. Borders and
+		// masks do not apply. A name missing from the atlas draws nothing.
+		void ninePatch(std::string const& s, int x, int y, int w, int h, std::array<int, 4> const& insets) {
+			auto img = imageAtlas->find(s);
+			if (!img) {
+				post();
+				return;
+			}
+			ninePatch_(eImage, img->region, x, y, w, h, insets);
+		}
+
+		// Same over a region placed in tilePage, see place().
+		void ninePatchTile(std::array<int, 4> const& region, int x, int y, int w, int h, std::array<int, 4> const& insets) {
+			ninePatch_(eTile, region, x, y, w, h, insets);
+		}
+
 		void solid(color const& c, int w = 0) {
 			stroke(w == 0 ? brushIndex : penIndex, { eSolid, w, c.pack() });
 		}
@@ -95,96 +349,455 @@ namespace ui {
 			stroke(w == 0 ? brushIndex : penIndex, { eConical, w, c1.pack(), c2.pack(), x, y, r });
 		}
 
+		// A name missing from the atlas drops the next object, see mask().
 		void image(std::string const& s, int w = 0) {
-			auto& region = imageAtlas[s].region;
+			auto img = imageAtlas->find(s);
+			if (!img) {
+				missing_ = true;
+				return;
+			}
+			auto& region = img->region;
 			stroke(w == 0 ? brushIndex : penIndex, { eImage, 0, region[0], region[1], region[2], region[3] });
 		}
 
+		// region of a tile placed in tilePage, see ImageView
+		void tile(std::array<int, 4> const& region, int w = 0) {
+			stroke(w == 0 ? brushIndex : penIndex, { eTile, 0, region[0], region[1], region[2], region[3] });
+		}
+
 		void render() {
 			stroke(brushIndex, { eRender, 0 });
 		}
 
+		// Places a tile in tilePage for tile(), display lists captured around it keep it placed when
+		// they are replayed.
+		std::optional<std::array<int, 4>> place(uint64_t key, Tile const& t) {
+			auto region = tilePage.place(key, t);
+			if (region)
+				placed_.push_back(key);
+			return region;
+		}
+
+		// Drop shadow of a rounded rect fading out over blur pixels past it, one nine-patch over a
+		// cached texture, see ShadowCache. Falls back to a translucent rrect when the tile page is full
+		// this frame.
+		void shadow(int x, int y, int w, int h, int radius, int blur, color const& c) {
+			if (w <= 0 || h <= 0 || c.a == 0)
+				return;
+			auto s = shadows.get(w, h, radius, blur, c, tilePage.tileSize());
+			auto region = place(s.key, *s.tile);
+			if (!region) {
+				solid(color(c.r, c.g, c.b, c.a / 2));
+				rrect(x, y, w, h, s.radius);
+				return;
+			}
+
+			// sliced axes stretch the middle texels, the others keep both outer halves and drop the middle
+			auto insets = [&](int length, int sizeClass) -> std::array<int, 2> {
+				if (!sizeClass)
+					return { s.corner(), s.corner() };
+				int lead = length / 2 + s.pad;
+				return { lead, length + s.pad - length / 2 };
+			};
+			auto ix = insets(w, s.classW), iy = insets(h, s.classH);
+			ninePatchTile(*region, x - s.pad, y - s.pad, w + 2 * s.pad, h + 2 * s.pad, { ix[0], iy[0], ix[1], iy[1] });
+		}
+
+		// Fills the path with the brush and strokes it with the pen, scaled by scale and moved to x, y
+		// rounded to whole pixels. Only solid paints apply, leave either out to skip that part. The
+		// rendering is cached per path version, scale, style and colours, see PathCache, and drawn as
+		// rects over regions of tilePage and solid rects where it is uniform. Parts that find the
+		// tile page full this frame are not drawn.
+		void path(Path const& p, float x, float y, float scale = 1.0f, PathStyle const& style = {}) {
+			auto pt = paints.span();
+			uint32_t fill = brushIndex >= 0 && pt[brushIndex] == eSolid ? uint32_t(pt[brushIndex + 2]) : 0;
+			uint32_t stroke = penIndex >= 0 && pt[penIndex] == eSolid ? uint32_t(pt[penIndex + 2]) : 0;
+			int width = stroke ? pt[penIndex + 1] : 0;
+			bool skip = p.empty() || missing_ || scale <= 0 || !((fill | stroke) & 0xFF);
+			post();
+			if (skip)
+				return;
+
+			auto shape = paths.get(p, scale, style, fill, stroke, float(width), tilePage);
+			if (!shape)
+				return;
+			int ox = int(std::lround(x)) + shape->x, oy = int(std::lround(y)) + shape->y;
+			ClipRect v = visible_();
+			int sheet = -1;
+			std::optional<std::array<int, 4>> region;
+			for (auto const& piece : shape->pieces) {
+				int px = ox + piece.dx, py = oy + piece.dy;
+				if (px >= v.x1 || py >= v.y1 || px + piece.w <= v.x0 || py + piece.h <= v.y0)
+					continue;
+				if (piece.sheet < 0) {
+					solid(color(piece.color));
+					rect(px, py, piece.w, piece.h);
+					continue;
+				}
+				if (piece.sheet != sheet)
+					sheet = piece.sheet, region = place(paths.sheetKey(sheet), paths.sheet(sheet));
+				if (!region)
+					continue;
+				tile({ (*region)[0] + piece.sx, (*region)[1] + piece.sy, piece.w, piece.h });
+				rect(px, py, piece.w, piece.h);
+			}
+		}
+
+		// Icons are optional, without the asset folder the next object is not recorded.
 		void mask(std::string const& s, int w = 0) {
-			maskIndex = mData.size();
-			auto& region = maskAtlas[s].region;
-			int index;
-			stroke(index, { region[0], region[1], region[2], region[3] });
+			auto img = maskAtlas->find(s);
+			if (!img) {
+				missing_ = true;
+				return;
+			}
+			auto& region = img->region;
+			maskIndex = mData.write({ region[0], region[1], region[2], region[3] });
 		}
 
+		// Pushes a clip intersected with the enclosing one, so nested clipsChildren widgets keep
+		// their parents' clip. Every clip() needs a matching unclip().
 		void clip(int x, int y, int w, int h) {
-			cX = x, cY = y, cW = w, cH = h;
-			clipIndex = mData.size();
-			mData.insert(mData.end(), { x, y, w, h });
+			ClipRect c{ x, y, x + w, y + h, -1 };
+			if (!clips_.empty()) {
+				auto const& outer = clips_.back();
+				c.x0 = (std::max)(c.x0, outer.x0), c.y0 = (std::max)(c.y0, outer.y0);
+				c.x1 = (std::min)(c.x1, outer.x1), c.y1 = (std::min)(c.y1, outer.y1);
+			}
+			c.x1 = (std::max)(c.x1, c.x0), c.y1 = (std::max)(c.y1, c.y0);
+			c.index = mData.write({ c.x0, c.y0, c.x1 - c.x0, c.y1 - c.y0 });
+			clips_.push_back(c);
+			clipIndex = c.index;
 		}
 
 		void unclip() {
-			clipIndex = -1;
+			if (!clips_.empty())
+				clips_.pop_back();
+			clipIndex = clips_.empty() ? -1 : clips_.back().index;
+		}
+
+		// Window area, anything entirely outside it is dropped while recording.
+		void setViewport(int x, int y, int w, int h) {
+			viewport_ = { x, y, x + w, y + h, -1 };
 		}
 
+		// Swaps to the other frame buffer so the previous packet survives while this one records.
 		void clear() {
-			mObjects.clear();
-			mOverlayObjects.clear();
-			mData.clear();
+			std::swap(mLayers, mBackLayers);
+			std::swap(mData, mBackData);
+			for (auto& l : mLayers)
+				l.clear();
+			mData.reset();
+			clips_.clear();
+			placed_.clear();
+			clipIndex = -1;
+			frame_++;
+			tilePage.nextFrame();
+			paints.nextFrame();
 			post();
 		}
 
 		void bounds(int x, int y, int w, int h) {
-			boundsIndex = mData.size();
-			mData.insert(mData.end(), { x, y, w, h });
+			boundsIndex = mData.write({ x, y, w, h });
+		}
+
+		// Edges, x1 and y1 exclusive. index is the clip record in mData.
+		struct ClipRect {
+			int x0, y0, x1, y1, index;
+		};
+
+		// Recording position, taken before a subtree paints so capture() can lift out what it recorded.
+		struct Mark {
+			std::array<size_t, kLayers> objects;
+			size_t data;
+			ClipRect visible;
+			int clipIndex;
+			size_t tiles;
+		};
+
+		Mark mark() const {
+			Mark m{ {}, mData.size(), visible_(), clipIndex, placed_.size() };
+			for (int i = 0; i < kLayers; i++)
+				m.objects[i] = mLayers[i].size();
+			return m;
+		}
+
+		void capture(Mark const& m, DisplayList& dl) {
+			int base = int(m.data);
+			auto rebase = [&](int& index) {
+				if (index >= base)
+					index -= base;
+				else if (index >= 0)
+					index = DisplayList::kExternalClip; // only the enclosing clip predates the mark
+			};
+			// distinct paints without sorting, a stamp per paint offset marks the ones already listed
+			dl.paints.clear();
+			paintStamps_.resize(paints.span().size(), 0);
+			uint32_t stamp = ++paintStamp_;
+			auto keepPaint = [&](int p) {
+				if (p >= 0 && p < int(paintStamps_.size()) && paintStamps_[p] != stamp)
+					paintStamps_[p] = stamp, dl.paints.push_back(p);
+			};
+
+			auto lift = [&](ReverseBuffer<RenderObject> const& from, size_t since, std::vector<RenderObject>& to) {
+				auto span = from.span();
+				to.assign(span.begin(), span.begin() + (span.size() - since));
+				for (auto& ro : to) {
+					rebase(ro.clipIndex), rebase(ro.maskIndex), rebase(ro.boundsIndex);
+					if (r1IsIndex_(ro.type))
+						ro.r1 -= base;
+					keepPaint(ro.brushIndex), keepPaint(ro.penIndex);
+					if (ro.type == eNinePatch)
+						for (int i = 4; i < kNinePatchRecord; i++)
+							keepPaint(mData[base + ro.r1 + i]);
+				}
+			};
+
+			for (int i = 0; i < kLayers; i++)
+				lift(mLayers[i], m.objects[i], dl.layers[i]);
+
+			auto data = mData.span();
+			dl.data.assign(data.begin() + base, data.end());
+			dl.visible = { m.visible.x0, m.visible.y0, m.visible.x1, m.visible.y1 };
+			dl.tiles.assign(placed_.begin() + m.tiles, placed_.end());
+			dl.paintEpoch = paints.epoch();
+		}
+
+		// False when the list was recorded against a different visible area or paint numbering.
+		bool replayable(DisplayList const& dl) const {
+			ClipRect v = visible_();
+			return dl.paintEpoch == paints.epoch() && dl.visible == std::array<int, 4>{ v.x0, v.y0, v.x1, v.y1 };
+		}
+
+		// Appends a captured list, returns false when it is not replayable() or one of its tiles has
+		// left the tile page, it then has to be recorded again.
+		bool replay(DisplayList const& dl) {
+			if (!replayable(dl))
+				return false;
+			for (uint64_t key : dl.tiles) {
+				if (!tilePage.touch(key))
+					return false;
+			}
+			placed_.insert(placed_.end(), dl.tiles.begin(), dl.tiles.end());
+
+			int base = int(mData.size());
+			if (!dl.data.empty())
+				std::copy(dl.data.begin(), dl.data.end(), mData.alloc(dl.data.size()));
+
+			auto rebase = [&](int& index) {
+				index = index == DisplayList::kExternalClip ? clipIndex : index >= 0 ? index + base : index;
+			};
+			auto place = [&](std::vector<RenderObject> const& from, ReverseBuffer<RenderObject>& to) {
+				RenderObject* ro = to.prepend(from.data(), from.size());
+				for (size_t i = 0; i < from.size(); i++) {
+					rebase(ro[i].clipIndex), rebase(ro[i].maskIndex), rebase(ro[i].boundsIndex);
+					if (r1IsIndex_(ro[i].type))
+						ro[i].r1 += base;
+				}
+			};
+			for (int i = 0; i < kLayers; i++)
+				place(dl.layers[i], mLayers[i]);
+
+			for (int p : dl.paints)
+				paints.touch(p);
+			replays_++;
+			return true;
+		}
+
+		size_t replays() const { return replays_; }
+
+		// Damage is worked out on the first call per frame, later calls return the same packet. The
+		// packet carries no bins, a consumer that wants them sets them from bins().
+		FramePacket data() const {
+			FramePacket packet{ {}, mData.span(), paints.span(), paints.version() };
+			for (int i = 0; i < kLayers; i++)
+				packet.layers[i] = mLayers[i].span();
+			if (damageFrame_ != frame_) {
+				auto ranges = packet.ranges();
+				damage_.compute(ranges.data(), ranges.size(), packet.data.data(), packet.paints.data(), viewportW_(), viewportH_());
+				damageFrame_ = frame_;
+			}
+			packet.damage = &damage_.damage();
+			return packet;
 		}
 
-		auto data() {
-			if (!mOverlayObjects.empty())
-				mObjects.insert(mObjects.end(), mOverlayObjects.begin(), mOverlayObjects.end());
-			return std::make_tuple(mObjects, mData);
+		// The frame's objects per screen tile, built on the first call per frame. Only the CPU
+		// renderer splits the screen, so the GL path never pays for them. Empty until a viewport is set.
+		TileBins const& bins() const {
+			if (binsFrame_ != frame_) {
+				FramePacket packet = data();
+				auto ranges = packet.ranges();
+				bins_.build(ranges.data(), ranges.size(), packet.data.data(), packet.paints.data(), viewportW_(), viewportH_());
+				binsFrame_ = frame_;
+			}
+			return bins_;
+		}
+
+		// Next data() reports the whole viewport as damaged.
+		void invalidateDamage() {
+			damage_.reset();
 		}
 
 
+		// Heap growths of the recording buffers since construction, constant once frames reach a steady size.
+		size_t growths() const {
+			size_t n = mData.growths() + mBackData.growths();
+			for (int i = 0; i < kLayers; i++)
+				n += mLayers[i].growths() + mBackLayers[i].growths();
+			return n;
+		}
+
+		// Sizes the content layer, the others are small and grow on their own.
+		void reserve(size_t objects, size_t data) {
+			mLayers[eContentLayer].reserve(objects), mBackLayers[eContentLayer].reserve(objects);
+			mData.reserve(data), mBackData.reserve(data);
+		}
+
+		// Objects recorded after this go to the given layer until it is changed again.
+		void setLayer(int layer) {
+			layer_ = std::clamp(layer, 0, kLayers - 1);
+		}
+
+		int layer() const { return layer_; }
+
 		void setOverlay(bool b) {
-			overlay = b;
+			setLayer(b ? eOverlayLayer : eContentLayer);
 		}
 	private:
-		void stroke(int& index, std::vector<int> const& data) {
-			index = mData.size();
-			mData.insert(mData.end(), data.begin(), data.end());
+		static bool r1IsIndex_(int type) {
+			return type == eRRect || type == eTextRun || type == eNinePatch;
+		}
+
+		void ninePatch_(int kind, std::array<int, 4> const& region, int x, int y, int w, int h, std::array<int, 4> const& insets) {
+			auto [rx, ry, rw, rh] = region;
+			penIndex = -1, maskIndex = -1;
+			stroke(brushIndex, { kind, 0, rx, ry, rw, rh });
+			auto obj = createRO(x, y, w, h, eNinePatch, false);
+			if (!obj) {
+				post();
+				return;
+			}
+
+			int l = std::clamp(insets[0], 0, rw), r = std::clamp(insets[2], 0, rw - l);
+			int t = std::clamp(insets[1], 0, rh), b = std::clamp(insets[3], 0, rh - t);
+			int cols[4] = { rx, rx + l, rx + rw - r, rx + rw }, rows[4] = { ry, ry + t, ry + rh - b, ry + rh };
+			int cells[9];
+			for (int j = 0; j < 3; j++) {
+				for (int i = 0; i < 3; i++) {
+					int cw = cols[i + 1] - cols[i], ch = rows[j + 1] - rows[j];
+					cells[j * 3 + i] = cw > 0 && ch > 0 ? paints.intern({ kind, 0, cols[i], rows[j], cw, ch }) : -1;
+				}
+			}
+			obj->r1 = mData.write({ l, t, r, b, cells[0], cells[1], cells[2], cells[3], cells[4], cells[5], cells[6], cells[7], cells[8] });
+			post();
 		}
 
-		bool intersects(int x, int y, int w, int h) {
-			return x < cX + cW && x + w > cX && y < cY + cH && y + h > cY;
+		void stroke(int& index, std::initializer_list<int> data) {
+			index = paints.intern(data);
 		}
 
-		RenderObject* createRO(float x, float y, float w, float h, int type, bool post = true) {
-			if (clipIndex != -1 && !intersects(x, y, w, h))
-				return nullptr;
+		int viewportW_() const { return viewport_.x1 == INT_MAX ? 0 : viewport_.x1 - viewport_.x0; }
+		int viewportH_() const { return viewport_.y1 == INT_MAX ? 0 : viewport_.y1 - viewport_.y0; }
 
-			if (overlay) {
-				auto& ro = mOverlayObjects.emplace_back();
-				ro.x = x, ro.y = y, ro.w = w, ro.h = h, ro.type = type;
-				ro.brushIndex = brushIndex, ro.penIndex = penIndex, ro.clipIndex = clipIndex, ro.maskIndex = maskIndex, ro.boundsIndex = boundsIndex;
-				if (post)
-					this->post();
-				return &mOverlayObjects.back();
+		// innermost clip intersected with the viewport
+		ClipRect visible_() const {
+			ClipRect v = viewport_;
+			if (!clips_.empty()) {
+				auto const& c = clips_.back();
+				v.x0 = (std::max)(v.x0, c.x0), v.y0 = (std::max)(v.y0, c.y0);
+				v.x1 = (std::min)(v.x1, c.x1), v.y1 = (std::min)(v.y1, c.y1);
 			}
-			else {
-				auto& ro = mObjects.emplace_back();
-				ro.x = x, ro.y = y, ro.w = w, ro.h = h, ro.type = type;
-				ro.brushIndex = brushIndex, ro.penIndex = penIndex, ro.clipIndex = clipIndex, ro.maskIndex = maskIndex, ro.boundsIndex = boundsIndex;
+			return v;
+		}
+
+		template<typename Quad>
+		static bool drawable_(Quad const& q, ClipRect const& v) {
+			return q.w > 0 && q.h > 0 && q.x < v.x1 && q.x + q.w > v.x0 && q.y < v.y1 && q.y + q.h > v.y0;
+		}
+
+		// Cuts a plain filled rect down to the clip so it needs no clip test on the GPU. Image and tile
+		// regions are cut by the same fraction to keep the texel mapping. Borders and masks would
+		// move with the rect, those keep the clip instead.
+		// Glyphs are not trimmed: a run stores only an x offset and a glyph id per glyph, the quad and
+		// its atlas region come from glyphTable() when it is drawn, so there is nothing to cut here.
+		// text() drops glyphs outside the clip instead, and a run with a glyph across the edge keeps
+		// the clip for the fragments of that glyph.
+		bool trim_(int& x, int& y, int& w, int& h, int& brush, ClipRect const& c) {
+			if (penIndex != -1 || maskIndex != -1 || brush < 0 || w <= 0 || h <= 0)
+				return false;
+
+			int x0 = (std::max)(x, c.x0), y0 = (std::max)(y, c.y0);
+			int x1 = (std::min)(x + w, c.x1), y1 = (std::min)(y + h, c.y1);
+
+			auto p = paints.span();
+			int kind = p[brush];
+			if (kind == eImage || kind == eTile) {
+				int rx = p[brush + 2], ry = p[brush + 3], rw = p[brush + 4], rh = p[brush + 5];
+				int sx0 = rx + int(std::lround(double(x0 - x) * rw / w)), sx1 = rx + int(std::lround(double(x1 - x) * rw / w));
+				int sy0 = ry + int(std::lround(double(y0 - y) * rh / h)), sy1 = ry + int(std::lround(double(y1 - y) * rh / h));
+				brush = paints.intern({ kind, 0, sx0, sy0, sx1 - sx0, sy1 - sy0 });
+			}
+			else if (kind != eSolid && kind != eLinear && kind != eRadial && kind != eConical) {
+				return false;
+			}
+
+			x = x0, y = y0, w = x1 - x0, h = y1 - y0;
+			return true;
+		}
+
+		// Drops objects outside the visible area, and removes the clip from objects that are entirely
+		// inside it or could be trimmed to it. pad widens the bounds of lines by half their thickness.
+		RenderObject* createRO(float fx, float fy, float fw, float fh, int type, bool post = true, int pad = 0) {
+			int x = int(fx), y = int(fy), w = int(fw), h = int(fh);
+
+			// lines store their end point in w, h
+			int bx0 = x, by0 = y, bx1 = x + w, by1 = y + h;
+			if (type == eLine)
+				bx0 = (std::min)(x, w) - pad, by0 = (std::min)(y, h) - pad, bx1 = (std::max)(x, w) + pad, by1 = (std::max)(y, h) + pad;
+
+			ClipRect v = visible_();
+			if (missing_ || bx1 <= v.x0 || bx0 >= v.x1 || by1 <= v.y0 || by0 >= v.y1) {
 				if (post)
 					this->post();
-				return &mObjects.back();
+				return nullptr;
 			}
+
+			int clip = clipIndex, brush = brushIndex;
+			if (!clips_.empty()) {
+				auto const& c = clips_.back();
+				if (bx0 >= c.x0 && by0 >= c.y0 && bx1 <= c.x1 && by1 <= c.y1)
+					clip = -1;
+				else if (type == eRect && trim_(x, y, w, h, brush, c))
+					clip = -1;
+			}
+
+			auto& ro = mLayers[layer_].push();
+			ro.x = x, ro.y = y, ro.w = w, ro.h = h, ro.type = type;
+			ro.brushIndex = brush, ro.penIndex = penIndex, ro.clipIndex = clip, ro.maskIndex = maskIndex, ro.boundsIndex = boundsIndex;
+			if (post)
+				this->post();
+			return &ro;
 		}
 
 		void post() {
 			brushIndex = -1, penIndex = -1, boundsIndex = -1, maskIndex = -1;
+			missing_ = false;
 		}
 
 		int brushIndex = -1, penIndex = -1, clipIndex = -1, maskIndex = -1, boundsIndex = -1;
-		int cX, cY, cW, cH;
-		bool overlay = false;
-		std::vector<RenderObject> mObjects;
-		std::vector<RenderObject> mOverlayObjects;
-		std::vector<int> mData;
+		bool missing_ = false;
+		std::vector<ClipRect> clips_;
+		std::vector<uint64_t> placed_; // tile page keys placed this frame, in order
+		ClipRect viewport_{ INT_MIN, INT_MIN, INT_MAX, INT_MAX, -1 };
+		size_t replays_ = 0;
+		uint64_t frame_ = 0;
+		mutable uint64_t damageFrame_ = ~0ull, binsFrame_ = ~0ull;
+		mutable DamageTracker damage_;
+		mutable TileBins bins_;
+		std::vector<uint32_t> paintStamps_;
+		uint32_t paintStamp_ = 0;
+		int layer_ = eContentLayer;
+		std::array<ReverseBuffer<RenderObject>, kLayers> mLayers, mBackLayers;
+		FrameArena mData, mBackData;
 	};
 }
 
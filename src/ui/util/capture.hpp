@@ -0,0 +1,335 @@
+#ifndef UI_CAPTURE
+#define UI_CAPTURE
+
+#include "packed.hpp"
+#include "canvas.hpp"
+#include "image.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <array>
+#include <fstream>
+#include <unordered_map>
+
+namespace ui {
+	// One recorded frame as read back, source tells apart the canvases of several windows.
+	struct CaptureFrame {
+		int source = 0, width = 0, height = 0;
+		uint64_t paintVersion = 0;
+		std::array<std::vector<RenderObject>, kLayers> layers;
+		std::vector<int> data, paints;
+
+		// damage and bins are left for the caller to compute
+		FramePacket packet() const {
+			FramePacket p{ {}, { data.data(), data.size() }, { paints.data(), paints.size() }, paintVersion };
+			for (int i = 0; i < kLayers; i++)
+				p.layers[i] = { layers[i].data(), layers[i].size() };
+			return p;
+		}
+
+		size_t objects() const {
+			size_t n = 0;
+			for (auto const& l : layers)
+				n += l.size();
+			return n;
+		}
+	};
+
+	/*
+		File layout, little endian like the atlas bundles:
+			header   magic, version, kLayers, unitsPerEm, glyph table, mask and image region tables
+			frames   flags, source, byte count, then the frame's words as zero runs and zigzag varints
+
+		A frame's words are its header, every layer's objects field by field, data and paints. Delta
+		frames store them xor the previous frame of the same source, so whatever did not change
+		between frames is a zero run. Every keyInterval frames of a source is stored whole so a
+		damaged or truncated file still reads up to the last good key frame.
+	*/
+	namespace capture {
+		inline constexpr uint32_t kMagic = 0x50435848; // "HXCP"
+		inline constexpr uint32_t kVersion = 1;
+		inline constexpr int kObjectWords = 12;
+
+		enum eFlags : uint8_t { fKey = 0, fDelta = 1 };
+
+		inline void putVarint(std::vector<uint8_t>& out, uint32_t v) {
+			while (v >= 0x80) {
+				out.push_back(uint8_t(v | 0x80));
+				v >>= 7;
+			}
+			out.push_back(uint8_t(v));
+		}
+
+		inline bool getVarint(uint8_t const*& p, uint8_t const* end, uint32_t& v) {
+			v = 0;
+			for (int shift = 0; shift < 35 && p < end; shift += 7) {
+				uint8_t b = *p++;
+				v |= uint32_t(b & 0x7F) << shift;
+				if (!(b & 0x80))
+					return true;
+			}
+			return false;
+		}
+
+		inline uint32_t zigzag(int32_t v) { return (uint32_t(v) << 1) ^ uint32_t(v >> 31); }
+		inline int32_t unzigzag(uint32_t v) { return int32_t(v >> 1) ^ -int32_t(v & 1); }
+
+		// Alternating zero run and literal run lengths, literals as zigzag varints.
+		inline void encodeWords(std::vector<int32_t> const& words, std::vector<uint8_t>& out) {
+			size_t i = 0, n = words.size();
+			while (i < n) {
+				size_t zeros = i;
+				while (zeros < n && words[zeros] == 0)
+					zeros++;
+				size_t literals = zeros;
+				while (literals < n && words[literals] != 0)
+					literals++;
+				putVarint(out, uint32_t(zeros - i));
+				putVarint(out, uint32_t(literals - zeros));
+				for (size_t k = zeros; k < literals; k++)
+					putVarint(out, zigzag(words[k]));
+				i = literals;
+			}
+		}
+
+		inline bool decodeWords(uint8_t const* p, uint8_t const* end, std::vector<int32_t>& words) {
+			words.clear();
+			while (p < end) {
+				uint32_t zeros = 0, literals = 0, v = 0;
+				if (!getVarint(p, end, zeros) || !getVarint(p, end, literals))
+					return false;
+				words.insert(words.end(), zeros, 0);
+				for (uint32_t k = 0; k < literals; k++) {
+					if (!getVarint(p, end, v))
+						return false;
+					words.push_back(unzigzag(v));
+				}
+			}
+			return true;
+		}
+
+		// frame header words: source, width, height, paint version low and high, then the sizes
+		inline constexpr int kHeaderWords = 5 + kLayers + 2;
+
+		inline void flatten(FramePacket const& frame, int source, int w, int h, std::vector<int32_t>& words) {
+			words.clear();
+			words.push_back(source), words.push_back(w), words.push_back(h);
+			words.push_back(int32_t(uint32_t(frame.paintVersion))), words.push_back(int32_t(uint32_t(frame.paintVersion >> 32)));
+			for (auto const& l : frame.layers)
+				words.push_back(int32_t(l.size()));
+			words.push_back(int32_t(frame.data.size())), words.push_back(int32_t(frame.paints.size()));
+
+			for (auto const& l : frame.layers) {
+				for (auto const& o : l) {
+					int32_t fields[kObjectWords] = { o.x, o.y, o.w, o.h, o.type, o.brushIndex, o.penIndex, o.clipIndex, o.maskIndex, o.boundsIndex, o.r1, o.r2 };
+					words.insert(words.end(), fields, fields + kObjectWords);
+				}
+			}
+			words.insert(words.end(), frame.data.begin(), frame.data.end());
+			words.insert(words.end(), frame.paints.begin(), frame.paints.end());
+		}
+
+		inline bool unflatten(std::vector<int32_t> const& words, CaptureFrame& f) {
+			if (words.size() < size_t(kHeaderWords))
+				return false;
+			int32_t const* w = words.data();
+			f.source = w[0], f.width = w[1], f.height = w[2];
+			f.paintVersion = uint64_t(uint32_t(w[3])) | uint64_t(uint32_t(w[4])) << 32;
+
+			size_t need = kHeaderWords;
+			for (int i = 0; i < kLayers; i++)
+				need += size_t(uint32_t(w[5 + i])) * kObjectWords;
+			need += size_t(uint32_t(w[5 + kLayers])) + size_t(uint32_t(w[6 + kLayers]));
+			if (words.size() != need)
+				return false;
+
+			size_t at = kHeaderWords;
+			for (int i = 0; i < kLayers; i++) {
+				f.layers[i].resize(size_t(uint32_t(w[5 + i])));
+				for (auto& o : f.layers[i]) {
+					int32_t const* s = w + at;
+					o.x = s[0], o.y = s[1], o.w = s[2], o.h = s[3], o.type = s[4], o.brushIndex = s[5];
+					o.penIndex = s[6], o.clipIndex = s[7], o.maskIndex = s[8], o.boundsIndex = s[9], o.r1 = s[10], o.r2 = s[11];
+					at += kObjectWords;
+				}
+			}
+			f.data.assign(w + at, w + at + uint32_t(w[5 + kLayers]));
+			at += uint32_t(w[5 + kLayers]);
+			f.paints.assign(w + at, w + at + uint32_t(w[6 + kLayers]));
+			return true;
+		}
+
+		// words xor the previous frame, positions past its end are kept as they are
+		inline void xorWith(std::vector<int32_t>& words, std::vector<int32_t> const& previous) {
+			size_t n = (std::min)(words.size(), previous.size());
+			for (size_t i = 0; i < n; i++)
+				words[i] ^= previous[i];
+		}
+	}
+
+	// Appends the frames a Canvas hands to its renderer to a capture file.
+	class CaptureWriter {
+		std::ofstream file_;
+		bool delta_;
+		int keyInterval_;
+		size_t frames_ = 0, bytes_ = 0;
+		std::vector<int32_t> words_;
+		std::vector<uint8_t> encoded_;
+
+		struct Source {
+			std::vector<int32_t> previous;
+			int sinceKey = 0;
+		};
+		std::unordered_map<int, Source> sources_;
+
+		template<typename T> void put_(T v) {
+			file_.write(reinterpret_cast<char const*>(&v), sizeof(v));
+			bytes_ += sizeof(v);
+		}
+
+		void putTable_(ImageAtlas const* atlas) {
+			put_(int32_t(atlas ? atlas->w_ : 0)), put_(int32_t(atlas ? atlas->h_ : 0));
+			put_(uint32_t(atlas ? atlas->images_.size() : 0));
+			if (!atlas)
+				return;
+			for (auto const& [hash, p] : atlas->images_) {
+				put_(uint64_t(hash));
+				for (int r : p.region) put_(int32_t(r));
+			}
+		}
+	public:
+		// Glyph regions come from Canvas::glyphTable, so the font must be loaded first.
+		CaptureWriter(std::string const& path, ImageAtlas const* masks, ImageAtlas const* images, bool delta = true, int keyInterval = 60) :
+			file_(path, std::ios::binary), delta_(delta), keyInterval_((std::max)(keyInterval, 1)) {
+			if (!file_.is_open())
+				return;
+			put_(capture::kMagic), put_(capture::kVersion), put_(int32_t(kLayers));
+			put_(int32_t(uf::gLoaded ? uf::gMetric.unitsPerEm : 0));
+			auto glyphs = Canvas::glyphTable();
+			put_(uint32_t(glyphs.size()));
+			for (int g : glyphs) put_(int32_t(g));
+			putTable_(masks);
+			putTable_(images);
+		}
+
+		bool good() const { return file_.is_open() && bool(file_); }
+		size_t frames() const { return frames_; }
+		size_t bytes() const { return bytes_; }
+
+		// w and h are the viewport the frame is drawn at.
+		void write(FramePacket const& frame, int w, int h, int source = 0) {
+			if (!good())
+				return;
+			capture::flatten(frame, source, w, h, words_);
+
+			auto& s = sources_[source];
+			bool key = !delta_ || s.previous.empty() || s.sinceKey >= keyInterval_;
+			s.sinceKey = key ? 1 : s.sinceKey + 1;
+
+			std::vector<int32_t> current = words_;
+			if (!key)
+				capture::xorWith(words_, s.previous);
+			s.previous.swap(current);
+
+			encoded_.clear();
+			capture::encodeWords(words_, encoded_);
+			put_(uint8_t(key ? capture::fKey : capture::fDelta)), put_(int32_t(source)), put_(uint32_t(encoded_.size()));
+			file_.write(reinterpret_cast<char const*>(encoded_.data()), encoded_.size());
+			bytes_ += encoded_.size();
+			frames_++;
+		}
+
+		void flush() { file_.flush(); }
+	};
+
+	// Reads a whole capture into memory, stopping at the first frame that does not decode.
+	class CaptureReader {
+	public:
+		struct Region {
+			uint64_t key;
+			std::array<int, 4> region;
+		};
+
+		struct Table {
+			int w = 0, h = 0;
+			std::vector<Region> regions;
+		};
+
+		bool load(std::string const& path) {
+			frames_.clear();
+			std::ifstream file(path, std::ios::binary);
+			if (!file.is_open())
+				return false;
+
+			auto get = [&](auto& v) { file.read(reinterpret_cast<char*>(&v), sizeof(v)); return bool(file); };
+			uint32_t magic = 0, version = 0, glyphCount = 0;
+			int32_t layers = 0;
+			if (!get(magic) || !get(version) || magic != capture::kMagic || version != capture::kVersion)
+				return false;
+			if (!get(layers) || layers != kLayers || !get(unitsPerEm_) || !get(glyphCount))
+				return false;
+			glyphs_.resize(glyphCount);
+			for (auto& g : glyphs_)
+				if (!get(g))
+					return false;
+
+			for (Table* t : { &masks_, &images_ }) {
+				uint32_t count = 0;
+				if (!get(t->w) || !get(t->h) || !get(count))
+					return false;
+				t->regions.resize(count);
+				for (auto& r : t->regions)
+					if (!get(r.key) || !get(r.region))
+						return false;
+			}
+
+			std::unordered_map<int, std::vector<int32_t>> previous;
+			std::vector<uint8_t> bytes;
+			std::vector<int32_t> words;
+			while (true) {
+				uint8_t flags = 0;
+				int32_t source = 0;
+				uint32_t size = 0;
+				if (!get(flags) || !get(source) || !get(size))
+					break;
+				bytes.resize(size);
+				if (!file.read(reinterpret_cast<char*>(bytes.data()), size))
+					break;
+				if (!capture::decodeWords(bytes.data(), bytes.data() + size, words) || words.empty())
+					break;
+
+				if (flags == capture::fDelta) {
+					auto it = previous.find(source);
+					if (it == previous.end())
+						break;
+					capture::xorWith(words, it->second);
+				}
+
+				CaptureFrame f;
+				if (!capture::unflatten(words, f) || f.source != source)
+					break;
+				previous[source] = words;
+				frames_.push_back(std::move(f));
+			}
+			return true;
+		}
+
+		size_t size() const { return frames_.size(); }
+		CaptureFrame const& operator[](size_t i) const { return frames_[i]; }
+		std::vector<CaptureFrame> const& frames() const { return frames_; }
+
+		int unitsPerEm() const { return unitsPerEm_; }
+		std::vector<int> const& glyphs() const { return glyphs_; }
+		Table const& masks() const { return masks_; }
+		Table const& images() const { return images_; }
+
+	private:
+		std::vector<CaptureFrame> frames_;
+		int32_t unitsPerEm_ = 0;
+		std::vector<int> glyphs_;
+		Table masks_, images_;
+	};
+}
+
+#endif // UI_CAPTURE
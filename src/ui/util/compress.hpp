@@ -0,0 +1,468 @@
+#ifndef UI_COMPRESS
+#define UI_COMPRESS
+
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <array>
+#include <algorithm>
+
+namespace ui {
+	/*
+		CPU block compression for atlas pages.
+
+		BC1 - RGB, 8 bytes per 4x4 block (fast mode for image pages)
+		BC4 - single channel, 8 bytes per 4x4 block (mask pages)
+		BC7 - RGBA, 16 bytes per 4x4 block (image pages), mode 6 only
+	*/
+	enum eCompression {
+		fUncompressed,
+		fBC1,
+		fBC4,
+		fBC7
+	};
+
+	struct CompressedImage {
+		int w = 0, h = 0;
+		eCompression format = fUncompressed;
+		std::vector<uint8_t> blocks;
+
+		int blocksX() const { return (w + 3) / 4; }
+		int blocksY() const { return (h + 3) / 4; }
+		int paddedW() const { return blocksX() * 4; }
+		int paddedH() const { return blocksY() * 4; }
+		bool empty() const { return blocks.empty(); }
+	};
+
+	inline int block_bytes(eCompression format) {
+		return format == fBC7 ? 16 : format == fUncompressed ? 0 : 8;
+	}
+
+	namespace detail {
+		typedef std::array<std::array<uint8_t, 4>, 16> Block;
+
+		// Gathers a 4x4 RGBA block, replicating edge pixels for partial blocks.
+		inline void fetch_block(uint8_t const* src, int w, int h, int c, int bx, int by, Block& out) {
+			for (int j = 0; j < 4; j++) {
+				int y = (std::min)(by * 4 + j, h - 1);
+				for (int i = 0; i < 4; i++) {
+					int x = (std::min)(bx * 4 + i, w - 1);
+					uint8_t const* p = src + (size_t(y) * w + x) * c;
+					auto& o = out[j * 4 + i];
+					o[0] = p[0];
+					o[1] = c > 1 ? p[1] : p[0];
+					o[2] = c > 2 ? p[2] : p[0];
+					o[3] = c > 3 ? p[3] : 255;
+				}
+			}
+		}
+
+		inline void store_block(uint8_t* dst, int w, int h, int c, int bx, int by, Block const& in) {
+			for (int j = 0; j < 4; j++) {
+				int y = by * 4 + j;
+				if (y >= h) break;
+				for (int i = 0; i < 4; i++) {
+					int x = bx * 4 + i;
+					if (x >= w) break;
+					uint8_t* p = dst + (size_t(y) * w + x) * c;
+					for (int k = 0; k < c; k++)
+						p[k] = in[j * 4 + i][k];
+				}
+			}
+		}
+
+		inline int sq(int v) { return v * v; }
+
+		inline int rgb_distance(std::array<uint8_t, 4> const& a, std::array<int, 3> const& b) {
+			return sq(a[0] - b[0]) + sq(a[1] - b[1]) + sq(a[2] - b[2]);
+		}
+
+		// ---- BC1 ----
+
+		inline uint16_t pack565(int r, int g, int b) {
+			return uint16_t(((r * 31 + 127) / 255) << 11 | ((g * 63 + 127) / 255) << 5 | ((b * 31 + 127) / 255));
+		}
+
+		inline std::array<int, 3> unpack565(uint16_t c) {
+			int r = (c >> 11) & 31, g = (c >> 5) & 63, b = c & 31;
+			return { (r << 3) | (r >> 2), (g << 2) | (g >> 4), (b << 3) | (b >> 2) };
+		}
+
+		inline void bc1_palette(uint16_t c0, uint16_t c1, std::array<std::array<int, 3>, 4>& pal) {
+			pal[0] = unpack565(c0), pal[1] = unpack565(c1);
+			for (int k = 0; k < 3; k++) {
+				if (c0 > c1) {
+					pal[2][k] = (2 * pal[0][k] + pal[1][k]) / 3;
+					pal[3][k] = (pal[0][k] + 2 * pal[1][k]) / 3;
+				}
+				else {
+					pal[2][k] = (pal[0][k] + pal[1][k]) / 2;
+					pal[3][k] = 0;
+				}
+			}
+		}
+
+		inline void encode_bc1_block(Block const& px, uint8_t* out) {
+			int mn[3] = { 255, 255, 255 }, mx[3] = { 0, 0, 0 };
+			for (auto& p : px) {
+				for (int k = 0; k < 3; k++)
+					mn[k] = (std::min)(mn[k], int(p[k])), mx[k] = (std::max)(mx[k], int(p[k]));
+			}
+
+			// pick the bounding box diagonal that follows the colour covariance
+			int mean[3] = { (mn[0] + mx[0]) / 2, (mn[1] + mx[1]) / 2, (mn[2] + mx[2]) / 2 };
+			int covG = 0, covB = 0;
+			for (auto& p : px) {
+				covG += (p[0] - mean[0]) * (p[1] - mean[1]);
+				covB += (p[0] - mean[0]) * (p[2] - mean[2]);
+			}
+			if (covG < 0) std::swap(mn[1], mx[1]);
+			if (covB < 0) std::swap(mn[2], mx[2]);
+
+			// inset by 1/16th of the range to reduce the error of the extremes
+			for (int k = 0; k < 3; k++) {
+				int inset = (mx[k] - mn[k]) / 16;
+				mn[k] = std::clamp(mn[k] + inset, 0, 255);
+				mx[k] = std::clamp(mx[k] - inset, 0, 255);
+			}
+
+			uint16_t c0 = pack565(mx[0], mx[1], mx[2]);
+			uint16_t c1 = pack565(mn[0], mn[1], mn[2]);
+			if (c0 < c1) std::swap(c0, c1);
+
+			uint32_t indices = 0;
+			if (c0 != c1) {
+				std::array<std::array<int, 3>, 4> pal;
+				bc1_palette(c0, c1, pal);
+				for (int i = 0; i < 16; i++) {
+					int best = 0, bestErr = rgb_distance(px[i], pal[0]);
+					for (int p = 1; p < 4; p++) {
+						int err = rgb_distance(px[i], pal[p]);
+						if (err < bestErr) best = p, bestErr = err;
+					}
+					indices |= uint32_t(best) << (i * 2);
+				}
+			}
+
+			out[0] = uint8_t(c0), out[1] = uint8_t(c0 >> 8);
+			out[2] = uint8_t(c1), out[3] = uint8_t(c1 >> 8);
+			std::memcpy(out + 4, &indices, 4);
+		}
+
+		inline void decode_bc1_block(uint8_t const* in, Block& px) {
+			uint16_t c0 = uint16_t(in[0] | in[1] << 8), c1 = uint16_t(in[2] | in[3] << 8);
+			uint32_t indices;
+			std::memcpy(&indices, in + 4, 4);
+
+			std::array<std::array<int, 3>, 4> pal;
+			bc1_palette(c0, c1, pal);
+			for (int i = 0; i < 16; i++) {
+				auto& c = pal[(indices >> (i * 2)) & 3];
+				px[i] = { uint8_t(c[0]), uint8_t(c[1]), uint8_t(c[2]), 255 };
+			}
+		}
+
+		// ---- BC4 ----
+
+		inline void bc4_palette(int r0, int r1, int pal[8]) {
+			pal[0] = r0, pal[1] = r1;
+			if (r0 > r1) {
+				for (int i = 1; i < 7; i++)
+					pal[i + 1] = ((7 - i) * r0 + i * r1) / 7;
+			}
+			else {
+				for (int i = 1; i < 5; i++)
+					pal[i + 1] = ((5 - i) * r0 + i * r1) / 5;
+				pal[6] = 0, pal[7] = 255;
+			}
+		}
+
+		inline void encode_bc4_block(Block const& px, uint8_t* out) {
+			int mn = 255, mx = 0;
+			for (auto& p : px)
+				mn = (std::min)(mn, int(p[0])), mx = (std::max)(mx, int(p[0]));
+
+			uint64_t indices = 0;
+			if (mx != mn) {
+				int pal[8];
+				bc4_palette(mx, mn, pal);
+				for (int i = 0; i < 16; i++) {
+					int best = 0, bestErr = std::abs(px[i][0] - pal[0]);
+					for (int p = 1; p < 8; p++) {
+						int err = std::abs(px[i][0] - pal[p]);
+						if (err < bestErr) best = p, bestErr = err;
+					}
+					indices |= uint64_t(best) << (i * 3);
+				}
+			}
+
+			out[0] = uint8_t(mx), out[1] = uint8_t(mn);
+			for (int i = 0; i < 6; i++)
+				out[2 + i] = uint8_t(indices >> (i * 8));
+		}
+
+		inline void decode_bc4_block(uint8_t const* in, Block& px) {
+			int pal[8];
+			bc4_palette(in[0], in[1], pal);
+			uint64_t indices = 0;
+			for (int i = 0; i < 6; i++)
+				indices |= uint64_t(in[2 + i]) << (i * 8);
+
+			for (int i = 0; i < 16; i++) {
+				uint8_t v = uint8_t(pal[(indices >> (i * 3)) & 7]);
+				px[i] = { v, v, v, 255 };
+			}
+		}
+
+		// ---- BC7 (mode 6: one subset, 7.7.7.7 endpoints + p-bit, 4 bit indices) ----
+
+		static constexpr int bc7Weights[16] = { 0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64 };
+
+		struct Bits128 {
+			uint64_t lo = 0, hi = 0;
+			int pos = 0;
+
+			void write(uint32_t v, int count) {
+				for (int i = 0; i < count; i++, pos++) {
+					uint64_t bit = (v >> i) & 1;
+					if (pos < 64) lo |= bit << pos;
+					else hi |= bit << (pos - 64);
+				}
+			}
+
+			uint32_t read(int count) {
+				uint32_t v = 0;
+				for (int i = 0; i < count; i++, pos++)
+					v |= uint32_t(pos < 64 ? (lo >> pos) & 1 : (hi >> (pos - 64)) & 1) << i;
+				return v;
+			}
+		};
+
+		// Quantizes an endpoint to 7 bits per channel plus a shared p-bit, choosing the p-bit with least error.
+		inline void bc7_quantize(float const e[4], int q[4], int& pbit) {
+			int bestErr = -1;
+			for (int p = 0; p < 2; p++) {
+				int tq[4], err = 0;
+				for (int k = 0; k < 4; k++) {
+					tq[k] = std::clamp(int(std::lround((e[k] - p) / 2.0f)), 0, 127);
+					float d = float((tq[k] << 1) | p) - e[k];
+					err += int(d * d);
+				}
+				if (bestErr < 0 || err < bestErr) {
+					bestErr = err, pbit = p;
+					std::copy(tq, tq + 4, q);
+				}
+			}
+		}
+
+		inline int bc7_palette_and_indices(Block const& px, int const q0[4], int p0, int const q1[4], int p1, uint8_t idx[16]) {
+			int e0[4], e1[4], pal[16][4];
+			for (int k = 0; k < 4; k++)
+				e0[k] = (q0[k] << 1) | p0, e1[k] = (q1[k] << 1) | p1;
+			for (int i = 0; i < 16; i++)
+				for (int k = 0; k < 4; k++)
+					pal[i][k] = ((64 - bc7Weights[i]) * e0[k] + bc7Weights[i] * e1[k] + 32) >> 6;
+
+			int total = 0;
+			for (int i = 0; i < 16; i++) {
+				int best = 0, bestErr = INT32_MAX;
+				for (int p = 0; p < 16; p++) {
+					int err = sq(px[i][0] - pal[p][0]) + sq(px[i][1] - pal[p][1]) + sq(px[i][2] - pal[p][2]) + sq(px[i][3] - pal[p][3]);
+					if (err < bestErr) best = p, bestErr = err;
+				}
+				idx[i] = uint8_t(best);
+				total += bestErr;
+			}
+			return total;
+		}
+
+		inline void encode_bc7_block(Block const& px, uint8_t* out) {
+			// principal axis of the block through power iteration
+			float mean[4] = {};
+			for (auto& p : px)
+				for (int k = 0; k < 4; k++) mean[k] += p[k] / 16.0f;
+
+			float cov[4][4] = {};
+			for (auto& p : px) {
+				float d[4] = { p[0] - mean[0], p[1] - mean[1], p[2] - mean[2], p[3] - mean[3] };
+				for (int a = 0; a < 4; a++)
+					for (int b = 0; b < 4; b++) cov[a][b] += d[a] * d[b];
+			}
+
+			float axis[4] = { 1.0f, 1.0f, 1.0f, 1.0f };
+			for (int it = 0; it < 8; it++) {
+				float n[4] = {}, len = 0.0f;
+				for (int a = 0; a < 4; a++) {
+					for (int b = 0; b < 4; b++) n[a] += cov[a][b] * axis[b];
+					len += n[a] * n[a];
+				}
+				if (len < 1e-6f) break;
+				len = std::sqrt(len);
+				for (int a = 0; a < 4; a++) axis[a] = n[a] / len;
+			}
+
+			float tMin = 1e9f, tMax = -1e9f;
+			for (auto& p : px) {
+				float t = 0.0f;
+				for (int k = 0; k < 4; k++) t += (p[k] - mean[k]) * axis[k];
+				tMin = (std::min)(tMin, t), tMax = (std::max)(tMax, t);
+			}
+
+			float e0[4], e1[4];
+			for (int k = 0; k < 4; k++) {
+				e0[k] = std::clamp(mean[k] + tMin * axis[k], 0.0f, 255.0f);
+				e1[k] = std::clamp(mean[k] + tMax * axis[k], 0.0f, 255.0f);
+			}
+
+			int q0[4], q1[4], p0 = 0, p1 = 0;
+			uint8_t idx[16];
+			bc7_quantize(e0, q0, p0);
+			bc7_quantize(e1, q1, p1);
+			int err = bc7_palette_and_indices(px, q0, p0, q1, p1, idx);
+
+			// one least squares refinement of the endpoints for the chosen weights
+			float aa = 0, ab = 0, bb = 0, ax[4] = {}, bx[4] = {};
+			for (int i = 0; i < 16; i++) {
+				float w = bc7Weights[idx[i]] / 64.0f, a = 1.0f - w;
+				aa += a * a, ab += a * w, bb += w * w;
+				for (int k = 0; k < 4; k++) ax[k] += a * px[i][k], bx[k] += w * px[i][k];
+			}
+			float det = aa * bb - ab * ab;
+			if (std::abs(det) > 1e-6f) {
+				float r0[4], r1[4];
+				for (int k = 0; k < 4; k++) {
+					r0[k] = std::clamp((ax[k] * bb - bx[k] * ab) / det, 0.0f, 255.0f);
+					r1[k] = std::clamp((bx[k] * aa - ax[k] * ab) / det, 0.0f, 255.0f);
+				}
+				int rq0[4], rq1[4], rp0 = 0, rp1 = 0;
+				uint8_t ridx[16];
+				bc7_quantize(r0, rq0, rp0);
+				bc7_quantize(r1, rq1, rp1);
+				if (bc7_palette_and_indices(px, rq0, rp0, rq1, rp1, ridx) < err) {
+					std::copy(rq0, rq0 + 4, q0), std::copy(rq1, rq1 + 4, q1);
+					std::copy(ridx, ridx + 16, idx);
+					p0 = rp0, p1 = rp1;
+				}
+			}
+
+			// the anchor index is stored with an implicit zero msb
+			if (idx[0] & 8) {
+				std::swap(q0, q1), std::swap(p0, p1);
+				for (auto& i : idx) i = uint8_t(15 - i);
+			}
+
+			Bits128 bits;
+			bits.write(1 << 6, 7);
+			for (int k = 0; k < 4; k++) {
+				bits.write(q0[k], 7);
+				bits.write(q1[k], 7);
+			}
+			bits.write(p0, 1);
+			bits.write(p1, 1);
+			bits.write(idx[0], 3);
+			for (int i = 1; i < 16; i++)
+				bits.write(idx[i], 4);
+
+			std::memcpy(out, &bits.lo, 8);
+			std::memcpy(out + 8, &bits.hi, 8);
+		}
+
+		inline void decode_bc7_block(uint8_t const* in, Block& px) {
+			Bits128 bits;
+			std::memcpy(&bits.lo, in, 8);
+			std::memcpy(&bits.hi, in + 8, 8);
+
+			// only mode 6 is produced by the encoder, anything else decodes as transparent black
+			if (bits.read(7) != (1 << 6)) {
+				for (auto& p : px) p = { 0, 0, 0, 0 };
+				return;
+			}
+
+			int q0[4], q1[4];
+			for (int k = 0; k < 4; k++) {
+				q0[k] = bits.read(7);
+				q1[k] = bits.read(7);
+			}
+			int p0 = bits.read(1), p1 = bits.read(1);
+
+			for (int i = 0; i < 16; i++) {
+				int w = bc7Weights[bits.read(i == 0 ? 3 : 4)];
+				for (int k = 0; k < 4; k++) {
+					int e0 = (q0[k] << 1) | p0, e1 = (q1[k] << 1) | p1;
+					px[i][k] = uint8_t(((64 - w) * e0 + w * e1 + 32) >> 6);
+				}
+			}
+		}
+	}
+
+	// Encodes a tightly packed 1-4 channel image. Blocks are encoded in parallel, one row of blocks per task.
+	inline CompressedImage compress_image(uint8_t const* src, int w, int h, int c, eCompression format) {
+		CompressedImage image;
+		image.w = w, image.h = h, image.format = format;
+		if (format == fUncompressed || w <= 0 || h <= 0)
+			return image;
+
+		int bw = image.blocksX(), bh = image.blocksY(), bytes = block_bytes(format);
+		image.blocks.resize(size_t(bw) * bh * bytes);
+
+		parallel_for(0, bh, [&](int by) {
+			detail::Block block;
+			for (int bx = 0; bx < bw; bx++) {
+				detail::fetch_block(src, w, h, c, bx, by, block);
+				uint8_t* out = image.blocks.data() + (size_t(by) * bw + bx) * bytes;
+				if (format == fBC1) detail::encode_bc1_block(block, out);
+				if (format == fBC4) detail::encode_bc4_block(block, out);
+				if (format == fBC7) detail::encode_bc7_block(block, out);
+			}
+		});
+
+		return image;
+	}
+
+	inline CompressedImage compress_image(std::vector<uint8_t> const& src, int w, int h, int c, eCompression format) {
+		return compress_image(src.data(), w, h, c, format);
+	}
+
+	// Decodes back to a tightly packed image with 'c' channels, used for error metrics and CPU consumers.
+	inline std::vector<uint8_t> decompress_image(CompressedImage const& image, int c) {
+		std::vector<uint8_t> out(size_t(image.w) * image.h * c, 0);
+		if (image.empty())
+			return out;
+
+		int bw = image.blocksX(), bh = image.blocksY(), bytes = block_bytes(image.format);
+		parallel_for(0, bh, [&](int by) {
+			detail::Block block;
+			for (int bx = 0; bx < bw; bx++) {
+				uint8_t const* in = image.blocks.data() + (size_t(by) * bw + bx) * bytes;
+				if (image.format == fBC1) detail::decode_bc1_block(in, block);
+				if (image.format == fBC4) detail::decode_bc4_block(in, block);
+				if (image.format == fBC7) detail::decode_bc7_block(in, block);
+				detail::store_block(out.data(), image.w, image.h, c, bx, by, block);
+			}
+		});
+
+		return out;
+	}
+
+	// Peak signal to noise ratio in dB between two images of the same layout, infinity when identical.
+	inline double psnr(uint8_t const* a, uint8_t const* b, size_t count) {
+		double sum = 0.0;
+		for (size_t i = 0; i < count; i++) {
+			double d = double(a[i]) - double(b[i]);
+			sum += d * d;
+		}
+		if (sum == 0.0 || count == 0)
+			return INFINITY;
+		double mse = sum / double(count);
+		return 10.0 * std::log10(255.0 * 255.0 / mse);
+	}
+
+	inline double psnr(std::vector<uint8_t> const& a, std::vector<uint8_t> const& b) {
+		return psnr(a.data(), b.data(), (std::min)(a.size(), b.size()));
+	}
+}
+
+#endif // UI_COMPRESS
@@ -0,0 +1,200 @@
+#ifndef UI_DAMAGE
+#define UI_DAMAGE
+
+#include "packed.hpp"
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <climits>
+#include <iterator>
+#include <initializer_list>
+#include <utility>
+
+namespace ui {
+	// Area that changed between two frames, as a few rects plus their bounding box.
+	struct DamageRegion {
+		std::vector<std::array<int, 4>> rects; // x, y, w, h
+		std::array<int, 4> bounds{ 0, 0, 0, 0 };
+
+		bool empty() const { return rects.empty(); }
+
+		void clear() {
+			rects.clear();
+			bounds = { 0, 0, 0, 0 };
+		}
+
+		void add(int x0, int y0, int x1, int y1) {
+			if (x1 <= x0 || y1 <= y0)
+				return;
+			if (rects.empty()) {
+				bounds = { x0, y0, x1 - x0, y1 - y0 };
+			}
+			else {
+				int bx1 = (std::max)(bounds[0] + bounds[2], x1), by1 = (std::max)(bounds[1] + bounds[3], y1);
+				bounds[0] = (std::min)(bounds[0], x0), bounds[1] = (std::min)(bounds[1], y0);
+				bounds[2] = bx1 - bounds[0], bounds[3] = by1 - bounds[1];
+			}
+			rects.push_back({ x0, y0, x1 - x0, y1 - y0 });
+		}
+
+		void add(DamageRegion const& other) {
+			for (auto const& r : other.rects)
+				add(r[0], r[1], r[0] + r[2], r[1] + r[3]);
+		}
+	};
+
+	/*
+		Compares each frame with the previous one by object content, not by index: an object hashes
+		its rect, type and the records it points at (paint, clip, mask, radii, glyph run), so replayed
+		or re-recorded objects that did not change match even though their data offsets moved.
+		Objects with no match on either side contribute their bounds. Pure reordering of otherwise
+		identical objects is not seen.
+	*/
+	class DamageTracker {
+	public:
+		// Paint record lengths in Canvas::eStroke order: solid, linear, radial, conical, image, render, tile.
+		static constexpr int kPaintSizes[] = { 3, 8, 7, 7, 6, 2, 6 };
+		static constexpr int kPaintRender = 5, kPaintTile = 6;
+		static constexpr int kTextRun = 6, kRRect = 2, kLine = 5, kNinePatch = 7; // Canvas::eType values with data in r1
+		static constexpr int kNinePatchRecord = 13;
+		static constexpr size_t kMaxRects = 16;
+
+		using Range = std::pair<RenderObject const*, size_t>;
+
+		// Paints whose pixels change without their record changing (render targets, tile page
+		// slots that were reused) damage their bounds every frame. A viewport size change damages it all.
+		void compute(std::initializer_list<Range> ranges, int const* data, int const* paints, int viewportW, int viewportH) {
+			compute(ranges.begin(), ranges.size(), data, paints, viewportW, viewportH);
+		}
+
+		void compute(Range const* ranges, size_t count, int const* data, int const* paints, int viewportW, int viewportH) {
+			current_.clear();
+			damage_.clear();
+
+			bool full = viewportW != viewportW_ || viewportH != viewportH_;
+			viewportW_ = viewportW, viewportH_ = viewportH;
+
+			for (size_t r = 0; r < count; r++) {
+				auto [objects, n] = ranges[r];
+				for (size_t i = 0; i < n; i++) {
+					Entry e = entry_(objects[i], data, paints);
+					if (e.volatileContent)
+						damage_.add(e.x0, e.y0, e.x1, e.y1);
+					current_.push_back(e);
+				}
+			}
+
+			if (full) {
+				damage_.clear();
+				damage_.add(0, 0, viewportW, viewportH);
+			}
+			else {
+				std::sort(current_.begin(), current_.end(), [](Entry const& a, Entry const& b) { return a.hash < b.hash; });
+				size_t a = 0, b = 0;
+				while (a < current_.size() || b < previous_.size()) {
+					if (b == previous_.size() || (a < current_.size() && current_[a].hash < previous_[b].hash))
+						add_(current_[a++]);
+					else if (a == current_.size() || previous_[b].hash < current_[a].hash)
+						add_(previous_[b++]);
+					else
+						a++, b++;
+				}
+				if (damage_.rects.size() > kMaxRects) {
+					auto bounds = damage_.bounds;
+					damage_.clear();
+					damage_.add(bounds[0], bounds[1], bounds[0] + bounds[2], bounds[1] + bounds[3]);
+				}
+			}
+
+			if (full)
+				std::sort(current_.begin(), current_.end(), [](Entry const& a, Entry const& b) { return a.hash < b.hash; });
+			previous_.swap(current_);
+		}
+
+		// Forces the next frame to be fully damaged, e.g. after the render target was lost.
+		void reset() {
+			previous_.clear();
+			viewportW_ = viewportH_ = -1;
+		}
+
+		DamageRegion const& damage() const { return damage_; }
+
+		// Edges of what an object can touch, x1 and y1 exclusive: its rect or line extent widened
+		// by pen and line thickness, then cut to its clip.
+		static std::array<int, 4> bounds(RenderObject const& ro, int const* data, int const* paints) {
+			int pad = ro.penIndex >= 0 ? paints[ro.penIndex + 1] : 0;
+
+			// lines keep their end point in w, h and r1 is the thickness
+			int x0 = ro.x, y0 = ro.y, x1 = ro.x + ro.w, y1 = ro.y + ro.h;
+			if (ro.type == kLine) {
+				pad = (std::max)(pad, (ro.r1 + 1) / 2);
+				x0 = (std::min)(ro.x, ro.w), y0 = (std::min)(ro.y, ro.h), x1 = (std::max)(ro.x, ro.w), y1 = (std::max)(ro.y, ro.h);
+			}
+			x0 -= pad, y0 -= pad, x1 += pad, y1 += pad;
+
+			if (ro.clipIndex >= 0) {
+				int const* c = data + ro.clipIndex;
+				x0 = (std::max)(x0, c[0]), y0 = (std::max)(y0, c[1]);
+				x1 = (std::min)(x1, c[0] + c[2]), y1 = (std::min)(y1, c[1] + c[3]);
+			}
+			return { x0, y0, x1, y1 };
+		}
+
+	private:
+		struct Entry {
+			uint64_t hash;
+			int x0, y0, x1, y1;
+			bool volatileContent;
+		};
+
+		std::vector<Entry> current_, previous_;
+		DamageRegion damage_;
+		int viewportW_ = -1, viewportH_ = -1;
+
+		void add_(Entry const& e) {
+			damage_.add(e.x0, e.y0, e.x1, e.y1);
+		}
+
+		static void mix_(uint64_t& h, int v) {
+			h = (h ^ uint32_t(v)) * 1099511628211ull;
+		}
+
+		static void mixRecord_(uint64_t& h, int const* data, int index, int size) {
+			mix_(h, index < 0 ? -1 : size);
+			if (index >= 0)
+				for (int i = 0; i < size; i++)
+					mix_(h, data[index + i]);
+		}
+
+		static Entry entry_(RenderObject const& ro, int const* data, int const* paints) {
+			uint64_t h = 14695981039346656037ull;
+			mix_(h, ro.x), mix_(h, ro.y), mix_(h, ro.w), mix_(h, ro.h), mix_(h, ro.type);
+
+			bool volatileContent = false;
+			for (int index : { ro.brushIndex, ro.penIndex }) {
+				int kind = index >= 0 ? paints[index] : -1;
+				int size = kind >= 0 && kind < int(std::size(kPaintSizes)) ? kPaintSizes[kind] : 0;
+				mixRecord_(h, paints, index, size);
+				volatileContent |= kind == kPaintRender || kind == kPaintTile;
+			}
+
+			mixRecord_(h, data, ro.clipIndex, 4);
+			mixRecord_(h, data, ro.maskIndex, 4);
+			mixRecord_(h, data, ro.boundsIndex, 4);
+			if (ro.type == kRRect)
+				mixRecord_(h, data, ro.r1, 4);
+			else if (ro.type == kTextRun)
+				mixRecord_(h, data, ro.r1, 4 + data[ro.r1 + 3]);
+			else if (ro.type == kNinePatch)
+				mixRecord_(h, data, ro.r1, kNinePatchRecord);
+			else
+				mix_(h, ro.r1);
+
+			auto [x0, y0, x1, y1] = bounds(ro, data, paints);
+			return { h, x0, y0, x1, y1, volatileContent };
+		}
+	};
+}
+
+#endif // UI_DAMAGE
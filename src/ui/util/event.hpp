@@ -2,6 +2,7 @@
 #define UI_EVENT
 
 #include "misc.hpp"
+#include "platform.hpp"
 
 #include <memory>
 
@@ -84,9 +85,9 @@ namespace ui {
 		std::string description() const { return desc_ + " WID: " + std::to_string(windowID_) + "at " + std::to_string(x()) + ", " + std::to_string(y()); }
 		int windowID() const { return windowID_; }
 
-		bool alt() const { return (GetKeyState(VK_MENU) & 0x8000) != 0; }
-		bool ctrl() const { return (GetKeyState(VK_CONTROL) & 0x8000) != 0; }
-		bool shift() const { return (GetKeyState(VK_SHIFT) & 0x8000) != 0; }
+		bool alt() const { return platform::keyDown(kAlt); }
+		bool ctrl() const { return platform::keyDown(kControl); }
+		bool shift() const { return platform::keyDown(kShift); }
 	};
 
 	class MouseEvent : public Event {
@@ -150,13 +151,140 @@ namespace ui {
 
 	std::optional<std::function<void(Event* e)>> onEvent;
 
-	static void RawMsgToEvent(int windowID, HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) {
+	// Platform neutral input, queued with Backend::post. Headless windows get all their input this way.
+	struct InputEvent {
+		enum eKind {
+			eMouseMove, eMousePress, eMouseRelease, eMouseDoublePress, eWheel,
+			eKeyPress, eKeyRelease,
+			eResize, eClose, eFocus, eBlur, eHover, eLeave, eShow, eHide
+		};
+
+		int windowID = -1;
+		eKind kind = eMouseMove;
+		eButton button = fNoButton;
+		int x = 0, y = 0; // pointer position in the window, the new size for eResize
+		int delta = 0; // wheel, positive is up
+		int key = 0; // eKeyCode or character
+	};
+
+	namespace detail {
+		// pointer state shared by both translators, drags start on the first move with a button held
+		struct PointerState {
+			eButton button = fNoButton;
+			std::array<int, 2> mousePos{};
+			std::array<int, 2> mouseDownPos{};
+			bool dragStarted = false;
+		};
+		inline PointerState gPointer;
+	}
+
+	inline void DispatchEvent(std::unique_ptr<Event> const& e, int windowID) {
+		if (e && onEvent.has_value()) {
+			e->setPos(detail::gPointer.mousePos[0], detail::gPointer.mousePos[1]);
+			e->setWindowID(windowID);
+			onEvent.value()(e.get());
+		}
+	}
+
+	inline void InputToEvent(InputEvent const& in) {
 		std::unique_ptr<Event> e;
+		auto& [button, mousePos, mouseDownPos, dragStarted] = detail::gPointer;
+
+		switch (in.kind) {
+		case InputEvent::eMouseMove:
+			if (button != fNoButton && !dragStarted) {
+				dragStarted = true;
+				e = std::make_unique<DragEvent>(button, fStart);
+			}
+			else if (button != fNoButton && dragStarted)
+				e = std::make_unique<DragEvent>(button, fMove);
+			else
+				e = std::make_unique<MouseEvent>(button, fMove);
+			mousePos = { in.x, in.y };
+			break;
+		case InputEvent::eMousePress:
+			e = std::make_unique<MouseEvent>(in.button, fPress);
+			mousePos = mouseDownPos = { in.x, in.y }, button = in.button;
+			break;
+		case InputEvent::eMouseRelease:
+			e = std::make_unique<MouseEvent>(in.button, fRelease);
+			mousePos = { in.x, in.y }, button = fNoButton, dragStarted = false;
+			break;
+		case InputEvent::eMouseDoublePress:
+			e = std::make_unique<MouseEvent>(in.button, fDoublePress);
+			mousePos = mouseDownPos = { in.x, in.y };
+			break;
+		case InputEvent::eWheel:
+			e = std::make_unique<MouseEvent>(fNoButton, in.delta > 0 ? fWheelUp : fWheelDown);
+			break;
+		case InputEvent::eKeyPress:
+			platform::setKeyDown(in.key, true);
+			e = std::make_unique<KeyEvent>(fPress, static_cast<char>(in.key));
+			break;
+		case InputEvent::eKeyRelease:
+			platform::setKeyDown(in.key, false);
+			e = std::make_unique<KeyEvent>(fRelease, static_cast<char>(in.key));
+			break;
+		case InputEvent::eResize: e = std::make_unique<WindowEvent>(fResize); break;
+		case InputEvent::eClose: e = std::make_unique<WindowEvent>(fClose); break;
+		case InputEvent::eFocus: e = std::make_unique<WindowEvent>(fGainedFocus); break;
+		case InputEvent::eBlur: e = std::make_unique<WindowEvent>(fLostFocus); break;
+		case InputEvent::eHover: e = std::make_unique<WindowEvent>(fHover); break;
+		case InputEvent::eLeave: e = std::make_unique<WindowEvent>(fLeave); break;
+		case InputEvent::eShow: e = std::make_unique<WindowEvent>(fShow); break;
+		case InputEvent::eHide: e = std::make_unique<WindowEvent>(fHide); break;
+		}
+
+		DispatchEvent(e, in.windowID);
+	}
 
-		static eButton button = fNoButton;
-		static std::array<int, 2> mousePos = {};
-		static std::array<int, 2> mouseDownPos;
-		static bool dragStarted = false;
+#ifdef UI_PLATFORM_WIN32
+	// The neutral form of a window message when InputEvent has a kind for it, so recorded Win32
+	// input replays on any platform. Minimize, maximize, activation and moves have none.
+	inline std::optional<InputEvent> MsgToInput(int windowID, UINT msg, WPARAM wp, LPARAM lp) {
+		int x = (short)LOWORD(lp), y = (short)HIWORD(lp);
+		auto make = [&](InputEvent::eKind kind, eButton button = fNoButton) {
+			InputEvent in;
+			in.windowID = windowID, in.kind = kind, in.button = button, in.x = x, in.y = y;
+			return in;
+		};
+
+		switch (msg) {
+		case WM_KEYDOWN: case WM_KEYUP: {
+			auto in = make(msg == WM_KEYDOWN ? InputEvent::eKeyPress : InputEvent::eKeyRelease);
+			in.x = detail::gPointer.mousePos[0], in.y = detail::gPointer.mousePos[1], in.key = int(wp);
+			return in;
+		}
+		case WM_LBUTTONDOWN: return make(InputEvent::eMousePress, fLeft);
+		case WM_MBUTTONDOWN: return make(InputEvent::eMousePress, fMiddle);
+		case WM_RBUTTONDOWN: return make(InputEvent::eMousePress, fRight);
+		case WM_LBUTTONUP: return make(InputEvent::eMouseRelease, fLeft);
+		case WM_MBUTTONUP: return make(InputEvent::eMouseRelease, fMiddle);
+		case WM_RBUTTONUP: return make(InputEvent::eMouseRelease, fRight);
+		case WM_LBUTTONDBLCLK: return make(InputEvent::eMouseDoublePress, fLeft);
+		case WM_MBUTTONDBLCLK: return make(InputEvent::eMouseDoublePress, fMiddle);
+		case WM_RBUTTONDBLCLK: return make(InputEvent::eMouseDoublePress, fRight);
+		case WM_MOUSEMOVE: return make(InputEvent::eMouseMove, detail::gPointer.button);
+		case WM_MOUSEWHEEL: {
+			// wheel positions are in screen coordinates, the last client position is kept
+			auto in = make(InputEvent::eWheel);
+			in.x = detail::gPointer.mousePos[0], in.y = detail::gPointer.mousePos[1], in.delta = GET_WHEEL_DELTA_WPARAM(wp);
+			return in;
+		}
+		case WM_SIZE: return make(InputEvent::eResize); // client width and height
+		case WM_CLOSE: return make(InputEvent::eClose);
+		case WM_SETFOCUS: return make(InputEvent::eFocus);
+		case WM_KILLFOCUS: return make(InputEvent::eBlur);
+		case WM_MOUSEHOVER: return make(InputEvent::eHover);
+		case WM_MOUSELEAVE: return make(InputEvent::eLeave);
+		case WM_SHOWWINDOW: return make(wp ? InputEvent::eShow : InputEvent::eHide);
+		default: return std::nullopt;
+		}
+	}
+
+	static void RawMsgToEvent(int windowID, HWND hwnd, UINT msg, WPARAM wp, LPARAM lp) {
+		std::unique_ptr<Event> e;
+		auto& [button, mousePos, mouseDownPos, dragStarted] = detail::gPointer;
 
 		switch (msg) {
 		case WM_KEYDOWN:
@@ -279,13 +407,10 @@ namespace ui {
 			break;
 		}
 
-		if (e && onEvent.has_value()) {
-			e->setPos(mousePos[0], mousePos[1]);
-			e->setWindowID(windowID);
-			onEvent.value()(e.get());	
-		}
+		DispatchEvent(e, windowID);
 	}
+#endif // UI_PLATFORM_WIN32
 }
 
 
-#endif UI_EVENT
\ No newline at end of file
+#endif // UI_EVENT
\ No newline at end of file
@@ -0,0 +1,73 @@
+#ifndef UI_HEADLESS_WINDOW
+#define UI_HEADLESS_WINDOW
+
+#include "platform.hpp"
+
+#include <string>
+#include <array>
+#include <cstdint>
+
+namespace ui {
+	// Native without a window system. Holds the size and state a window would have, input
+	// comes from Backend::post and nothing is ever presented.
+	class Native {
+		int id_;
+		int x_, y_, w_, h_;
+		int mouseX_ = 0, mouseY_ = 0;
+		bool visible_ = false, enabled_ = true, decorated_ = true;
+		int state_ = 0;
+		std::string title_ = "Title";
+		eNativeType type_ = fPersistent;
+	public:
+		enum eState { eShown, eHidden, eMinimized, eMaximized };
+
+		Native(int id, int x, int y, int w, int h, eNativeType nType) : id_(id), x_(x), y_(y), w_(w), h_(h), type_(nType) {}
+
+		void removeTitleBarAndButtons() { decorated_ = false; }
+
+		void swapBuffers() {}
+		void show() { visible_ = true, state_ = eShown; }
+		void hide() { visible_ = false, state_ = eHidden; }
+		void minimize() { state_ = eMinimized; }
+		void maximize() { state_ = eMaximized; }
+		void restore() { state_ = eShown; }
+
+		void setState(int state) { state_ = state, visible_ = state != eHidden; }
+		void setTitle(std::string const& title) { title_ = title; }
+		void setX(int x) { x_ = x; }
+		void setY(int y) { y_ = y; }
+		void setPos(int x, int y) { x_ = x, y_ = y; }
+		void setWidth(int w) { w_ = w; }
+		void setHeight(int h) { h_ = h; }
+		void setSize(int w, int h) { w_ = w, h_ = h; }
+		void setEnabled(bool enabled) { enabled_ = enabled; }
+		void setFocus() {}
+		void setWindowType(eNativeType type) { type_ = type; }
+
+		// last injected pointer position, in client coordinates
+		void setMousePos(int x, int y) { mouseX_ = x, mouseY_ = y; }
+
+		// Getters, client area at 0, 0 as with GetClientRect
+		std::array<int, 2> mousePos() const { return { x_ + mouseX_, y_ + mouseY_ }; }
+		std::array<int, 2> windowPos() const { return { 0, 0 }; }
+		std::array<int, 2> windowSize() const { return { w_, h_ }; }
+		std::array<int, 2> screenPos(int x, int y) const { return { x_ + x, y_ + y }; }
+		int x() const { return 0; }
+		int y() const { return 0; }
+		int width() const { return w_; }
+		int height() const { return h_; }
+		std::array<int, 4> rect() const { return { 0, 0, w_, h_ }; }
+		int id() const { return id_; }
+		eNativeType type() const { return type_; }
+
+		bool visible() const { return visible_; }
+		bool enabled() const { return enabled_; }
+		bool decorated() const { return decorated_; }
+		int state() const { return state_; }
+		std::string const& title() const { return title_; }
+
+		Surface hdc() const { return nullptr; }
+	};
+}
+
+#endif // UI_HEADLESS_WINDOW
@@ -6,9 +6,16 @@
 #define STB_IMAGE_IMPLEMENTATION
 #include "parsing/stb_image.h"
 
+#include "compress.hpp"
+
 #include <filesystem>
 #include <unordered_map>
 #include <array>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <map>
+#include <tuple>
 
 namespace ui {
 	bool save_image(std::string const& path, std::vector<unsigned char> const& data, int w, int h, int c) {
@@ -57,14 +64,36 @@ namespace ui {
 		std::vector<unsigned char> data_;
 		std::unordered_map<size_t, Image> images_;
 		eFormat format_;
+		eCompression compression_ = fUncompressed;
+		CompressedImage compressed_;
+
+		static constexpr uint32_t bundleMagic = 0x42415848; // "HXAB"
+		static constexpr uint32_t bundleVersion = 1;
 
 		ImageAtlas() = default;
-		ImageAtlas(std::string const& folder, eFormat format) : format_(format) {
-			for (const auto& entry : std::filesystem::directory_iterator(folder)) {
-				Image image;
-				if (load_image(entry.path().string(), image.data, image.w, image.h, image.c)) {
-					images_[std::hash<std::string>{}(entry.path().stem().string())] = image;
-				}
+		ImageAtlas(std::string const& folder, eFormat format, eCompression compression = fUncompressed) : format_(format), compression_(compression) {
+			// compressed atlases are encoded once and cached in a bundle next to the folder
+			std::string bundle = folder + ".atlas";
+			uint64_t key = bundle_key_(folder);
+			if (compression_ != fUncompressed && load_bundle(bundle, key))
+				return;
+
+			// files decode independently, only the insert into images_ is serial
+			// a missing folder gives an empty atlas, headless runs do without the assets
+			std::vector<std::filesystem::path> paths;
+			std::error_code ec;
+			for (const auto& entry : std::filesystem::directory_iterator(folder, ec))
+				paths.push_back(entry.path());
+
+			std::vector<Image> decoded(paths.size());
+			std::vector<char> loaded(paths.size(), 0);
+			parallel_for(0, int(paths.size()), [&](int i) {
+				loaded[i] = load_image(paths[i].string(), decoded[i].data, decoded[i].w, decoded[i].h, decoded[i].c);
+			});
+
+			for (size_t i = 0; i < paths.size(); i++) {
+				if (loaded[i])
+					images_[std::hash<std::string>{}(paths[i].stem().string())] = std::move(decoded[i]);
 			}
 
 			float totalW = 0.0, totalH = 0.0;
@@ -76,6 +105,106 @@ namespace ui {
 			case RGB: build_(images_, 3); break;
 			case RGBA: build_(images_, 4); break;
 			}
+
+			if (compression_ != fUncompressed && !images_.empty()) {
+				compress(compression_);
+				save_bundle(bundle, key);
+			}
+		}
+
+		// Loads a folder once per process, every Canvas and the renderer share the result.
+		// Safe to call from startup workers, different folders load concurrently.
+		static std::shared_ptr<ImageAtlas> shared(std::string const& folder, eFormat format, eCompression compression = fUncompressed) {
+			using Key = std::tuple<std::string, int, int>;
+			static std::mutex mutex;
+			static std::map<Key, std::shared_ptr<ImageAtlas>> cache;
+
+			Key key{ folder, format, compression };
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (auto it = cache.find(key); it != cache.end())
+					return it->second;
+			}
+
+			auto atlas = std::make_shared<ImageAtlas>(folder, format, compression);
+
+			std::lock_guard<std::mutex> lock(mutex);
+			return cache.emplace(key, atlas).first->second;
+		}
+
+		// Single channel pages always use BC4, colour pages use BC1 or BC7.
+		void compress(eCompression compression) {
+			compression_ = c_ == 1 ? fBC4 : compression == fBC4 ? fBC7 : compression;
+			compressed_ = compress_image(data_, w_, h_, c_, compression_);
+		}
+
+		bool compressed() const { return !compressed_.empty(); }
+		eCompression compression() const { return compression_; }
+		CompressedImage const& blocks() const { return compressed_; }
+
+		void save_bundle(std::string const& path, uint64_t key) const {
+			std::ofstream file(path, std::ios::binary);
+			if (!file.is_open())
+				return;
+
+			auto put = [&](auto v) { file.write(reinterpret_cast<char const*>(&v), sizeof(v)); };
+			put(bundleMagic), put(bundleVersion), put(key);
+			put(int32_t(format_)), put(int32_t(compression_)), put(int32_t(w_)), put(int32_t(h_)), put(int32_t(c_));
+
+			put(uint32_t(images_.size()));
+			for (auto const& [hash, p] : images_) {
+				put(uint64_t(hash)), put(int32_t(p.w)), put(int32_t(p.h)), put(int32_t(p.c)), put(int32_t(p.index));
+				for (int r : p.region) put(int32_t(r));
+			}
+
+			put(uint64_t(compressed_.blocks.size()));
+			file.write(reinterpret_cast<char const*>(compressed_.blocks.data()), compressed_.blocks.size());
+		}
+
+		bool load_bundle(std::string const& path, uint64_t key) {
+			std::ifstream file(path, std::ios::binary);
+			if (!file.is_open())
+				return false;
+
+			auto get = [&](auto& v) { file.read(reinterpret_cast<char*>(&v), sizeof(v)); return bool(file); };
+			uint32_t magic = 0, version = 0;
+			uint64_t fileKey = 0;
+			int32_t format = 0, compression = 0, w = 0, h = 0, c = 0;
+			if (!get(magic) || !get(version) || !get(fileKey) || magic != bundleMagic || version != bundleVersion || fileKey != key)
+				return false;
+			if (!get(format) || !get(compression) || !get(w) || !get(h) || !get(c) || format != format_)
+				return false;
+
+			uint32_t count = 0;
+			if (!get(count))
+				return false;
+
+			std::unordered_map<size_t, Image> images;
+			for (uint32_t i = 0; i < count; i++) {
+				uint64_t hash = 0;
+				int32_t iw, ih, ic, index, region[4];
+				if (!get(hash) || !get(iw) || !get(ih) || !get(ic) || !get(index) || !get(region))
+					return false;
+				images[size_t(hash)] = Image{ iw, ih, ic, {}, { region[0], region[1], region[2], region[3] }, index };
+			}
+
+			uint64_t size = 0;
+			if (!get(size))
+				return false;
+
+			CompressedImage blocks;
+			blocks.w = w, blocks.h = h, blocks.format = eCompression(compression);
+			blocks.blocks.resize(size);
+			file.read(reinterpret_cast<char*>(blocks.blocks.data()), size);
+			if (!file || size != size_t(blocks.blocksX()) * blocks.blocksY() * block_bytes(blocks.format))
+				return false;
+
+			w_ = w, h_ = h, c_ = c;
+			images_ = std::move(images);
+			compression_ = blocks.format;
+			compressed_ = std::move(blocks);
+			data_ = decompress_image(compressed_, c_);
+			return true;
 		}
 
 		void save_atlas(std::string const& path) const {
@@ -90,6 +219,12 @@ namespace ui {
 			return images_.at(std::hash<std::string>{}(key));
 		}
 
+		// nullptr when the atlas has no image of that name
+		Image const* find(std::string const& key) const {
+			auto it = images_.find(std::hash<std::string>{}(key));
+			return it == images_.end() ? nullptr : &it->second;
+		}
+
 		Image& getRegion(std::string const& key) {
 			return images_.at(std::hash<std::string>{}(key));
 		}
@@ -104,6 +239,22 @@ namespace ui {
 			return regions;
 		}
 	private:
+		// Identifies the folder contents so a stale bundle is rebuilt when an image changes.
+		uint64_t bundle_key_(std::string const& folder) const {
+			std::vector<std::string> entries;
+			std::error_code ec;
+			for (const auto& entry : std::filesystem::directory_iterator(folder, ec)) {
+				auto time = std::filesystem::last_write_time(entry.path(), ec).time_since_epoch().count();
+				entries.push_back(entry.path().filename().string() + ":" + std::to_string(entry.file_size(ec)) + ":" + std::to_string(time));
+			}
+			std::sort(entries.begin(), entries.end());
+
+			uint64_t key = std::hash<int>{}(format_ * 16 + compression_);
+			for (auto const& e : entries)
+				key = key * 1099511628211ull ^ std::hash<std::string>{}(e);
+			return key;
+		}
+
 		void build_(std::unordered_map<size_t, Image>& images, int c) {
 
 			float totalW = 0.0, totalH = 0.0;
@@ -0,0 +1,192 @@
+#ifndef UI_LAYER
+#define UI_LAYER
+
+#include "canvas.hpp"
+#include "raster.hpp"
+#include "pyramid.hpp"
+
+#include <cstdint>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+namespace ui {
+	/*
+		Offscreen layers for subtrees that are expensive to draw but rarely change, see
+		Widget::setCacheAsLayer. A layer is the subtree's display list rasterized on the CPU into
+		RGBA tiles of the canvas' tile page size, composited as one eTile rect per tile, so the GL and
+		CPU renderers both draw it without knowing about layers.
+
+		Layers are keyed by widget and hold the stamp of the display list they were made from, a newer
+		list or another rect renders the layer again. All layers share one byte budget and the least
+		recently composited are evicted first.
+
+		Tile slots are placed through Canvas::place, so a display list an ancestor captures around the
+		composite keeps them placed on replay and stays valid until the layer's widget is invalidated.
+
+		Content outside the widget's rect is cut off. Layers start transparent, so the raster holds
+		colour times coverage; tiles are un-premultiplied when they are cut, since the composite blends
+		with the source alpha again.
+	*/
+	class LayerCache {
+	public:
+		struct Layer {
+			uint64_t stamp;
+			Rect rect;
+			int tileSize, tilesX, tilesY;
+			std::vector<Tile> tiles; // row major
+
+			size_t bytes() const {
+				size_t n = 0;
+				for (auto const& t : tiles)
+					n += t.bytes();
+				return n;
+			}
+		};
+
+		static constexpr size_t kDefaultBudget = size_t(64) << 20;
+
+		explicit LayerCache(size_t budget = kDefaultBudget) : budget_(budget), cache_(budget) {}
+
+		// Draws the layer for key into c as tile rects, rendering it first when it is missing or stale.
+		// Returns false, with nothing drawn, when the list cannot be used here or the layer would not
+		// fit the budget or the tile page; the caller then paints or replays as usual.
+		bool composite(Canvas* c, uint64_t key, uint64_t stamp, DisplayList const& dl, Rect const& r) {
+			if (r.w <= 0 || r.h <= 0 || size_t(r.w) * r.h * 4 > budget_ || !c->replayable(dl))
+				return false;
+
+			auto layer = cache_.find(key);
+			if (!layer || layer->stamp != stamp || layer->rect.x != r.x || layer->rect.y != r.y || layer->rect.w != r.w || layer->rect.h != r.h) {
+				for (uint64_t k : dl.tiles) {
+					if (!c->tilePage.touch(k))
+						return false; // the list samples a tile that is gone, it has to be recorded again
+				}
+				layer = render_(c, stamp, dl, r);
+				cache_.insert(key, layer, layer->bytes());
+				renders_++;
+			}
+
+			// every slot is placed before anything is drawn, a full page falls back to the list
+			regions_.clear();
+			for (int i = 0; i < int(layer->tiles.size()); i++) {
+				auto region = c->place(tileKey_(key, stamp, i), layer->tiles[i]);
+				if (!region)
+					return false;
+				regions_.push_back(*region);
+			}
+
+			for (int ty = 0; ty < layer->tilesY; ty++) {
+				for (int tx = 0; tx < layer->tilesX; tx++) {
+					auto const& region = regions_[ty * layer->tilesX + tx];
+					c->tile(region);
+					c->rect(r.x + tx * layer->tileSize, r.y + ty * layer->tileSize, region[2], region[3]);
+				}
+			}
+			composites_++;
+			return true;
+		}
+
+		void erase(uint64_t key) { cache_.erase(key); }
+
+		size_t budget() const { return budget_; }
+		size_t renders() const { return renders_; }
+		size_t composites() const { return composites_; }
+		LruCache<uint64_t, Layer>& cache() { return cache_; }
+
+	private:
+		size_t budget_;
+		LruCache<uint64_t, Layer> cache_;
+		std::unique_ptr<Rasterizer> raster_;
+		std::vector<std::array<int, 4>> regions_;
+		size_t renders_ = 0, composites_ = 0;
+
+		// Top bits 10 so layer slots never share a key with TiledImage tiles or shadows.
+		static uint64_t tileKey_(uint64_t key, uint64_t stamp, int tile) {
+			return 1ull << 63 | (key & 0x3FFFFF) << 40 | (stamp & 0xFFFFFF) << 16 | uint64_t(tile & 0xFFFF);
+		}
+
+		std::shared_ptr<Layer> render_(Canvas* c, uint64_t stamp, DisplayList const& dl, Rect const& r) {
+			if (!raster_) {
+				raster_ = std::make_unique<Rasterizer>(c->maskAtlas, c->imageAtlas);
+				raster_->setClearColor(color(0, 0, 0, 0));
+			}
+
+			// The list moved to the layer's origin. Clip and bounds records may be shared between
+			// objects and paints between lists, each is moved once.
+			std::array<std::vector<RenderObject>, kLayers> layers = dl.layers;
+			std::vector<int> data = dl.data;
+			auto source = c->paints.span();
+			std::vector<int> paints(source.begin(), source.end());
+			std::vector<uint8_t> movedData(data.size(), 0), movedPaint(paints.size(), 0);
+			int dx = -r.x, dy = -r.y;
+
+			auto moveRecord = [&](int index) {
+				if (index >= 0 && index + 1 < int(data.size()) && !movedData[index])
+					movedData[index] = 1, data[index] += dx, data[index + 1] += dy;
+			};
+			auto movePaint = [&](int p) {
+				if (p < 0 || p >= int(paints.size()) || movedPaint[p])
+					return;
+				movedPaint[p] = 1;
+				switch (paints[p]) {
+				case Canvas::eLinear:
+					paints[p + 4] += dx, paints[p + 5] += dy, paints[p + 6] += dx, paints[p + 7] += dy;
+					break;
+				case Canvas::eRadial: case Canvas::eConical:
+					paints[p + 4] += dx, paints[p + 5] += dy;
+					break;
+				default:
+					break;
+				}
+			};
+
+			for (auto& l : layers) {
+				for (auto& ro : l) {
+					ro.x += dx, ro.y += dy;
+					if (ro.type == Canvas::eLine)
+						ro.w += dx, ro.h += dy; // end point
+					if (ro.type == Canvas::eTextRun)
+						moveRecord(ro.r1); // origin
+					if (ro.clipIndex == DisplayList::kExternalClip)
+						ro.clipIndex = -1; // the composite is clipped by the enclosing clip instead
+					moveRecord(ro.clipIndex), moveRecord(ro.boundsIndex);
+					movePaint(ro.brushIndex), movePaint(ro.penIndex);
+				}
+			}
+
+			FramePacket packet{ {}, { data.data(), data.size() }, { paints.data(), paints.size() }, 0 };
+			for (int i = 0; i < kLayers; i++)
+				packet.layers[i] = { layers[i].data(), layers[i].size() };
+			raster_->render(packet, r.w, r.h, &c->tilePage);
+
+			// cut into page sized tiles
+			auto layer = std::make_shared<Layer>();
+			layer->stamp = stamp, layer->rect = r;
+			layer->tileSize = c->tilePage.tileSize();
+			layer->tilesX = (r.w + layer->tileSize - 1) / layer->tileSize;
+			layer->tilesY = (r.h + layer->tileSize - 1) / layer->tileSize;
+			uint32_t const* pixels = raster_->pixels();
+			for (int ty = 0; ty < layer->tilesY; ty++) {
+				for (int tx = 0; tx < layer->tilesX; tx++) {
+					Tile t;
+					t.w = (std::min)(layer->tileSize, r.w - tx * layer->tileSize);
+					t.h = (std::min)(layer->tileSize, r.h - ty * layer->tileSize);
+					t.rgba.resize(size_t(t.w) * t.h * 4);
+					for (int y = 0; y < t.h; y++)
+						std::memcpy(t.rgba.data() + size_t(y) * t.w * 4, pixels + size_t(ty * layer->tileSize + y) * r.w + tx * layer->tileSize, size_t(t.w) * 4);
+					for (size_t i = 0; i < t.rgba.size(); i += 4) {
+						int a = t.rgba[i + 3];
+						if (a == 0 || a == 255)
+							continue;
+						for (int k = 0; k < 3; k++)
+							t.rgba[i + k] = uint8_t((std::min)(255, (t.rgba[i + k] * 255 + a / 2) / a));
+					}
+					layer->tiles.push_back(std::move(t));
+				}
+			}
+			return layer;
+		}
+	};
+}
+
+#endif // UI_LAYER
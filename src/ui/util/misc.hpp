@@ -1,9 +1,7 @@
 #ifndef UI_MISC
 #define UI_MISC
 
-#include <Windows.h>
-
-
+#include <cstdint>
 #include <variant>
 #include <optional>
 #include <string>
@@ -17,6 +15,8 @@
 #include <map>
 #include <variant>
 #include <optional>
+#include <algorithm>
+#include <initializer_list>
 
 namespace ui {
 #define PI 3.14159265358979323846
@@ -102,10 +102,10 @@ namespace ui {
 		}
 
 		Rect clipped(const Rect& clipRect) const {
-			int nx = max(x, clipRect.x);
-			int ny = max(y, clipRect.y);
-			int nw = min(x + w, clipRect.x + clipRect.w) - nx;
-			int nh = min(y + h, clipRect.y + clipRect.h) - ny;
+			int nx = (std::max)(x, clipRect.x);
+			int ny = (std::max)(y, clipRect.y);
+			int nw = (std::min)(x + w, clipRect.x + clipRect.w) - nx;
+			int nh = (std::min)(y + h, clipRect.y + clipRect.h) - ny;
 			if (nw < 0 || nh < 0) return Rect(0, 0, 0, 0); // No intersection
 			return Rect(nx, ny, nw, nh);
 		}
@@ -126,7 +126,14 @@ namespace ui {
 	enum fConstraint {
 		fFixed,
 		fRelative,
-		fFlex
+		fFlex,
+		fContent
+	};
+
+	// What a widget reports from its measure pass, the least it shows its content in and the size
+	// it prefers.
+	struct SizeHint {
+		int minW = 0, minH = 0, w = 0, h = 0;
 	};
 
 	struct Style {
@@ -149,7 +156,105 @@ namespace ui {
 		fSpaceAround
 	};
 
+	// Non owning view over contiguous storage.
+	template<typename T>
+	struct Span {
+		T* ptr = nullptr;
+		size_t count = 0;
+
+		T* data() const { return ptr; }
+		size_t size() const { return count; }
+		size_t bytes() const { return count * sizeof(T); }
+		bool empty() const { return count == 0; }
+		T* begin() const { return ptr; }
+		T* end() const { return ptr + count; }
+		T& operator[](size_t i) const { return ptr[i]; }
+	};
+
+	// Bump allocator over one contiguous int stream. reset() keeps the storage, so once a frame
+	// has reached its high water mark recording does not touch the heap.
+	class FrameArena {
+		std::vector<int> storage_;
+		size_t used_ = 0, peak_ = 0, growths_ = 0;
+	public:
+		int* alloc(size_t n) {
+			if (used_ + n > storage_.size()) {
+				storage_.resize((std::max)(storage_.size() * 2, used_ + n + 256));
+				growths_++;
+			}
+			int* p = storage_.data() + used_;
+			used_ += n;
+			return p;
+		}
+
+		// Returns the offset the values were written at.
+		int write(std::initializer_list<int> values) {
+			int offset = int(used_);
+			std::copy(values.begin(), values.end(), alloc(values.size()));
+			return offset;
+		}
+
+		void reset() {
+			peak_ = (std::max)(peak_, used_);
+			used_ = 0;
+		}
+
+		void reserve(size_t n) {
+			if (n > storage_.size())
+				storage_.resize(n), growths_++;
+		}
+
+		// Offsets stay valid across growth, pointers from alloc() do not.
+		int& operator[](size_t i) { return storage_[i]; }
+
+		size_t size() const { return used_; }
+		size_t peak() const { return (std::max)(peak_, used_); }
+		size_t growths() const { return growths_; }
+		int const* data() const { return storage_.data(); }
+		Span<int const> span() const { return { storage_.data(), used_ }; }
+	};
+
+	// Grows towards the front so the newest element is first, recording order is reversed
+	// as it is written. Capacity is kept across clear().
+	template<typename T>
+	class ReverseBuffer {
+		std::vector<T> storage_;
+		size_t head_ = 0, growths_ = 0;
+	public:
+		T& push() {
+			if (head_ == 0)
+				reserve((std::max)(storage_.size() * 2, size_t(64)));
+			storage_[--head_] = T{};
+			return storage_[head_];
+		}
+
+		// Places a block recorded elsewhere in front, keeping its order, and returns its first element.
+		T* prepend(T const* block, size_t n) {
+			if (head_ < n)
+				reserve((std::max)(storage_.size() * 2, size() + n + 64));
+			head_ -= n;
+			std::copy(block, block + n, storage_.begin() + head_);
+			return storage_.data() + head_;
+		}
 
+		void reserve(size_t n) {
+			if (n <= storage_.size())
+				return;
+			size_t used = size();
+			std::vector<T> next(n);
+			std::move(storage_.begin() + head_, storage_.end(), next.end() - used);
+			storage_.swap(next);
+			head_ = n - used;
+			growths_++;
+		}
+
+		void clear() { head_ = storage_.size(); }
+		size_t size() const { return storage_.size() - head_; }
+		bool empty() const { return size() == 0; }
+		size_t capacity() const { return storage_.size(); }
+		size_t growths() const { return growths_; }
+		Span<T const> span() const { return { storage_.data() + head_, size() }; }
+	};
 
 }
 
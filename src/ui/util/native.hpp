@@ -1,7 +1,11 @@
 #ifndef UI_WINDOW
 #define UI_WINDOW
 
-#include <Windows.h>
+#include "platform.hpp"
+
+#ifdef UI_PLATFORM_HEADLESS
+#include "headless.hpp"
+#else
 #include <string>
 #include <functional>
 #include <array>
@@ -47,11 +51,6 @@ namespace ui {
 
 	static LRESULT CALLBACK WndProc(HWND hwnd, UINT msg, WPARAM wp, LPARAM lp);
 
-	enum eNativeType {
-		fPersistent,
-		fTransient
-	};
-
 	class Native {
 		int id_;
 		HDC hdc_;
@@ -191,5 +190,6 @@ namespace ui {
 		return DefWindowProc(hwnd, msg, wp, lp);
 	}
 }
+#endif // UI_PLATFORM_HEADLESS
 
 #endif // UI_WINDOW
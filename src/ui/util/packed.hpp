@@ -0,0 +1,98 @@
+#ifndef UI_PACKED
+#define UI_PACKED
+
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+
+namespace ui {
+	struct RenderObject {
+		int x, y, w, h;
+		int type, brushIndex = -1, penIndex = -1, clipIndex = -1;
+		int maskIndex = -1, boundsIndex = -1, r1, r2;
+	};
+
+	/*
+		24 byte upload form of a RenderObject, six words:
+			0: x      int16 | y      int16 << 16
+			1: w      int16 | h      int16 << 16
+			2: type   4 bit | flags  4 bit << 4 | brush 24 bit << 8
+			3: pen   24 bit | clip low 8 bit << 24
+			4: clip high 16 | r1 low 16 bit << 16
+			5: r1 high 8    | aux   24 bit << 8
+		Indices are stored unsigned with 0xFFFFFF meaning -1, so data streams are limited to 16M ints.
+		aux is the mask record, or the bounds record when fAuxBounds is set. r2 is not carried.
+	*/
+	struct PackedObject {
+		uint32_t words[6];
+	};
+	static_assert(sizeof(PackedObject) == 24, "PackedObject must stay 24 bytes");
+
+	enum fPacked {
+		fAuxBounds = 1 << 0
+	};
+
+	namespace detail {
+		constexpr uint32_t kNoIndex = 0xFFFFFF;
+
+		inline uint32_t pack16(int v) {
+			return uint32_t(uint16_t(int16_t((std::clamp)(v, -32768, 32767))));
+		}
+
+		inline int unpack16(uint32_t v) {
+			return int(int16_t(uint16_t(v & 0xFFFF)));
+		}
+
+		inline uint32_t pack24(int index) {
+			assert(index < int(kNoIndex));
+			return index < 0 ? kNoIndex : uint32_t(index) & kNoIndex;
+		}
+
+		inline int unpack24(uint32_t v) {
+			v &= kNoIndex;
+			return v == kNoIndex ? -1 : int(v);
+		}
+	}
+
+	// A mask takes precedence over bounds, the two never share an object in what Canvas records.
+	inline PackedObject encode(RenderObject const& ro) {
+		using namespace detail;
+		uint32_t flags = ro.maskIndex < 0 && ro.boundsIndex >= 0 ? fAuxBounds : 0;
+		uint32_t brush = pack24(ro.brushIndex), pen = pack24(ro.penIndex), clip = pack24(ro.clipIndex);
+		uint32_t r1 = pack24(ro.r1), aux = pack24(flags & fAuxBounds ? ro.boundsIndex : ro.maskIndex);
+
+		PackedObject p;
+		p.words[0] = pack16(ro.x) | pack16(ro.y) << 16;
+		p.words[1] = pack16(ro.w) | pack16(ro.h) << 16;
+		p.words[2] = uint32_t(ro.type & 0xF) | flags << 4 | brush << 8;
+		p.words[3] = pen | (clip & 0xFF) << 24;
+		p.words[4] = clip >> 8 | (r1 & 0xFFFF) << 16;
+		p.words[5] = r1 >> 16 | aux << 8;
+		return p;
+	}
+
+	inline RenderObject decode(PackedObject const& p) {
+		using namespace detail;
+		RenderObject ro;
+		ro.x = unpack16(p.words[0]), ro.y = unpack16(p.words[0] >> 16);
+		ro.w = unpack16(p.words[1]), ro.h = unpack16(p.words[1] >> 16);
+		ro.type = int(p.words[2] & 0xF);
+		uint32_t flags = (p.words[2] >> 4) & 0xF;
+		ro.brushIndex = unpack24(p.words[2] >> 8);
+		ro.penIndex = unpack24(p.words[3]);
+		ro.clipIndex = unpack24(p.words[3] >> 24 | (p.words[4] & 0xFFFF) << 8);
+		ro.r1 = unpack24(p.words[4] >> 16 | (p.words[5] & 0xFF) << 16);
+		int aux = unpack24(p.words[5] >> 8);
+		ro.maskIndex = flags & fAuxBounds ? -1 : aux;
+		ro.boundsIndex = flags & fAuxBounds ? aux : -1;
+		ro.r2 = 0;
+		return ro;
+	}
+
+	inline void encode(RenderObject const* objects, size_t count, PackedObject* out) {
+		for (size_t i = 0; i < count; i++)
+			out[i] = encode(objects[i]);
+	}
+}
+
+#endif // UI_PACKED
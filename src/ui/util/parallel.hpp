@@ -0,0 +1,208 @@
+#ifndef UI_PARALLEL
+#define UI_PARALLEL
+
+#include <cstdint>
+#include <thread>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+
+namespace ui {
+	inline int hardware_threads() {
+		unsigned n = std::thread::hardware_concurrency();
+		return n == 0 ? 1 : int(n);
+	}
+
+	/*
+		Threads kept for parallel_for, so a job costs a wake up instead of a thread start. One job
+		runs at a time: run() returns false without running anything when another job holds the pool
+		or when it is called from one of the pool's own threads.
+
+		post() queues background tasks, decodes and the like, that nobody waits for. Idle threads take
+		them oldest first, a parallel_for job goes ahead of them when both are waiting.
+	*/
+	class WorkerPool {
+		std::vector<std::thread> threads_;
+		std::mutex mutex_;
+		std::condition_variable wake_, done_;
+		void (*job_)(void*) = nullptr;
+		void* context_ = nullptr;
+		std::deque<std::function<void()>> tasks_;
+		uint64_t generation_ = 0;
+		int wanted_ = 0, running_ = 0;
+		bool stop_ = false;
+		std::atomic<bool> busy_{ false };
+
+		static inline thread_local bool inPool_ = false;
+
+		void loop_() {
+			inPool_ = true;
+			uint64_t seen = 0;
+			std::unique_lock<std::mutex> lock(mutex_);
+			for (;;) {
+				wake_.wait(lock, [&] { return stop_ || (generation_ != seen && wanted_ > 0) || !tasks_.empty(); });
+				if (stop_)
+					return;
+				if (generation_ == seen || wanted_ == 0) {
+					auto task = std::move(tasks_.front());
+					tasks_.pop_front();
+					lock.unlock();
+					task();
+					lock.lock();
+					continue;
+				}
+				seen = generation_;
+				wanted_--, running_++;
+				auto job = job_;
+				void* context = context_;
+				lock.unlock();
+				job(context);
+				lock.lock();
+				if (--running_ == 0)
+					done_.notify_all();
+			}
+		}
+
+	public:
+		WorkerPool(int threads) {
+			for (int t = 0; t < threads; t++)
+				threads_.emplace_back([this] { loop_(); });
+		}
+
+		~WorkerPool() {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			wake_.notify_all();
+			for (auto& t : threads_)
+				t.join();
+		}
+
+		// Shared by every parallel_for, one thread fewer than the cores since the caller works too,
+		// but at least one so posted tasks still leave the calling thread.
+		static WorkerPool& shared() {
+			static WorkerPool pool((std::max)(hardware_threads() - 1, 1));
+			return pool;
+		}
+
+		int size() const { return int(threads_.size()); }
+
+		// Queues task for the next idle thread. Tasks still queued when the pool is destroyed are dropped.
+		void post(std::function<void()> task) {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				tasks_.push_back(std::move(task));
+			}
+			wake_.notify_one();
+		}
+
+		// Runs job(context) on the calling thread and on up to helpers pool threads, returning once
+		// all of them are done. Threads that wake after the caller has finished do not start it.
+		bool run(int helpers, void (*job)(void*), void* context) {
+			bool expected = false;
+			if (inPool_ || threads_.empty() || !busy_.compare_exchange_strong(expected, true))
+				return false;
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				job_ = job, context_ = context;
+				wanted_ = (std::min)(helpers, size());
+				generation_++;
+			}
+			wake_.notify_all();
+
+			job(context);
+
+			{
+				std::unique_lock<std::mutex> lock(mutex_);
+				wanted_ = 0;
+				done_.wait(lock, [&] { return running_ == 0; });
+				job_ = nullptr, context_ = nullptr;
+			}
+			busy_ = false;
+			return true;
+		}
+	};
+
+	/*
+		Callbacks other threads hand back to the UI thread, widgets are only touched there.
+		Backend::update runs them after the frame's events, in the order they were posted.
+	*/
+	class UiQueue {
+		std::mutex mutex_;
+		std::vector<std::function<void()>> pending_, running_;
+	public:
+		static UiQueue& shared() {
+			static UiQueue queue;
+			return queue;
+		}
+
+		void post(std::function<void()> f) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			pending_.push_back(std::move(f));
+		}
+
+		// Runs what was posted before the call, callbacks posting again run next time.
+		void run() {
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (pending_.empty())
+					return;
+				running_.swap(pending_);
+			}
+			for (auto& f : running_)
+				f();
+			running_.clear();
+		}
+	};
+
+	// Runs f(i) for every i in [begin, end) across the available cores, on the shared WorkerPool,
+	// or on threads of its own when the pool is taken.
+	// Work is handed out in chunks of 'grain' so small jobs stay on the calling thread.
+	template<typename F>
+	void parallel_for(int begin, int end, F&& f, int grain = 1) {
+		int count = end - begin;
+		if (count <= 0)
+			return;
+
+		grain = (std::max)(grain, 1);
+		int chunks = (count + grain - 1) / grain;
+		int workers = (std::min)(hardware_threads(), chunks);
+
+		if (workers <= 1) {
+			for (int i = begin; i < end; i++)
+				f(i);
+			return;
+		}
+
+		std::atomic<int> next{ 0 };
+		auto run = [&]() {
+			for (int c = next++; c < chunks; c = next++) {
+				int first = begin + c * grain;
+				int last = (std::min)(first + grain, end);
+				for (int i = first; i < last; i++)
+					f(i);
+			}
+		};
+
+		auto thunk = [](void* context) { (*static_cast<decltype(run)*>(context))(); };
+		if (WorkerPool::shared().run(workers - 1, thunk, &run))
+			return;
+
+		std::vector<std::thread> threads;
+		threads.reserve(workers - 1);
+		for (int t = 0; t < workers - 1; t++)
+			threads.emplace_back(run);
+
+		run();
+
+		for (auto& t : threads)
+			t.join();
+	}
+}
+
+#endif // UI_PARALLEL
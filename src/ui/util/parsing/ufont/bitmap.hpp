@@ -26,11 +26,11 @@ namespace uf::detail {
 		return (C.y - A.y) * (B.x - A.x) >= (B.y - A.y) * (C.x - A.x);
 		};
 
-	auto intersects_a = [&](detail::Coord A, detail::Coord B, detail::Coord C, detail::Coord D) {
+	auto intersects_a = [](detail::Coord A, detail::Coord B, detail::Coord C, detail::Coord D) {
 		return cccw(A, C, D) != cccw(B, C, D) && cccw(A, B, C) != cccw(A, B, D);
 		};
 
-	auto inside = [&](std::vector<std::vector<detail::Coord>> const& outline, detail::Coord point) {
+	auto inside = [](std::vector<std::vector<detail::Coord>> const& outline, detail::Coord point) {
 		int modCount = 0;
 		for (auto const& contour : outline) {
 			if (contour.empty())
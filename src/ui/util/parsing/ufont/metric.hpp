@@ -19,6 +19,7 @@
 #include "tbl_post.hpp"
 
 #include <cmath>
+#include <cfloat>
 #define NOMINMAX
 
 namespace uf::detail {
@@ -76,7 +77,20 @@ namespace uf::detail {
 			for(auto& contour : outline)
 				for(auto [cx, cy, offcurve] : contour)
 					x = smin(x, cx), y = smin(y, cy), x2 = smax(x2, cx), y2 = smax(y2, cy);
-			return std::tuple(x, y, ceil(x2 - x), ceil(y2 - y));
+			return std::tuple(x, y, std::ceil(x2 - x), std::ceil(y2 - y));
+		}
+
+		// Scaled metrics without the outline, for layout where only sizes are needed.
+		FontCharacter scale_metrics(float f) const {
+			FontCharacter temp{ xMin, yMax, xMax, yMin, lsb, rsb, adv };
+			temp.adv *= f;
+			temp.xMin *= f;
+			temp.yMax *= f;
+			temp.xMax *= f;
+			temp.yMin *= f;
+			temp.lsb *= f;
+			temp.rsb *= f;
+			return temp;
 		}
 
 		// font size / units per em
@@ -252,10 +266,10 @@ namespace uf::detail {
 		
 			
 
-			auto& const glyfA = glyf.glyphs[index];
+			auto const& glyfA = glyf.glyphs[index];
 
 		
-			auto& const hmtxA = hmtx.entries[index];
+			auto const& hmtxA = hmtx.entries[index];
 			
 			// Glyph Bounding Box
 			glyph.xMin = glyfA.xMin;
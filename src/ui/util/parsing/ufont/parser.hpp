@@ -26,7 +26,7 @@ namespace uf::detail {
 			fsize = stream.tellg() - fsize;
 			stream.seekg(0);
 
-			buffer = std::vector<unsigned char>(fsize, unsigned char{});
+			buffer = std::vector<unsigned char>(fsize, (unsigned char)0);
 			stream.read(reinterpret_cast<char*>(buffer.data()), fsize);
 			size = buffer.size();
 		}
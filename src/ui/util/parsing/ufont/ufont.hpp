@@ -142,6 +142,8 @@ namespace uf {
 	static Metric gMetric;
 	static std::unordered_map<char, Character> gCharacters;
 	static Atlas gAtlas;
+	static bool gLoaded = false;
+	static std::unordered_map<int, std::unordered_map<std::string, std::pair<int, int>>> gTextSizes; // per font size, see CachedTextSize
 
 	auto load_atlas(uf::Metric const& metric, std::unordered_map<char, uf::Character> const& characters, int height) {
 
@@ -172,10 +174,21 @@ namespace uf {
 		return std::move(atlas);
 	}
 
-	void LoadGlobal(std::string const& s = "C:/Windows/Fonts/calibri.ttf", int size = 48) {
+	// Parse and rasterize are split so startup can overlap the parse with other loading.
+	void LoadMetricGlobal(std::string const& s = "C:/Windows/Fonts/calibri.ttf") {
 		gMetric = load_metric(s);
+		gTextSizes.clear();
 		gCharacters = load_characters(gMetric, "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789!@#$%^&*()_+-=[]{}\\|;:'\",.<>/?`~ ");
+	}
+
+	void LoadAtlasGlobal(int size = 48) {
 		gAtlas = load_atlas(gMetric, gCharacters, size);
+		gLoaded = true;
+	}
+
+	void LoadGlobal(std::string const& s = "C:/Windows/Fonts/calibri.ttf", int size = 48) {
+		LoadMetricGlobal(s);
+		LoadAtlasGlobal(size);
 	}
 
 
@@ -186,7 +199,7 @@ namespace uf {
 		for (int i = 0; i < cursorPos; i++) {
 			if (gCharacters.count(s[i]) == 0)
 				continue;
-			auto ch = gCharacters[s[i]].scale((float)size / (float)gMetric.unitsPerEm);
+			auto ch = gCharacters[s[i]].scale_metrics((float)size / (float)gMetric.unitsPerEm);
 			offset += ch.advance();
 		}
 		return offset;
@@ -199,7 +212,7 @@ namespace uf {
 			if (gCharacters.count(c) == 0)
 				continue;
 
-			auto ch = gCharacters[c].scale((float) size / (float) gMetric.unitsPerEm);
+			auto ch = gCharacters[c].scale_metrics((float) size / (float) gMetric.unitsPerEm);
 			textW += ch.advance();
 			textH = ch.height() > textH ? ch.height() : textH;
 		};
@@ -207,6 +220,20 @@ namespace uf {
 		return { textW, textH };
 	}
 
+	// TextSize memoized per string and font size, for layouts measuring the same text every pass.
+	// Starts over once a size holds kTextSizeEntries strings, and when a font is loaded.
+	constexpr size_t kTextSizeEntries = 16384;
+
+	std::pair<int, int> CachedTextSize(std::string const& s, int size) {
+		auto& sizes = gTextSizes[size];
+		auto it = sizes.find(s);
+		if (it != sizes.end())
+			return it->second;
+		if (sizes.size() >= kTextSizeEntries)
+			sizes.clear();
+		return sizes[s] = TextSize(s, size);
+	}
+
     class TextModel {
         int letter_spacing = 0;
         int word_spacing = 0;
@@ -255,7 +282,7 @@ namespace uf {
 			int xOffset = 0, yOffset = 0;
 			int largestW = 0, totalHeight = 0;
 			for (auto c : text) {
-				auto ch = gCharacters[c].scale(scale);
+				auto ch = gCharacters[c].scale_metrics(scale);
 
 				if (c == ' ') {
 					characters_.push_back(CharQuad{ x + xOffset, y + yOffset - ch.bearingV(), 0, 0 });
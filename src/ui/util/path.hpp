@@ -0,0 +1,680 @@
+#ifndef UI_PATH
+#define UI_PATH
+
+#include "misc.hpp"
+#include "pyramid.hpp"
+
+#include <cstdint>
+#include <cmath>
+#include <atomic>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <algorithm>
+
+namespace ui {
+	enum eJoin { eMiterJoin, eRoundJoin, eBevelJoin };
+	enum eCap { eButtCap, eRoundCap, eSquareCap };
+	enum eFillRule { eNonZero, eEvenOdd };
+
+	struct PathStyle {
+		eJoin join = eMiterJoin;
+		eCap cap = eButtCap;
+		float miterLimit = 4.0f; // miter length over half the width, longer miters are bevelled
+		eFillRule rule = eNonZero;
+	};
+
+	// One flattened subpath, x y pairs in device pixels.
+	struct Polyline {
+		std::vector<float> xy;
+		bool closed = false;
+
+		int size() const { return int(xy.size() / 2); }
+	};
+
+	/*
+		Outline built from move, line, quad, cubic and close commands, in its own units. Every path
+		has an id and a version that changes with each command, together they are its identity in
+		PathCache. Copies get a new id, moves take it along.
+	*/
+	class Path {
+	public:
+		enum eVerb : uint8_t { eMove, eLine, eQuad, eCubic, eClose };
+
+		Path() : id_(next_()) {}
+		Path(Path const& o) : verbs_(o.verbs_), points_(o.points_), id_(next_()) {}
+		Path(Path&& o) noexcept : verbs_(std::move(o.verbs_)), points_(std::move(o.points_)), id_(o.id_), version_(o.version_) {
+			o.id_ = next_(), o.version_ = 0;
+		}
+
+		Path& operator=(Path const& o) {
+			if (this != &o)
+				verbs_ = o.verbs_, points_ = o.points_, id_ = next_(), version_ = 0;
+			return *this;
+		}
+
+		Path& operator=(Path&& o) noexcept {
+			if (this != &o) {
+				verbs_ = std::move(o.verbs_), points_ = std::move(o.points_), id_ = o.id_, version_ = o.version_;
+				o.id_ = next_(), o.version_ = 0;
+			}
+			return *this;
+		}
+
+		Path& moveTo(float x, float y) { return add_(eMove, { x, y }); }
+		Path& lineTo(float x, float y) { return add_(eLine, { x, y }); }
+		Path& quadTo(float cx, float cy, float x, float y) { return add_(eQuad, { cx, cy, x, y }); }
+		Path& cubicTo(float c1x, float c1y, float c2x, float c2y, float x, float y) { return add_(eCubic, { c1x, c1y, c2x, c2y, x, y }); }
+		Path& close() { return add_(eClose, {}); }
+
+		void clear() {
+			verbs_.clear(), points_.clear();
+			version_++;
+		}
+
+		bool empty() const { return verbs_.empty(); }
+		uint64_t id() const { return id_; }
+		uint64_t version() const { return version_; }
+
+		// Subpaths scaled to device pixels, curves cut into segments that stay within tolerance pixels
+		// of them. A path that does not start with moveTo starts at 0, 0.
+		void flatten(float scale, float tolerance, std::vector<Polyline>& out) const {
+			out.clear();
+			float cx = 0, cy = 0, sx = 0, sy = 0;
+			bool open = false;
+			auto start = [&](float x, float y) {
+				out.push_back({ { x, y }, false });
+				sx = cx = x, sy = cy = y;
+				open = true;
+			};
+			auto to = [&](float x, float y) {
+				if (!open)
+					start(cx, cy);
+				out.back().xy.push_back(x), out.back().xy.push_back(y);
+				cx = x, cy = y;
+			};
+
+			float const* p = points_.data();
+			for (auto v : verbs_) {
+				switch (v) {
+				case eMove:
+					start(p[0] * scale, p[1] * scale);
+					p += 2;
+					break;
+				case eLine:
+					to(p[0] * scale, p[1] * scale);
+					p += 2;
+					break;
+				case eQuad: {
+					// the chords of n even steps stay within |p0 - 2p1 + p2| / (4 n^2) of the curve
+					float x0 = cx, y0 = cy, x1 = p[0] * scale, y1 = p[1] * scale, x2 = p[2] * scale, y2 = p[3] * scale;
+					int n = steps_(std::hypot(x0 - 2 * x1 + x2, y0 - 2 * y1 + y2) * 0.25f, tolerance);
+					for (int i = 1; i <= n; i++) {
+						float t = float(i) / n, u = 1 - t;
+						to(u * u * x0 + 2 * u * t * x1 + t * t * x2, u * u * y0 + 2 * u * t * y1 + t * t * y2);
+					}
+					p += 4;
+					break;
+				}
+				case eCubic: {
+					// and those of a cubic within 3/4 of its larger second difference over n^2
+					float x0 = cx, y0 = cy, x1 = p[0] * scale, y1 = p[1] * scale, x2 = p[2] * scale, y2 = p[3] * scale, x3 = p[4] * scale, y3 = p[5] * scale;
+					float dd = (std::max)(std::hypot(x0 - 2 * x1 + x2, y0 - 2 * y1 + y2), std::hypot(x1 - 2 * x2 + x3, y1 - 2 * y2 + y3));
+					int n = steps_(dd * 0.75f, tolerance);
+					for (int i = 1; i <= n; i++) {
+						float t = float(i) / n, u = 1 - t;
+						float a = u * u * u, b = 3 * u * u * t, c = 3 * u * t * t, d = t * t * t;
+						to(a * x0 + b * x1 + c * x2 + d * x3, a * y0 + b * y1 + c * y2 + d * y3);
+					}
+					p += 6;
+					break;
+				}
+				case eClose:
+					if (open)
+						out.back().closed = true;
+					open = false;
+					cx = sx, cy = sy;
+					break;
+				}
+			}
+		}
+
+	private:
+		std::vector<uint8_t> verbs_;
+		std::vector<float> points_;
+		uint64_t id_, version_ = 0;
+
+		static uint64_t next_() {
+			static std::atomic<uint64_t> counter{ 1 };
+			return counter++;
+		}
+
+		Path& add_(eVerb v, std::initializer_list<float> p) {
+			verbs_.push_back(v);
+			points_.insert(points_.end(), p);
+			version_++;
+			return *this;
+		}
+
+		static int steps_(float error, float tolerance) {
+			return std::clamp(int(std::ceil(std::sqrt(error / tolerance))), 1, 256);
+		}
+	};
+
+	// Edge of a filled outline, top to bottom, winding +1 where it ran downwards.
+	struct PathEdge {
+		float x0, y0, x1, y1;
+		int winding;
+	};
+
+	class EdgeList {
+	public:
+		std::vector<PathEdge> edges;
+		float x0 = 1e30f, y0 = 1e30f, x1 = -1e30f, y1 = -1e30f;
+
+		void clear() {
+			edges.clear();
+			x0 = y0 = 1e30f, x1 = y1 = -1e30f;
+		}
+
+		// Closed polygon of n points. Stroke pieces pass uniform so they all wind the same way and a
+		// nonzero fill unions them.
+		void polygon(float const* xy, int n, bool uniform = false) {
+			if (n < 3)
+				return;
+			int flip = 1;
+			if (uniform) {
+				float area = 0;
+				for (int i = 0, j = n - 1; i < n; j = i++)
+					area += xy[2 * j] * xy[2 * i + 1] - xy[2 * i] * xy[2 * j + 1];
+				flip = area < 0 ? -1 : 1;
+			}
+			for (int i = 0, j = n - 1; i < n; j = i++)
+				edge_(xy[2 * j], xy[2 * j + 1], xy[2 * i], xy[2 * i + 1], flip);
+		}
+
+	private:
+		void edge_(float ax, float ay, float bx, float by, int flip) {
+			x0 = (std::min)({ x0, ax, bx }), x1 = (std::max)({ x1, ax, bx });
+			y0 = (std::min)({ y0, ay, by }), y1 = (std::max)({ y1, ay, by });
+			if (ay == by)
+				return;
+			if (ay < by)
+				edges.push_back({ ax, ay, bx, by, flip });
+			else
+				edges.push_back({ bx, by, ax, ay, -flip });
+		}
+	};
+
+	// Polygon of a circle whose chords stay within tolerance of it.
+	inline void circle_polygon(float cx, float cy, float r, float tolerance, std::vector<float>& out) {
+		int n = r > tolerance ? int(std::ceil(3.14159265f / std::acos(1.0f - tolerance / r))) : 8;
+		n = std::clamp(n, 8, 256);
+		out.clear();
+		for (int i = 0; i < n; i++) {
+			float a = 6.28318531f * i / n;
+			out.push_back(cx + r * std::cos(a)), out.push_back(cy + r * std::sin(a));
+		}
+	}
+
+	/*
+		Outline of the stroke of each polyline, halfWidth either side of it, as one quad per segment
+		plus a polygon per join and cap. The pieces overlap and are all wound the same way, filled
+		nonzero they union without seams. A round join or cap is a whole circle at the point.
+	*/
+	inline void stroke_outline(std::vector<Polyline> const& lines, float halfWidth, PathStyle const& style, float tolerance, EdgeList& out) {
+		if (halfWidth <= 0)
+			return;
+		float hw = halfWidth;
+		std::vector<float> pts, circle;
+
+		auto round = [&](float x, float y) {
+			circle_polygon(x, y, hw, tolerance, circle);
+			out.polygon(circle.data(), int(circle.size() / 2), true);
+		};
+
+		// d is the direction leaving the end, away from the line
+		auto cap = [&](float x, float y, float dx, float dy) {
+			if (style.cap == eRoundCap) {
+				round(x, y);
+			}
+			else if (style.cap == eSquareCap) {
+				float nx = -dy * hw, ny = dx * hw, ex = dx * hw, ey = dy * hw;
+				float q[8] = { x + nx, y + ny, x + nx + ex, y + ny + ey, x - nx + ex, y - ny + ey, x - nx, y - ny };
+				out.polygon(q, 4, true);
+			}
+		};
+
+		for (auto const& line : lines) {
+			// drop repeated points, they have no direction
+			pts.clear();
+			for (int i = 0; i < line.size(); i++) {
+				float x = line.xy[2 * i], y = line.xy[2 * i + 1];
+				if (pts.empty() || std::abs(x - pts[pts.size() - 2]) > 1e-4f || std::abs(y - pts.back()) > 1e-4f)
+					pts.push_back(x), pts.push_back(y);
+			}
+			int n = int(pts.size() / 2);
+			bool closed = line.closed && n > 2;
+			if (closed && std::abs(pts[0] - pts[2 * n - 2]) <= 1e-4f && std::abs(pts[1] - pts[2 * n - 1]) <= 1e-4f)
+				n--;
+
+			if (n == 1) {
+				if (style.cap == eRoundCap)
+					round(pts[0], pts[1]);
+				else if (style.cap == eSquareCap)
+					cap(pts[0], pts[1], 1, 0), cap(pts[0], pts[1], -1, 0);
+				continue;
+			}
+
+			int segments = closed ? n : n - 1;
+			auto dir = [&](int s, float& dx, float& dy) {
+				int a = s % n, b = (s + 1) % n;
+				dx = pts[2 * b] - pts[2 * a], dy = pts[2 * b + 1] - pts[2 * a + 1];
+				float len = std::hypot(dx, dy);
+				dx /= len, dy /= len;
+			};
+
+			for (int s = 0; s < segments; s++) {
+				int a = s % n, b = (s + 1) % n;
+				float dx, dy;
+				dir(s, dx, dy);
+				float nx = -dy * hw, ny = dx * hw;
+				float q[8] = { pts[2 * a] + nx, pts[2 * a + 1] + ny, pts[2 * b] + nx, pts[2 * b + 1] + ny,
+					pts[2 * b] - nx, pts[2 * b + 1] - ny, pts[2 * a] - nx, pts[2 * a + 1] - ny };
+				out.polygon(q, 4, true);
+			}
+
+			for (int v = closed ? 0 : 1; v < (closed ? n : n - 1); v++) {
+				float px = pts[2 * v], py = pts[2 * v + 1];
+				if (style.join == eRoundJoin) {
+					round(px, py);
+					continue;
+				}
+
+				float d0x, d0y, d1x, d1y;
+				dir((v + n - 1) % n, d0x, d0y);
+				dir(v, d1x, d1y);
+				float cross = d0x * d1y - d0y * d1x;
+				if (std::abs(cross) < 1e-6f)
+					continue;
+
+				// the outer side is the one the line turns away from
+				float s = cross > 0 ? -hw : hw;
+				float n0x = -d0y, n0y = d0x, n1x = -d1y, n1y = d1x;
+				float ax = px + s * n0x, ay = py + s * n0y, bx = px + s * n1x, by = py + s * n1y;
+
+				float mx = n0x + n1x, my = n0y + n1y, mm = mx * mx + my * my;
+				if (style.join == eMiterJoin && mm > 1e-12f && 2.0f / std::sqrt(mm) <= style.miterLimit) {
+					// the miter tip is hw / cos(half the angle) out along the bisector
+					float k = 2.0f * s / mm;
+					float q[8] = { px, py, ax, ay, px + mx * k, py + my * k, bx, by };
+					out.polygon(q, 4, true);
+				}
+				else {
+					float q[6] = { px, py, ax, ay, bx, by };
+					out.polygon(q, 3, true);
+				}
+			}
+
+			if (!closed) {
+				float dx, dy;
+				dir(0, dx, dy);
+				cap(pts[0], pts[1], -dx, -dy);
+				dir(segments - 1, dx, dy);
+				cap(pts[2 * n - 2], pts[2 * n - 1], dx, dy);
+			}
+		}
+	}
+
+	/*
+		Anti-aliased coverage of the edges over the w x h pixels at ox, oy, one byte per pixel. Each
+		pixel row is sampled on kPathSamples scanlines, horizontally the coverage of every span is
+		exact, so near vertical edges get the full 256 levels.
+	*/
+	constexpr int kPathSamples = 8;
+
+	inline void fill_coverage(std::vector<PathEdge>& edges, int ox, int oy, int w, int h, eFillRule rule, uint8_t* out) {
+		std::sort(edges.begin(), edges.end(), [](PathEdge const& a, PathEdge const& b) { return a.y0 < b.y0; });
+
+		std::vector<float> row(size_t(w) + 1), run(size_t(w) + 1);
+		std::vector<PathEdge const*> active;
+		std::vector<std::pair<float, int>> crossings;
+		size_t next = 0;
+		float weight = 1.0f / kPathSamples;
+
+		auto span = [&](float a, float b) {
+			a = std::clamp(a, 0.0f, float(w)), b = std::clamp(b, 0.0f, float(w));
+			if (b <= a)
+				return;
+			int ia = int(a), ib = int(b);
+			if (ia == ib) {
+				row[ia] += (b - a) * weight;
+				return;
+			}
+			row[ia] += (ia + 1 - a) * weight;
+			run[ia + 1] += weight, run[ib] -= weight;
+			row[ib] += (b - ib) * weight;
+		};
+
+		for (int y = 0; y < h; y++) {
+			std::fill(row.begin(), row.end(), 0.0f);
+			std::fill(run.begin(), run.end(), 0.0f);
+			for (int s = 0; s < kPathSamples; s++) {
+				float sy = oy + y + (s + 0.5f) * weight;
+				while (next < edges.size() && edges[next].y0 <= sy)
+					active.push_back(&edges[next++]);
+				active.erase(std::remove_if(active.begin(), active.end(), [&](PathEdge const* e) { return e->y1 <= sy; }), active.end());
+
+				crossings.clear();
+				for (auto e : active)
+					crossings.push_back({ e->x0 + (sy - e->y0) * (e->x1 - e->x0) / (e->y1 - e->y0) - ox, e->winding });
+				std::sort(crossings.begin(), crossings.end());
+
+				int winding = 0;
+				float start = 0;
+				for (auto const& [x, dw] : crossings) {
+					bool was = rule == eEvenOdd ? (winding & 1) != 0 : winding != 0;
+					winding += dw;
+					bool is = rule == eEvenOdd ? (winding & 1) != 0 : winding != 0;
+					if (is && !was)
+						start = x;
+					else if (was && !is)
+						span(start, x);
+				}
+			}
+
+			float acc = 0;
+			uint8_t* o = out + size_t(y) * w;
+			for (int x = 0; x < w; x++) {
+				acc += run[x];
+				o[x] = uint8_t((std::min)(row[x] + acc, 1.0f) * 255.0f + 0.5f);
+			}
+		}
+	}
+
+	/*
+		Rendered paths for Canvas::path, keyed by path identity (id and version), scale, style and
+		paint colours, so a path that does not change is flattened and filled once.
+
+		The path is filled with the fill colour and stroked over with the stroke colour into an RGBA
+		image covering its pixel bounds. One up to kWhole pixels square is kept whole, larger ones are
+		cut into kCell squares: empty cells are dropped and cells of one colour become solid rects,
+		so a long graph edge or a big filled shape keeps only the texels along its outline. The
+		remaining pieces are packed on shelves into sheets, tileSize squares that only ever grow and
+		are placed in the tile page whole. Adding to a placed sheet rewrites its slot in place, every
+		region handed out earlier stays valid. When all sheets are full the least recently used is
+		emptied and its paths dropped, its key changes so display lists that still point at it re-record.
+	*/
+	class PathCache {
+	public:
+		static constexpr int kWhole = 64, kCell = 32, kMaxSheets = 16, kMaxExtent = 4096;
+		static constexpr size_t kMaxEntries = 16384;
+		static constexpr float kTolerance = 0.1f;
+
+		// A part of a rendered path, sheet -1 for a solid rect of color.
+		struct Piece {
+			int dx, dy, w, h;
+			int sheet, sx, sy;
+			uint32_t color;
+		};
+
+		// Pixel offset of the bounds from the path origin, and the pieces ordered by sheet.
+		struct Shape {
+			int x = 0, y = 0;
+			std::vector<Piece> pieces;
+		};
+
+		// fill and stroke are packed colours, alpha 0 leaves that part out. width is the stroke width
+		// at scale 1. Nothing when the path is empty or a piece finds no room in the sheets.
+		Shape const* get(Path const& path, float scale, PathStyle const& style, uint32_t fill, uint32_t stroke, float width, TilePage& page) {
+			Key key{ path.id(), path.version(), fill, stroke & 0xFF ? stroke : 0, int(std::lround(scale * 1024)), int(std::lround(width * 64)),
+				int(std::lround(style.miterLimit * 64)), uint8_t(style.join), uint8_t(style.cap), uint8_t(style.rule) };
+			if (!(stroke & 0xFF))
+				key.width = 0;
+
+			tick_++;
+			auto it = entries_.find(key);
+			if (it != entries_.end()) {
+				touch_(it->second);
+				return &it->second;
+			}
+
+			if (entries_.size() >= kMaxEntries)
+				reset();
+			if (page.tileSize() < kWhole + 1)
+				return nullptr;
+
+			Shape shape;
+			if (!render_(path, key, shape, page))
+				return nullptr;
+			renders_++;
+			auto& stored = entries_[key] = std::move(shape);
+			return &stored;
+		}
+
+		// The tile page key of a sheet, the top three bits tag path sheets in the shared page.
+		uint64_t sheetKey(int sheet) const {
+			return 7ull << 61 | uint64_t(sheet) << 32 | sheets_[sheet]->version;
+		}
+
+		Tile const& sheet(int sheet) const { return sheets_[sheet]->tile; }
+
+		// Drops every path and empties the sheets.
+		void reset() {
+			entries_.clear();
+			for (auto& s : sheets_)
+				empty_(*s);
+		}
+
+		size_t renders() const { return renders_; }
+		size_t size() const { return entries_.size(); }
+
+	private:
+		struct Key {
+			uint64_t id, version;
+			uint32_t fill, stroke;
+			int scale, width, miter;
+			uint8_t join, cap, rule;
+
+			bool operator==(Key const& o) const {
+				return id == o.id && version == o.version && fill == o.fill && stroke == o.stroke && scale == o.scale && width == o.width
+					&& miter == o.miter && join == o.join && cap == o.cap && rule == o.rule;
+			}
+		};
+
+		struct KeyHash {
+			size_t operator()(Key const& k) const {
+				uint64_t h = k.id * 0x9E3779B97F4A7C15ull;
+				for (uint64_t v : { k.version, uint64_t(k.fill) << 32 | k.stroke, uint64_t(uint32_t(k.scale)) << 32 | uint32_t(k.width),
+					uint64_t(uint32_t(k.miter)) << 24 | uint64_t(k.join) << 16 | uint64_t(k.cap) << 8 | k.rule })
+					h = (h ^ v) * 0xFF51AFD7ED558CCDull;
+				return size_t(h ^ (h >> 32));
+			}
+		};
+
+		struct Shelf {
+			int y, h, x;
+		};
+
+		struct Sheet {
+			Tile tile;
+			uint32_t version = 0;
+			uint64_t used = 0;
+			int top = 0;
+			std::vector<Shelf> shelves;
+			std::vector<Key> keys;
+		};
+
+		std::unordered_map<Key, Shape, KeyHash> entries_;
+		std::vector<std::unique_ptr<Sheet>> sheets_;
+		std::vector<Polyline> lines_;
+		EdgeList fillEdges_, strokeEdges_;
+		std::vector<uint8_t> fillCoverage_, strokeCoverage_, rgba_;
+		uint64_t tick_ = 0;
+		size_t renders_ = 0;
+
+		void touch_(Shape const& shape) {
+			for (auto const& p : shape.pieces)
+				if (p.sheet >= 0)
+					sheets_[p.sheet]->used = tick_;
+		}
+
+		void empty_(Sheet& s) {
+			s.version++, s.top = 0, s.keys.clear(), s.shelves.clear();
+			std::fill(s.tile.rgba.begin(), s.tile.rgba.end(), 0);
+		}
+
+		bool render_(Path const& path, Key const& key, Shape& shape, TilePage& page) {
+			float scale = key.scale / 1024.0f;
+			path.flatten(scale, kTolerance, lines_);
+
+			fillEdges_.clear(), strokeEdges_.clear();
+			if (key.fill & 0xFF)
+				for (auto const& l : lines_)
+					fillEdges_.polygon(l.xy.data(), l.size());
+			if (key.width > 0) {
+				PathStyle style{ eJoin(key.join), eCap(key.cap), key.miter / 64.0f, eFillRule(key.rule) };
+				stroke_outline(lines_, key.width / 64.0f * scale * 0.5f, style, kTolerance, strokeEdges_);
+			}
+			if (fillEdges_.edges.empty() && strokeEdges_.edges.empty())
+				return true;
+
+			float bx0 = (std::min)(fillEdges_.x0, strokeEdges_.x0), by0 = (std::min)(fillEdges_.y0, strokeEdges_.y0);
+			float bx1 = (std::max)(fillEdges_.x1, strokeEdges_.x1), by1 = (std::max)(fillEdges_.y1, strokeEdges_.y1);
+			int ox = int(std::floor(std::clamp(bx0, -float(kMaxExtent), float(kMaxExtent))));
+			int oy = int(std::floor(std::clamp(by0, -float(kMaxExtent), float(kMaxExtent))));
+			int w = int(std::ceil(std::clamp(bx1, -float(kMaxExtent), float(kMaxExtent)))) - ox;
+			int h = int(std::ceil(std::clamp(by1, -float(kMaxExtent), float(kMaxExtent)))) - oy;
+			if (w <= 0 || h <= 0)
+				return true;
+			shape.x = ox, shape.y = oy;
+
+			size_t n = size_t(w) * h;
+			fillCoverage_.assign(n, 0), strokeCoverage_.assign(n, 0);
+			if (!fillEdges_.edges.empty())
+				fill_coverage(fillEdges_.edges, ox, oy, w, h, eFillRule(key.rule), fillCoverage_.data());
+			if (!strokeEdges_.edges.empty())
+				fill_coverage(strokeEdges_.edges, ox, oy, w, h, eNonZero, strokeCoverage_.data());
+
+			// stroke over fill, straight alpha
+			color f(key.fill), s(key.stroke);
+			rgba_.resize(n * 4);
+			for (size_t i = 0; i < n; i++) {
+				int fa = fillCoverage_[i] * f.a, sa = strokeCoverage_[i] * s.a; // alpha * 255
+				int a = sa + fa - sa * fa / 65025;
+				uint8_t* o = rgba_.data() + i * 4;
+				if (a == 0) {
+					o[0] = o[1] = o[2] = o[3] = 0;
+					continue;
+				}
+				int fw = fa - sa * fa / 65025;
+				for (int c = 0; c < 3; c++)
+					o[c] = uint8_t((s.rgba[c] * sa + f.rgba[c] * fw + a / 2) / a);
+				o[3] = uint8_t((a + 127) / 255);
+			}
+
+			if (w <= kWhole && h <= kWhole)
+				return piece_(key, shape, 0, 0, w, h, w, page);
+			for (int cy = 0; cy < h; cy += kCell) {
+				for (int cx = 0; cx < w; cx += kCell) {
+					int cw = (std::min)(kCell, w - cx), ch = (std::min)(kCell, h - cy);
+					if (!piece_(key, shape, cx, cy, cw, ch, w, page))
+						return false;
+				}
+			}
+
+			// solid cells next to each other in a row draw as one rect
+			std::vector<Piece> merged;
+			for (auto const& p : shape.pieces) {
+				Piece* b = merged.empty() ? nullptr : &merged.back();
+				if (b && p.sheet < 0 && b->sheet < 0 && b->color == p.color && b->dy == p.dy && b->h == p.h && b->dx + b->w == p.dx)
+					b->w += p.w;
+				else
+					merged.push_back(p);
+			}
+			std::stable_sort(merged.begin(), merged.end(), [](Piece const& a, Piece const& b) { return a.sheet < b.sheet; });
+			shape.pieces.swap(merged);
+			return true;
+		}
+
+		// Adds the w x h pixels at x, y of the rendered image to the shape, false when no sheet has room.
+		bool piece_(Key const& key, Shape& shape, int x, int y, int w, int h, int stride, TilePage& page) {
+			auto texel = [&](int i, int j) { return rgba_.data() + (size_t(y + j) * stride + x + i) * 4; };
+
+			uint8_t const* first = texel(0, 0);
+			bool uniform = true;
+			for (int j = 0; j < h && uniform; j++)
+				for (int i = 0; i < w && uniform; i++)
+					uniform = std::memcmp(texel(i, j), first, 4) == 0;
+			if (uniform) {
+				if (first[3])
+					shape.pieces.push_back({ x, y, w, h, -1, 0, 0, uint32_t(color(first[0], first[1], first[2], first[3]).pack()) });
+				return true;
+			}
+
+			// one texel of gutter keeps neighbours out of filtered samples
+			int sx = 0, sy = 0, sheet = allocate_(w + 1, h + 1, page.tileSize(), sx, sy);
+			if (sheet < 0)
+				return false;
+			auto& s = *sheets_[sheet];
+			for (int j = 0; j < h; j++)
+				std::memcpy(s.tile.rgba.data() + (size_t(sy + j) * s.tile.w + sx) * 4, texel(0, j), size_t(w) * 4);
+			if (s.keys.empty() || !(s.keys.back() == key))
+				s.keys.push_back(key);
+			page.update(sheetKey(sheet), s.tile, { sx, sy, w, h });
+			shape.pieces.push_back({ x, y, w, h, sheet, sx, sy, 0 });
+			return true;
+		}
+
+		// A sheet with a free w x h area at x, y: on the first shelf that fits it without wasting more
+		// than half its height, else on a new shelf, else in a new or emptied sheet. -1 when none is.
+		int allocate_(int w, int h, int size, int& x, int& y) {
+			auto fit = [&](Sheet& s) {
+				for (auto& sh : s.shelves) {
+					if (sh.h >= h && sh.h <= h * 2 && sh.x + w <= size) {
+						x = sh.x, y = sh.y, sh.x += w;
+						return true;
+					}
+				}
+				if (s.top + h > size || w > size)
+					return false;
+				s.shelves.push_back({ s.top, h, w });
+				x = 0, y = s.top, s.top += h;
+				return true;
+			};
+
+			for (int i = 0; i < int(sheets_.size()); i++) {
+				if (fit(*sheets_[i])) {
+					sheets_[i]->used = tick_;
+					return i;
+				}
+			}
+
+			int victim = -1;
+			if (int(sheets_.size()) < kMaxSheets) {
+				auto s = std::make_unique<Sheet>();
+				s->tile.w = s->tile.h = size;
+				s->tile.rgba.assign(size_t(size) * size * 4, 0);
+				sheets_.push_back(std::move(s));
+				victim = int(sheets_.size()) - 1;
+			}
+			else {
+				// never one the path being rendered already has pieces in
+				for (int i = 0; i < int(sheets_.size()); i++)
+					if (sheets_[i]->used != tick_ && (victim < 0 || sheets_[i]->used < sheets_[victim]->used))
+						victim = i;
+				if (victim < 0)
+					return -1;
+				for (auto const& k : sheets_[victim]->keys)
+					entries_.erase(k);
+				empty_(*sheets_[victim]);
+			}
+			if (!fit(*sheets_[victim]))
+				return -1;
+			sheets_[victim]->used = tick_;
+			return victim;
+		}
+	};
+}
+
+#endif // UI_PATH
@@ -0,0 +1,76 @@
+#ifndef UI_PLATFORM
+#define UI_PLATFORM
+
+// Win32 unless UI_HEADLESS is defined, every other system gets the headless windows.
+#if defined(_WIN32) && !defined(UI_HEADLESS)
+#define UI_PLATFORM_WIN32
+#include <Windows.h>
+#else
+#define UI_PLATFORM_HEADLESS
+#endif
+
+#include <array>
+#include <chrono>
+
+namespace ui {
+#ifdef UI_PLATFORM_WIN32
+	using Surface = HDC;
+#else
+	using Surface = void*; // headless windows have nothing to present to
+#endif
+
+	enum eNativeType {
+		fPersistent,
+		fTransient
+	};
+
+	// Key codes for modifiers, the Win32 virtual key values so both platforms agree.
+	enum eKeyCode {
+		kShift = 0x10,
+		kControl = 0x11,
+		kAlt = 0x12
+	};
+
+	namespace platform {
+		// held keys of the headless platform, set as injected key events are translated
+		inline std::array<bool, 256> gKeys{};
+
+		inline bool keyDown(int key) {
+#ifdef UI_PLATFORM_WIN32
+			return (GetKeyState(key) & 0x8000) != 0;
+#else
+			return gKeys[key & 0xFF];
+#endif
+		}
+
+		inline void setKeyDown(int key, bool down) {
+			gKeys[key & 0xFF] = down;
+		}
+	}
+
+	// Monotonic seconds since construction. A manual clock only moves through advance(), so
+	// headless runs see the same times on every run.
+	class Clock {
+		std::chrono::steady_clock::time_point start_ = std::chrono::steady_clock::now();
+		double manual_ = 0.0;
+		bool isManual_ = false;
+	public:
+		double now() const {
+			if (isManual_)
+				return manual_;
+			return std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+		}
+
+		void setManual(bool b) {
+			if (b && !isManual_)
+				manual_ = now();
+			isManual_ = b;
+		}
+
+		void advance(double seconds) { manual_ += seconds; }
+		void set(double seconds) { manual_ = seconds; }
+		bool manual() const { return isManual_; }
+	};
+}
+
+#endif // UI_PLATFORM
@@ -0,0 +1,478 @@
+#ifndef UI_PYRAMID
+#define UI_PYRAMID
+
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <array>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <fstream>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include <limits>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UI_PYRAMID_SSE2
+#endif
+
+namespace ui {
+	/*
+		Tiled image pyramid for images too large for the startup ImageAtlas.
+
+		TileSource  - streams level 0 tiles from a decoder
+		TiledImage  - builds coarser levels on demand by 2x2 downsampling, cached in an LruCache,
+		              either blocking (tile, prefetch) or on the shared WorkerPool (request)
+		TilePage    - fixed grid of GPU slots the visible tiles are copied into, reused frame to frame
+
+		Every tile is RGBA8 and at most tileSize x tileSize, edge tiles are smaller.
+	*/
+	struct Tile {
+		int w = 0, h = 0;
+		std::vector<uint8_t> rgba;
+
+		size_t bytes() const { return rgba.size(); }
+	};
+
+	// Averages 2x2 blocks of an RGBA image as (a + b + c + d + 2) >> 2, the last row/column is
+	// replicated for odd sizes. The SSE2 path widens to 16 bits and matches the scalar one exactly.
+	inline void downsample_2x2(uint8_t const* src, int sw, int sh, int srcStride, uint8_t* dst, int dstStride) {
+		int dw = (sw + 1) / 2, dh = (sh + 1) / 2;
+
+		for (int y = 0; y < dh; y++) {
+			uint8_t const* r0 = src + size_t(2 * y) * srcStride;
+			uint8_t const* r1 = src + size_t((std::min)(2 * y + 1, sh - 1)) * srcStride;
+			uint8_t* out = dst + size_t(y) * dstStride;
+			int x = 0;
+
+#ifdef UI_PYRAMID_SSE2
+			// 4 source pixels from each row, as 16 bit channels, to 2 destination pixels
+			auto quad = [](__m128i top, __m128i bottom) {
+				__m128i zero = _mm_setzero_si128();
+				__m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(top, zero), _mm_unpacklo_epi8(bottom, zero));
+				__m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(top, zero), _mm_unpackhi_epi8(bottom, zero));
+				lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+				hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+				return _mm_srli_epi16(_mm_add_epi16(_mm_unpacklo_epi64(lo, hi), _mm_set1_epi16(2)), 2);
+			};
+
+			// 8 source pixels from each row produce 4 destination pixels
+			for (; 2 * x + 8 <= sw; x += 4) {
+				__m128i a = _mm_loadu_si128((__m128i const*)(r0 + 8 * x));
+				__m128i b = _mm_loadu_si128((__m128i const*)(r0 + 8 * x + 16));
+				__m128i c = _mm_loadu_si128((__m128i const*)(r1 + 8 * x));
+				__m128i d = _mm_loadu_si128((__m128i const*)(r1 + 8 * x + 16));
+				_mm_storeu_si128((__m128i*)(out + 4 * x), _mm_packus_epi16(quad(a, c), quad(b, d)));
+			}
+#endif
+			for (; x < dw; x++) {
+				int x0 = 2 * x, x1 = x0 + (x0 + 1 < sw);
+				for (int k = 0; k < 4; k++)
+					out[4 * x + k] = uint8_t((r0[4 * x0 + k] + r0[4 * x1 + k] + r1[4 * x0 + k] + r1[4 * x1 + k] + 2) >> 2);
+			}
+		}
+	}
+
+	// Least recently used cache with a byte budget. The most recently inserted entry is never evicted.
+	template<typename Key, typename Value>
+	class LruCache {
+		struct Entry {
+			Key key;
+			std::shared_ptr<Value const> value;
+			size_t cost;
+		};
+
+		size_t budget_, used_ = 0;
+		std::list<Entry> order_;
+		std::unordered_map<Key, typename std::list<Entry>::iterator> lookup_;
+		size_t hits_ = 0, misses_ = 0, evictions_ = 0;
+	public:
+		LruCache(size_t budget) : budget_(budget) {}
+
+		std::shared_ptr<Value const> find(Key const& key) {
+			auto it = lookup_.find(key);
+			if (it == lookup_.end()) {
+				++misses_;
+				return nullptr;
+			}
+			++hits_;
+			order_.splice(order_.begin(), order_, it->second);
+			return it->second->value;
+		}
+
+		void insert(Key const& key, std::shared_ptr<Value const> value, size_t cost) {
+			erase(key);
+			order_.push_front({ key, std::move(value), cost });
+			lookup_[key] = order_.begin();
+			used_ += cost;
+
+			while (used_ > budget_ && order_.size() > 1) {
+				auto& last = order_.back();
+				used_ -= last.cost;
+				lookup_.erase(last.key);
+				order_.pop_back();
+				++evictions_;
+			}
+		}
+
+		// Lookup that leaves the order and the counters alone.
+		bool contains(Key const& key) const {
+			return lookup_.count(key) != 0;
+		}
+
+		void erase(Key const& key) {
+			auto it = lookup_.find(key);
+			if (it == lookup_.end())
+				return;
+			used_ -= it->second->cost;
+			order_.erase(it->second);
+			lookup_.erase(it);
+		}
+
+		void clear() { order_.clear(), lookup_.clear(), used_ = 0; }
+		void setBudget(size_t budget) { budget_ = budget; }
+
+		size_t size() const { return order_.size(); }
+		size_t used() const { return used_; }
+		size_t budget() const { return budget_; }
+		size_t hits() const { return hits_; }
+		size_t misses() const { return misses_; }
+		size_t evictions() const { return evictions_; }
+	};
+
+	class TileSource {
+	public:
+		virtual ~TileSource() = default;
+
+		virtual int width() const = 0;
+		virtual int height() const = 0;
+
+		// Writes the RGBA pixels of the w x h region at (x, y) into out, with the given row stride in bytes.
+		virtual bool read(int x, int y, int w, int h, uint8_t* out, int stride) = 0;
+	};
+
+	// Whole image already in memory, used for images that fit but still benefit from the pyramid.
+	class MemoryTileSource : public TileSource {
+		std::vector<uint8_t> data_;
+		int w_, h_, c_;
+	public:
+		MemoryTileSource(std::vector<uint8_t> data, int w, int h, int c) : data_(std::move(data)), w_(w), h_(h), c_(c) {}
+
+		int width() const override { return w_; }
+		int height() const override { return h_; }
+
+		bool read(int x, int y, int w, int h, uint8_t* out, int stride) override {
+			for (int j = 0; j < h; j++) {
+				uint8_t const* src = data_.data() + (size_t(y + j) * w_ + x) * c_;
+				uint8_t* dst = out + size_t(j) * stride;
+				for (int i = 0; i < w; i++, src += c_, dst += 4) {
+					dst[0] = src[0];
+					dst[1] = c_ > 1 ? src[1] : src[0];
+					dst[2] = c_ > 2 ? src[2] : src[0];
+					dst[3] = c_ > 3 ? src[3] : 255;
+				}
+			}
+			return true;
+		}
+	};
+
+	// Streams rows straight out of a binary PGM (P5) or PPM (P6) file, only the requested region is read.
+	class PnmTileSource : public TileSource {
+		std::ifstream file_;
+		std::mutex mutex_;
+		int w_ = 0, h_ = 0, c_ = 0;
+		std::streamoff pixelsStart_ = 0;
+		std::vector<uint8_t> row_;
+	public:
+		PnmTileSource(std::string const& path) : file_(path, std::ios::binary) {
+			// header fields may be separated by # comments running to the end of the line
+			auto skip = [&]() -> std::istream& {
+				while (file_ >> std::ws && file_.peek() == '#')
+					file_.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+				return file_;
+			};
+
+			std::string magic;
+			int maxValue = 0;
+			if (!(skip() >> magic) || !(skip() >> w_) || !(skip() >> h_) || !(skip() >> maxValue) || maxValue != 255 || (magic != "P5" && magic != "P6")) {
+				w_ = h_ = 0;
+				return;
+			}
+			c_ = magic == "P5" ? 1 : 3;
+			file_.get();
+			pixelsStart_ = file_.tellg();
+		}
+
+		bool valid() const { return w_ > 0 && h_ > 0; }
+		int width() const override { return w_; }
+		int height() const override { return h_; }
+
+		bool read(int x, int y, int w, int h, uint8_t* out, int stride) override {
+			std::lock_guard<std::mutex> lock(mutex_);
+			row_.resize(size_t(w) * c_);
+			for (int j = 0; j < h; j++) {
+				file_.seekg(pixelsStart_ + (std::streamoff(y + j) * w_ + x) * c_);
+				if (!file_.read(reinterpret_cast<char*>(row_.data()), row_.size()))
+					return false;
+
+				uint8_t* dst = out + size_t(j) * stride;
+				for (int i = 0; i < w; i++, dst += 4) {
+					uint8_t const* src = row_.data() + size_t(i) * c_;
+					dst[0] = src[0], dst[1] = src[c_ > 1 ? 1 : 0], dst[2] = src[c_ > 1 ? 2 : 0], dst[3] = 255;
+				}
+			}
+			return true;
+		}
+	};
+
+	class TiledImage {
+		static inline uint16_t nextId_ = 1;
+
+		std::unique_ptr<TileSource> source_;
+		int tileSize_, levels_;
+		uint16_t id_ = nextId_++;
+		LruCache<uint64_t, Tile> cache_;
+		std::unordered_set<uint64_t> pending_; // requested and not cached yet
+		int queued_ = 0; // tasks on the pool that still refer to this image
+		bool closing_ = false;
+		std::condition_variable idle_;
+		std::mutex mutex_;
+	public:
+		TiledImage(std::unique_ptr<TileSource> source, int tileSize = 256, size_t cacheBytes = size_t(256) << 20)
+			: source_(std::move(source)), tileSize_(tileSize), cache_(cacheBytes) {
+			levels_ = 1;
+			while ((std::max)(levelWidth(levels_ - 1), levelHeight(levels_ - 1)) > tileSize_)
+				++levels_;
+		}
+
+		// Queued requests that have not started are skipped, the one being decoded is waited for.
+		~TiledImage() {
+			std::unique_lock<std::mutex> lock(mutex_);
+			closing_ = true;
+			idle_.wait(lock, [&] { return queued_ == 0; });
+		}
+
+		int width() const { return source_->width(); }
+		int height() const { return source_->height(); }
+		int tileSize() const { return tileSize_; }
+		int levels() const { return levels_; }
+		uint16_t id() const { return id_; }
+
+		int levelWidth(int level) const { return (std::max)(1, (width() + (1 << level) - 1) >> level); }
+		int levelHeight(int level) const { return (std::max)(1, (height() + (1 << level) - 1) >> level); }
+		int tilesX(int level) const { return (levelWidth(level) + tileSize_ - 1) / tileSize_; }
+		int tilesY(int level) const { return (levelHeight(level) + tileSize_ - 1) / tileSize_; }
+
+		// Unique across images so several views can share one TilePage.
+		uint64_t key(int level, int tx, int ty) const {
+			return uint64_t(id_) << 48 | uint64_t(level & 63) << 42 | uint64_t(tx & 0x1FFFFF) << 21 | uint64_t(ty & 0x1FFFFF);
+		}
+
+		// Returns the tile, decoding or downsampling it (and any missing finer tiles) when it is not cached.
+		std::shared_ptr<Tile const> tile(int level, int tx, int ty) {
+			if (level < 0 || level >= levels_ || tx < 0 || ty < 0 || tx >= tilesX(level) || ty >= tilesY(level))
+				return nullptr;
+
+			uint64_t k = key(level, tx, ty);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (auto hit = cache_.find(k))
+					return hit;
+			}
+
+			auto t = std::make_shared<Tile>();
+			t->w = (std::min)(tileSize_, levelWidth(level) - tx * tileSize_);
+			t->h = (std::min)(tileSize_, levelHeight(level) - ty * tileSize_);
+			t->rgba.assign(size_t(t->w) * t->h * 4, 0);
+
+			if (level == 0) {
+				source_->read(tx * tileSize_, ty * tileSize_, t->w, t->h, t->rgba.data(), t->w * 4);
+			}
+			else {
+				// each child covers one quadrant of the parent
+				int half = tileSize_ / 2;
+				for (int j = 0; j < 2; j++) {
+					for (int i = 0; i < 2; i++) {
+						auto child = tile(level - 1, tx * 2 + i, ty * 2 + j);
+						if (!child)
+							continue;
+						uint8_t* dst = t->rgba.data() + (size_t(j * half) * t->w + i * half) * 4;
+						downsample_2x2(child->rgba.data(), child->w, child->h, child->w * 4, dst, t->w * 4);
+					}
+				}
+			}
+
+			std::lock_guard<std::mutex> lock(mutex_);
+			cache_.insert(k, t, t->bytes());
+			return t;
+		}
+
+		// The tile when it is cached, never decodes.
+		std::shared_ptr<Tile const> cached(int level, int tx, int ty) {
+			std::lock_guard<std::mutex> lock(mutex_);
+			return cache_.find(key(level, tx, ty));
+		}
+
+		// Decodes or downsamples the tile on the shared WorkerPool unless it is cached or already
+		// requested, then hands ready to the UI thread through UiQueue. Returns false when nothing
+		// was queued.
+		bool request(int level, int tx, int ty, std::function<void()> ready) {
+			if (level < 0 || level >= levels_ || tx < 0 || ty < 0 || tx >= tilesX(level) || ty >= tilesY(level))
+				return false;
+
+			uint64_t k = key(level, tx, ty);
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				if (closing_ || cache_.contains(k) || !pending_.insert(k).second)
+					return false;
+				++queued_;
+			}
+
+			WorkerPool::shared().post([this, level, tx, ty, k, ready = std::move(ready)] {
+				bool skip;
+				{
+					std::lock_guard<std::mutex> lock(mutex_);
+					skip = closing_;
+				}
+				if (!skip)
+					tile(level, tx, ty);
+
+				std::lock_guard<std::mutex> lock(mutex_);
+				pending_.erase(k);
+				if (!closing_ && ready)
+					UiQueue::shared().post(ready);
+				if (--queued_ == 0)
+					idle_.notify_all();
+			});
+			return true;
+		}
+
+		// Decodes the tiles of a region that are not cached in parallel, so a following paint only
+		// hits the cache. Returns at once when every tile is cached.
+		void prefetch(int level, int tx0, int ty0, int tx1, int ty1) {
+			if (level < 0 || level >= levels_)
+				return;
+			tx0 = (std::max)(tx0, 0), ty0 = (std::max)(ty0, 0);
+			tx1 = (std::min)(tx1, tilesX(level) - 1), ty1 = (std::min)(ty1, tilesY(level) - 1);
+
+			std::vector<std::array<int, 2>> missing; // stays unallocated when everything is cached
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				for (int ty = ty0; ty <= ty1; ty++)
+					for (int tx = tx0; tx <= tx1; tx++)
+						if (!cache_.contains(key(level, tx, ty)))
+							missing.push_back({ tx, ty });
+			}
+			if (missing.empty())
+				return;
+
+			parallel_for(0, int(missing.size()), [&](int i) {
+				tile(level, missing[i][0], missing[i][1]);
+			});
+		}
+
+		LruCache<uint64_t, Tile>& cache() { return cache_; }
+	};
+
+	// Grid of tile slots backing one GPU texture. Slots used during the current frame are never recycled.
+	class TilePage {
+		struct Slot {
+			uint64_t key = ~0ull;
+			uint64_t frame = 0;
+		};
+
+		int tileSize_, cols_, rows_;
+		std::vector<uint8_t> pixels_;
+		std::vector<Slot> slots_;
+		std::unordered_map<uint64_t, int> lookup_;
+		std::vector<int> dirty_;
+		uint64_t frame_ = 1;
+	public:
+		TilePage(int tileSize = 256, int cols = 8, int rows = 8) : tileSize_(tileSize), cols_(cols), rows_(rows), slots_(cols * rows) {}
+
+		// Region of the tile inside the page, or nothing when every slot is in use this frame.
+		std::optional<std::array<int, 4>> place(uint64_t key, Tile const& tile) {
+			auto it = lookup_.find(key);
+			if (it != lookup_.end()) {
+				slots_[it->second].frame = frame_;
+				return region(it->second, tile);
+			}
+
+			int best = -1;
+			for (int i = 0; i < int(slots_.size()); i++) {
+				if (slots_[i].frame != frame_ && (best == -1 || slots_[i].frame < slots_[best].frame))
+					best = i;
+			}
+			if (best == -1)
+				return std::nullopt;
+
+			if (pixels_.empty())
+				pixels_.assign(size_t(width()) * height() * 4, 0);
+
+			if (slots_[best].key != ~0ull)
+				lookup_.erase(slots_[best].key);
+			slots_[best] = { key, frame_ };
+			lookup_[key] = best;
+
+			int sx = (best % cols_) * tileSize_, sy = (best / cols_) * tileSize_;
+			for (int j = 0; j < tile.h; j++)
+				std::memcpy(pixels_.data() + (size_t(sy + j) * width() + sx) * 4, tile.rgba.data() + size_t(j) * tile.w * 4, size_t(tile.w) * 4);
+
+			dirty_.push_back(best);
+			return region(best, tile);
+		}
+
+		// Keeps a placed tile in its slot this frame, false when the slot has gone to another tile.
+		bool touch(uint64_t key) {
+			auto it = lookup_.find(key);
+			if (it == lookup_.end())
+				return false;
+			slots_[it->second].frame = frame_;
+			return true;
+		}
+
+		// Rewrites rect of a placed tile in its slot, for tiles that grow while placed. False when the
+		// tile is not placed.
+		bool update(uint64_t key, Tile const& tile, std::array<int, 4> const& rect) {
+			auto it = lookup_.find(key);
+			if (it == lookup_.end())
+				return false;
+			int slot = it->second, sx = (slot % cols_) * tileSize_, sy = (slot / cols_) * tileSize_;
+			auto [x, y, w, h] = rect;
+			for (int j = 0; j < h; j++)
+				std::memcpy(pixels_.data() + (size_t(sy + y + j) * width() + sx + x) * 4, tile.rgba.data() + (size_t(y + j) * tile.w + x) * 4, size_t(w) * 4);
+			if (std::find(dirty_.begin(), dirty_.end(), slot) == dirty_.end())
+				dirty_.push_back(slot);
+			return true;
+		}
+
+		void nextFrame() { ++frame_; }
+
+		int width() const { return cols_ * tileSize_; }
+		int height() const { return rows_ * tileSize_; }
+		int tileSize() const { return tileSize_; }
+		bool allocated() const { return !pixels_.empty(); }
+		std::vector<uint8_t> const& pixels() const { return pixels_; }
+
+		// Slots written since the last upload, as page pixel rectangles.
+		std::vector<int> const& dirty() const { return dirty_; }
+		std::array<int, 4> slotRect(int slot) const { return { (slot % cols_) * tileSize_, (slot / cols_) * tileSize_, tileSize_, tileSize_ }; }
+		void clearDirty() { dirty_.clear(); }
+
+	private:
+		std::array<int, 4> region(int slot, Tile const& tile) const {
+			return { (slot % cols_) * tileSize_, (slot / cols_) * tileSize_, tile.w, tile.h };
+		}
+	};
+}
+
+#endif // UI_PYRAMID
@@ -0,0 +1,513 @@
+#ifndef UI_RASTER
+#define UI_RASTER
+
+#include "canvas.hpp"
+#include "binning.hpp"
+#include "parallel.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <string>
+#include <algorithm>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define UI_RASTER_SSE2
+#endif
+
+namespace ui {
+	/*
+		CPU renderer for a FramePacket, the same objects, paints and atlases the GPU path draws.
+
+		The framebuffer is RGBA8, one uint32_t per pixel with R in the low byte. Rendering is split
+		into TileBins tiles that run in parallel, each tile drawing its objects back to front and
+		starting at the frontmost opaque rect that covers it. Colour blends with the GL_SRC_ALPHA,
+		GL_ONE_MINUS_SRC_ALPHA factors UiRenderer sets up and alpha with GL_ONE, GL_ONE_MINUS_SRC_ALPHA,
+		so the framebuffer's alpha is how much of each pixel is covered and it can be composited.
+
+		Shapes are antialiased from their distance to the edge, pens stroke inside the shape edge,
+		masks and images are sampled nearest and glyphs bilinear. eRender paints have no CPU source
+		and are skipped. eText is not recorded by Canvas any more, text arrives as eTextRun.
+	*/
+	class Rasterizer {
+	public:
+		static constexpr int kTile = TileBins::kTileSize;
+
+		Rasterizer(std::shared_ptr<ImageAtlas> masks, std::shared_ptr<ImageAtlas> images) : masks_(masks), images_(images) {
+			glyphs_ = Canvas::glyphTable();
+			if (uf::gLoaded) {
+				font_ = uf::gAtlas.pixels();
+				fontW_ = uf::gAtlas.w(), fontH_ = uf::gAtlas.h();
+			}
+		}
+
+		void setClearColor(color const& c) { clear_ = pixel_(uint32_t(c.pack())); }
+
+		// Draws the frame into the framebuffer. With damagedOnly set and the size unchanged, only
+		// tiles the frame's damage touches are redrawn and the rest keep the previous frame.
+		void render(FramePacket const& frame, int w, int h, TilePage const* tilePage = nullptr, bool damagedOnly = false) {
+			bool resized = w != width_ || h != height_;
+			if (resized) {
+				width_ = w, height_ = h;
+				pixels_.assign(size_t(w) * h, clear_);
+			}
+
+			frame_ = &frame;
+			tilePage_ = tilePage;
+
+			// the packet's own bins when they were built for this size
+			TileBins const* bins = frame.bins;
+			if (!bins || bins->tilesX() != (w + kTile - 1) / kTile || bins->tilesY() != (h + kTile - 1) / kTile) {
+				auto ranges = frame.ranges();
+				bins_.build(ranges.data(), ranges.size(), frame.data.data(), frame.paints.data(), w, h);
+				bins = &bins_;
+			}
+			active_ = bins;
+
+			tiles_.clear();
+			if (damagedOnly && !resized && frame.damage) {
+				bins->tiles(*frame.damage, tiles_);
+			}
+			else {
+				for (int t = 0; t < bins->tileCount(); t++)
+					tiles_.push_back(t);
+			}
+
+			parallel_for(0, int(tiles_.size()), [&](int i) {
+				int t = tiles_[i];
+				drawTile_(t % bins->tilesX(), t / bins->tilesX());
+			}, 4);
+
+			frame_ = nullptr;
+		}
+
+		uint32_t const* pixels() const { return pixels_.data(); }
+		int width() const { return width_; }
+		int height() const { return height_; }
+		size_t tilesDrawn() const { return tiles_.size(); }
+
+		uint32_t at(int x, int y) const { return pixels_[size_t(y) * width_ + x]; }
+
+		bool savePng(std::string const& path) const {
+			return stbi_write_png(path.c_str(), width_, height_, 4, pixels_.data(), width_ * 4) != 0;
+		}
+
+	private:
+		// tile being drawn, x1 and y1 exclusive
+		struct Target {
+			uint32_t* px;
+			int stride;
+			int x0, y0, x1, y1;
+		};
+
+		std::shared_ptr<ImageAtlas> masks_, images_;
+		std::vector<int> glyphs_;
+		std::vector<uint8_t> font_;
+		int fontW_ = 0, fontH_ = 0;
+
+		std::vector<uint32_t> pixels_;
+		int width_ = 0, height_ = 0;
+		uint32_t clear_ = 0xFF1A1A1A; // glClearColor(0.1, 0.1, 0.1, 1) in UiRenderer
+
+		FramePacket const* frame_ = nullptr;
+		TilePage const* tilePage_ = nullptr;
+		TileBins bins_;
+		TileBins const* active_ = nullptr;
+		std::vector<int> tiles_;
+
+		// r << 24 | g << 16 | b << 8 | a as color::pack gives it, to framebuffer byte order
+		static uint32_t pixel_(uint32_t c) {
+			return (c >> 24) | ((c >> 8) & 0xFF00) | ((c << 8) & 0xFF0000) | (c << 24);
+		}
+
+		// 8 bit weight, two channels per multiply
+		static uint32_t lerp_(uint32_t a, uint32_t b, float t) {
+			uint32_t w = uint32_t((std::clamp)(t, 0.0f, 1.0f) * 256.0f), iw = 256 - w;
+			uint32_t rb = ((a & 0x00FF00FF) * iw + (b & 0x00FF00FF) * w) >> 8 & 0x00FF00FF;
+			uint32_t ga = ((a >> 8 & 0x00FF00FF) * iw + (b >> 8 & 0x00FF00FF) * w) & 0xFF00FF00;
+			return rb | ga;
+		}
+
+		static float length_(float x, float y) {
+			return std::sqrt(x * x + y * y);
+		}
+
+		static uint8_t coverage_(float sd) {
+			return uint8_t((std::clamp)(0.5f - sd, 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+
+		void drawTile_(int tx, int ty) {
+			Target t;
+			t.px = pixels_.data();
+			t.stride = width_;
+			t.x0 = tx * kTile, t.y0 = ty * kTile;
+			t.x1 = (std::min)(t.x0 + kTile, width_), t.y1 = (std::min)(t.y0 + kTile, height_);
+
+			// nothing behind the frontmost opaque cover is visible, not even the clear colour
+			auto list = active_->tile(tx, ty);
+			size_t start = list.size();
+			bool covered = false;
+			for (size_t i = 0; i < list.size() && !covered; i++) {
+				if (covers_(active_->object(list[i]), t))
+					start = i + 1, covered = true;
+			}
+
+			if (!covered) {
+				for (int y = t.y0; y < t.y1; y++)
+					fill_(t.px + size_t(y) * t.stride + t.x0, t.x1 - t.x0, clear_);
+			}
+			for (size_t i = start; i-- > 0;)
+				draw_(active_->object(list[i]), t);
+		}
+
+		// Opaque plain rect over the whole tile, nothing behind it needs drawing.
+		bool covers_(RenderObject const& ro, Target const& t) const {
+			if (ro.type != Canvas::eRect || ro.brushIndex < 0 || ro.penIndex >= 0 || ro.maskIndex >= 0)
+				return false;
+			int const* p = frame_->paints.data() + ro.brushIndex;
+			if (!(p[0] == Canvas::eSolid && (p[2] & 0xFF) == 0xFF) && p[0] != Canvas::eImage)
+				return false;
+			auto b = DamageTracker::bounds(ro, frame_->data.data(), frame_->paints.data());
+			return b[0] <= t.x0 && b[1] <= t.y0 && b[2] >= t.x1 && b[3] >= t.y1;
+		}
+
+		void draw_(RenderObject const& ro, Target const& t) {
+			auto b = DamageTracker::bounds(ro, frame_->data.data(), frame_->paints.data());
+			int x0 = (std::max)(b[0], t.x0), y0 = (std::max)(b[1], t.y0);
+			int x1 = (std::min)(b[2], t.x1), y1 = (std::min)(b[3], t.y1);
+			if (x1 <= x0 || y1 <= y0)
+				return;
+
+			int const* paints = frame_->paints.data();
+			if (ro.brushIndex >= 0 && paints[ro.brushIndex] == Canvas::eRender)
+				return;
+
+			switch (ro.type) {
+			case Canvas::eRect:
+				if (ro.maskIndex < 0) {
+					rect_(ro, t, x0, y0, x1, y1);
+					break;
+				}
+				[[fallthrough]];
+			case Canvas::eRRect: case Canvas::eCircle: case Canvas::eEllipse: case Canvas::eLine:
+				shape_(ro, t, x0, y0, x1, y1);
+				break;
+			case Canvas::eTextRun:
+				textRun_(ro, t, x0, y0, x1, y1);
+				break;
+			case Canvas::eNinePatch:
+				if (ro.brushIndex >= 0)
+					for (int y = y0; y < y1; y++)
+						paintSpan_(ro, ro.brushIndex, t, y, x0, x1, nullptr);
+				break;
+			default:
+				break;
+			}
+		}
+
+		// Integer rects need no antialiasing, the fill and the pen band are plain spans.
+		void rect_(RenderObject const& ro, Target const& t, int x0, int y0, int x1, int y1) {
+			int const* paints = frame_->paints.data();
+			if (ro.brushIndex >= 0)
+				for (int y = y0; y < y1; y++)
+					paintSpan_(ro, ro.brushIndex, t, y, x0, x1, nullptr);
+
+			if (ro.penIndex < 0 || paints[ro.penIndex] == Canvas::eRender)
+				return;
+			int pw = paints[ro.penIndex + 1];
+			int ix0 = ro.x + pw, iy0 = ro.y + pw, ix1 = ro.x + ro.w - pw, iy1 = ro.y + ro.h - pw;
+			for (int y = y0; y < y1; y++) {
+				if (y < iy0 || y >= iy1 || ix1 <= ix0) {
+					paintSpan_(ro, ro.penIndex, t, y, x0, x1, nullptr);
+					continue;
+				}
+				if (x0 < ix0)
+					paintSpan_(ro, ro.penIndex, t, y, x0, (std::min)(x1, ix0), nullptr);
+				if (x1 > ix1)
+					paintSpan_(ro, ro.penIndex, t, y, (std::max)(x0, ix1), x1, nullptr);
+			}
+		}
+
+		// Signed distance to the edge at a pixel centre, negative inside.
+		float distance_(RenderObject const& ro, float px, float py) const {
+			switch (ro.type) {
+			case Canvas::eRect: {
+				float hx = ro.w * 0.5f, hy = ro.h * 0.5f;
+				float qx = std::fabs(px - (ro.x + hx)) - hx, qy = std::fabs(py - (ro.y + hy)) - hy;
+				return length_((std::max)(qx, 0.0f), (std::max)(qy, 0.0f)) + (std::min)((std::max)(qx, qy), 0.0f);
+			}
+			case Canvas::eRRect: {
+				int const* r = frame_->data.data() + ro.r1; // tl, tr, br, bl
+				float hx = ro.w * 0.5f, hy = ro.h * 0.5f, cx = ro.x + hx, cy = ro.y + hy;
+				float radius = float(px > cx ? (py > cy ? r[2] : r[1]) : (py > cy ? r[3] : r[0]));
+				radius = (std::min)(radius, (std::min)(hx, hy));
+				float qx = std::fabs(px - cx) - hx + radius, qy = std::fabs(py - cy) - hy + radius;
+				return length_((std::max)(qx, 0.0f), (std::max)(qy, 0.0f)) + (std::min)((std::max)(qx, qy), 0.0f) - radius;
+			}
+			case Canvas::eCircle: {
+				float r = (std::min)(ro.w, ro.h) * 0.5f;
+				return length_(px - (ro.x + ro.w * 0.5f), py - (ro.y + ro.h * 0.5f)) - r;
+			}
+			case Canvas::eEllipse: {
+				float rx = (std::max)(ro.w * 0.5f, 0.5f), ry = (std::max)(ro.h * 0.5f, 0.5f);
+				float dx = px - (ro.x + rx), dy = py - (ro.y + ry);
+				float k0 = length_(dx / rx, dy / ry), k1 = length_(dx / (rx * rx), dy / (ry * ry));
+				return k1 > 0.0f ? k0 * (k0 - 1.0f) / k1 : -(std::min)(rx, ry);
+			}
+			case Canvas::eLine: {
+				// end point in w, h, thickness in r1
+				float ax = float(ro.x), ay = float(ro.y), bx = float(ro.w) - ax, by = float(ro.h) - ay;
+				float len = bx * bx + by * by;
+				float k = len > 0.0f ? (std::clamp)(((px - ax) * bx + (py - ay) * by) / len, 0.0f, 1.0f) : 0.0f;
+				return length_(px - (ax + bx * k), py - (ay + by * k)) - ro.r1 * 0.5f;
+			}
+			default:
+				return 1.0f;
+			}
+		}
+
+		void shape_(RenderObject const& ro, Target const& t, int x0, int y0, int x1, int y1) {
+			int const* paints = frame_->paints.data();
+			bool pen = ro.penIndex >= 0 && paints[ro.penIndex] != Canvas::eRender;
+			float pw = pen ? float(paints[ro.penIndex + 1]) : 0.0f;
+
+			// Every primitive is convex, so each row is edge pixels, a fully covered run inside the
+			// pen and edge pixels again. Distances are only evaluated from both ends until they saturate.
+			uint8_t fill[kTile], band[kTile];
+			auto sample = [&](int x, int y) {
+				float sd = distance_(ro, x + 0.5f, y + 0.5f);
+				uint8_t outer = coverage_(sd);
+				fill[x - x0] = outer;
+				band[x - x0] = pen ? uint8_t(outer - (std::min)(outer, coverage_(sd + pw))) : 0;
+				return outer == 255 && band[x - x0] == 0;
+			};
+
+			for (int y = y0; y < y1; y++) {
+				int l = x0, r = x1;
+				while (l < r && !sample(l, y))
+					l++;
+				while (r > l + 1 && !sample(r - 1, y))
+					r--;
+				if (r > l) {
+					std::memset(fill + (l - x0), 255, size_t(r - l));
+					std::memset(band + (l - x0), 0, size_t(r - l));
+				}
+
+				if (ro.maskIndex >= 0) {
+					mask_(ro, y, x0, x1, fill);
+					mask_(ro, y, x0, x1, band);
+					l = r = x1;
+				}
+				if (ro.brushIndex >= 0) {
+					paintSpan_(ro, ro.brushIndex, t, y, x0, l, fill);
+					paintSpan_(ro, ro.brushIndex, t, y, l, r, nullptr);
+					paintSpan_(ro, ro.brushIndex, t, y, r, x1, fill + (r - x0));
+				}
+				if (pen) {
+					paintSpan_(ro, ro.penIndex, t, y, x0, l, band);
+					paintSpan_(ro, ro.penIndex, t, y, r, x1, band + (r - x0));
+				}
+			}
+		}
+
+		// Mask region stretched over the object rect, multiplied into the coverage.
+		void mask_(RenderObject const& ro, int y, int x0, int x1, uint8_t* cov) const {
+			int const* m = frame_->data.data() + ro.maskIndex;
+			if (!masks_ || masks_->data_.empty() || ro.w <= 0 || ro.h <= 0) {
+				std::fill(cov, cov + (x1 - x0), uint8_t(0));
+				return;
+			}
+			auto const& atlas = *masks_;
+			int my = m[1] + (std::min)(int((y - ro.y + 0.5f) * m[3] / ro.h), m[3] - 1);
+			for (int x = x0; x < x1; x++) {
+				int mx = m[0] + (std::min)(int((x - ro.x + 0.5f) * m[2] / ro.w), m[2] - 1);
+				uint8_t a = atlas.data_[(size_t(my) * atlas.w_ + mx) * atlas.c_];
+				cov[x - x0] = uint8_t((cov[x - x0] * a + 127) / 255);
+			}
+		}
+
+		void textRun_(RenderObject const& ro, Target const& t, int x0, int y0, int x1, int y1) {
+			if (ro.brushIndex < 0 || font_.empty())
+				return;
+			int const* run = frame_->data.data() + ro.r1;
+			float scale = float(run[2]) / float(uf::gMetric.unitsPerEm);
+
+			uint8_t cov[kTile];
+			for (int k = 0; k < run[3]; k++) {
+				int entry = run[4 + k];
+				int const* g = glyphs_.data() + (entry & 0xFF) * Canvas::kGlyphStride;
+				int rw = g[2], rh = g[3];
+				// same truncation as FontCharacter::scale_metrics
+				int qx = run[0] + (entry >> 8), qy = run[1] - int16_t(g[4] * scale);
+				int qw = int(g[5] * scale), qh = int(g[6] * scale);
+				if (qw <= 0 || qh <= 0 || rw <= 0 || rh <= 0)
+					continue;
+
+				int gx0 = (std::max)(qx, x0), gy0 = (std::max)(qy, y0), gx1 = (std::min)(qx + qw, x1), gy1 = (std::min)(qy + qh, y1);
+				float sx = float(rw) / qw, sy = float(rh) / qh;
+				for (int y = gy0; y < gy1; y++) {
+					float fy = (std::clamp)((y - qy + 0.5f) * sy - 0.5f, 0.0f, float(rh - 1));
+					int iy = int(fy), iy1 = (std::min)(iy + 1, rh - 1);
+					float wy = fy - iy;
+					uint8_t const* r0 = font_.data() + size_t(g[1] + iy) * fontW_ + g[0];
+					uint8_t const* r1 = font_.data() + size_t(g[1] + iy1) * fontW_ + g[0];
+					for (int x = gx0; x < gx1; x++) {
+						float fx = (std::clamp)((x - qx + 0.5f) * sx - 0.5f, 0.0f, float(rw - 1));
+						int ix = int(fx), ix1 = (std::min)(ix + 1, rw - 1);
+						float wx = fx - ix;
+						float top = r0[ix] + (r0[ix1] - r0[ix]) * wx, bottom = r1[ix] + (r1[ix1] - r1[ix]) * wx;
+						cov[x - gx0] = uint8_t(top + (bottom - top) * wy + 0.5f);
+					}
+					paintSpan_(ro, ro.brushIndex, t, y, gx0, gx1, cov);
+				}
+			}
+		}
+
+		// Evaluates paint p over one span and blends it, cov may be null for full coverage.
+		void paintSpan_(RenderObject const& ro, int p, Target const& t, int y, int x0, int x1, uint8_t const* cov) const {
+			int n = x1 - x0;
+			if (n <= 0)
+				return;
+			uint32_t* dst = t.px + size_t(y) * t.stride + x0;
+			int const* paint = frame_->paints.data() + p;
+
+			if (paint[0] == Canvas::eSolid) {
+				uint32_t c = pixel_(uint32_t(paint[2]));
+				if (!cov && (c >> 24) == 0xFF)
+					fill_(dst, n, c);
+				else
+					blend_(dst, nullptr, c, cov, n);
+				return;
+			}
+
+			uint32_t colors[kTile];
+			float py = y + 0.5f;
+			switch (paint[0]) {
+			case Canvas::eLinear: {
+				uint32_t c1 = pixel_(uint32_t(paint[2])), c2 = pixel_(uint32_t(paint[3]));
+				float dx = float(paint[6] - paint[4]), dy = float(paint[7] - paint[5]);
+				float len = dx * dx + dy * dy;
+				for (int i = 0; i < n; i++) {
+					float px = x0 + i + 0.5f;
+					colors[i] = lerp_(c1, c2, len > 0.0f ? ((px - paint[4]) * dx + (py - paint[5]) * dy) / len : 0.0f);
+				}
+				break;
+			}
+			case Canvas::eRadial: {
+				uint32_t c1 = pixel_(uint32_t(paint[2])), c2 = pixel_(uint32_t(paint[3]));
+				float r = (std::max)(float(paint[6]), 1.0f);
+				for (int i = 0; i < n; i++)
+					colors[i] = lerp_(c1, c2, length_(x0 + i + 0.5f - paint[4], py - paint[5]) / r);
+				break;
+			}
+			case Canvas::eConical: {
+				uint32_t c1 = pixel_(uint32_t(paint[2])), c2 = pixel_(uint32_t(paint[3]));
+				for (int i = 0; i < n; i++)
+					colors[i] = lerp_(c1, c2, std::atan2(py - paint[5], x0 + i + 0.5f - paint[4]) / float(2.0 * PI) + 0.5f);
+				break;
+			}
+			case Canvas::eImage: case Canvas::eTile: {
+				// region stretched over the object rect, nine-patches keep their insets
+				bool tile = paint[0] == Canvas::eTile;
+				uint8_t const* src = nullptr;
+				int sw = 0, sc = 4;
+				if (tile && tilePage_ && tilePage_->allocated())
+					src = tilePage_->pixels().data(), sw = tilePage_->width();
+				else if (!tile && images_ && !images_->data_.empty())
+					src = images_->data_.data(), sw = images_->w_, sc = images_->c_;
+				if (!src || ro.w <= 0 || ro.h <= 0)
+					return;
+				int const* record = ro.type == Canvas::eNinePatch ? frame_->data.data() + ro.r1 : nullptr;
+				NinePatchAxis ax = nine_patch_axis(ro.x, ro.w, paint[2], paint[4], record ? record[0] : 0, record ? record[2] : 0);
+				NinePatchAxis ay = nine_patch_axis(ro.y, ro.h, paint[3], paint[5], record ? record[1] : 0, record ? record[3] : 0);
+				int sy = texel_(ay, py);
+				for (int i = 0; i < n; i++) {
+					int sx = texel_(ax, x0 + i + 0.5f);
+					uint8_t const* s = src + (size_t(sy) * sw + sx) * sc;
+					colors[i] = sc == 1 ? 0xFF000000u | s[0] * 0x010101u : uint32_t(s[0]) | uint32_t(s[1]) << 8 | uint32_t(s[2]) << 16 | uint32_t(sc == 4 ? s[3] : 0xFF) << 24;
+				}
+				break;
+			}
+			default:
+				return;
+			}
+			blend_(dst, colors, 0, cov, n);
+		}
+
+		// Texel under a pixel centre, each part of the axis stretched over its edges.
+		static int texel_(NinePatchAxis const& a, float p) {
+			int k = p < a.edges[1] ? 0 : p < a.edges[2] ? 1 : 2;
+			int e0 = a.edges[k], e1 = a.edges[k + 1], t0 = a.texels[k], t1 = a.texels[k + 1];
+			if (e1 <= e0 || t1 <= t0)
+				return (std::max)(a.texels[0], (std::min)(t0, a.texels[3] - 1));
+			return (std::clamp)(t0 + int((p - e0) * (t1 - t0) / (e1 - e0)), t0, t1 - 1);
+		}
+
+		static void fill_(uint32_t* dst, int n, uint32_t c) {
+			int i = 0;
+#ifdef UI_RASTER_SSE2
+			__m128i v = _mm_set1_epi32(int(c));
+			for (; i + 4 <= n; i += 4)
+				_mm_storeu_si128((__m128i*)(dst + i), v);
+#endif
+			for (; i < n; i++)
+				dst[i] = c;
+		}
+
+		// dst = src * a + dst * (1 - a) per channel, a = src alpha * coverage, with the source alpha
+		// channel taken as opaque so alpha accumulates coverage. src null uses constant.
+		static void blend_(uint32_t* dst, uint32_t const* src, uint32_t constant, uint8_t const* cov, int n) {
+			int i = 0;
+#ifdef UI_RASTER_SSE2
+			__m128i zero = _mm_setzero_si128(), full = _mm_set1_epi16(256), half = _mm_set1_epi16(128);
+			__m128i cs = _mm_set1_epi32(int(constant)), opaque = _mm_set1_epi32(int(0xFF000000));
+			for (; i + 4 <= n; i += 4) {
+				__m128i s = src ? _mm_loadu_si128((__m128i const*)(src + i)) : cs;
+				__m128i d = _mm_loadu_si128((__m128i const*)(dst + i));
+
+				// alpha * coverage / 255 in 16 bit lanes, then scaled to 0..256
+				__m128i a = _mm_srli_epi32(s, 24);
+				a = _mm_packs_epi32(a, zero);
+				if (cov) {
+					int c4;
+					std::memcpy(&c4, cov + i, 4);
+					__m128i c = _mm_unpacklo_epi8(_mm_cvtsi32_si128(c4), zero);
+					a = _mm_mullo_epi16(a, c);
+					a = _mm_add_epi16(a, half);
+					a = _mm_srli_epi16(_mm_add_epi16(a, _mm_srli_epi16(a, 8)), 8);
+				}
+				a = _mm_add_epi16(a, _mm_srli_epi16(a, 7));
+				s = _mm_or_si128(s, opaque);
+
+				__m128i a2 = _mm_unpacklo_epi16(a, a);
+				__m128i alo = _mm_unpacklo_epi32(a2, a2), ahi = _mm_unpackhi_epi32(a2, a2);
+
+				__m128i slo = _mm_unpacklo_epi8(s, zero), shi = _mm_unpackhi_epi8(s, zero);
+				__m128i dlo = _mm_unpacklo_epi8(d, zero), dhi = _mm_unpackhi_epi8(d, zero);
+				dlo = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(slo, alo), _mm_mullo_epi16(dlo, _mm_sub_epi16(full, alo))), 8);
+				dhi = _mm_srli_epi16(_mm_add_epi16(_mm_mullo_epi16(shi, ahi), _mm_mullo_epi16(dhi, _mm_sub_epi16(full, ahi))), 8);
+				_mm_storeu_si128((__m128i*)(dst + i), _mm_packus_epi16(dlo, dhi));
+			}
+#endif
+			for (; i < n; i++) {
+				uint32_t s = src ? src[i] : constant, d = dst[i];
+				uint32_t a = s >> 24;
+				if (cov) {
+					a = a * cov[i] + 128;
+					a = (a + (a >> 8)) >> 8;
+				}
+				a += a >> 7;
+				s |= 0xFF000000;
+				uint32_t out = 0;
+				for (int k = 0; k < 32; k += 8)
+					out |= ((((s >> k) & 0xFF) * a + ((d >> k) & 0xFF) * (256 - a)) >> 8) << k;
+				dst[i] = out;
+			}
+		}
+	};
+}
+
+#endif // UI_RASTER
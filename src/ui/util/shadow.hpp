@@ -0,0 +1,119 @@
+#ifndef UI_SHADOW
+#define UI_SHADOW
+
+#include "misc.hpp"
+#include "blur.hpp"
+#include "pyramid.hpp"
+
+#include <cstdint>
+#include <cmath>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+namespace ui {
+	/*
+		Blurred rounded rect textures for Canvas::shadow, cached by corner radius, blur, colour and
+		size class, see shadowKey().
+
+		An axis at least 2 * (radius + pad) long is sliced: the texture holds the two blurred corners
+		and kMiddle texels of the straight edge between them, which are equal along the axis and
+		stretch to any length. Shorter axes cannot be sliced, their texture is the whole shadow of the
+		length rounded up to 2, drawn as its two outer halves so the fade keeps its shape. Large shadows
+		therefore share one small nine-slice texture, and the middle of one sliced both ways is a solid
+		rect.
+
+		pad is how far the blur reaches past the rect, three box passes of box_radius(blur / 2).
+		Textures are RGBA with the colour in every texel and the coverage in alpha, since tiles are
+		drawn untinted.
+	*/
+	class ShadowCache {
+	public:
+		static constexpr int kMiddle = 8;
+		static constexpr size_t kDefaultBudget = size_t(2) << 20;
+
+		struct Shadow {
+			uint64_t key; // tile page key
+			int radius, blur, pad;
+			int classW, classH; // 0 for a sliced axis, else the length the texture was drawn at
+			std::shared_ptr<Tile const> tile;
+
+			int corner() const { return radius + 2 * pad; }
+		};
+
+		explicit ShadowCache(size_t budget = kDefaultBudget) : cache_(budget) {}
+
+		static int padding(int blur) { return 3 * box_radius(blur * 0.5f); }
+
+		// The texture for a w x h shadow. Radius and blur are cut down until it fits a tileSize
+		// square, radius also to half the shorter side.
+		Shadow get(int w, int h, int radius, int blur, color const& c, int tileSize) {
+			int maxCorner = (tileSize - kMiddle) / 2;
+			blur = std::clamp(blur, 0, 127);
+			while (blur > 0 && padding(blur) * 4 > maxCorner)
+				blur--;
+			int pad = padding(blur);
+			radius = std::clamp(radius, 0, (std::min)({ maxCorner - 2 * pad, w / 2, h / 2, 127 }));
+
+			Shadow s{ 0, radius, blur, pad, sizeClass_(w, radius, pad), sizeClass_(h, radius, pad), nullptr };
+			s.key = shadowKey(radius, blur, s.classW, s.classH, c);
+			if (!(s.tile = cache_.find(s.key))) {
+				auto tile = render_(s, c);
+				cache_.insert(s.key, tile, tile->bytes());
+				s.tile = tile;
+				renders_++;
+			}
+			return s;
+		}
+
+		// The top two bits tag shadow slots in a TilePage shared with images and layers.
+		static uint64_t shadowKey(int radius, int blur, int classW, int classH, color const& c) {
+			return 3ull << 62 | uint64_t(radius & 0x7F) << 53 | uint64_t(blur & 0x7F) << 46 | uint64_t((classW >> 1) & 0x7F) << 39
+				| uint64_t((classH >> 1) & 0x7F) << 32 | uint64_t(uint32_t(c.pack()));
+		}
+
+		size_t renders() const { return renders_; }
+		LruCache<uint64_t, Tile>& cache() { return cache_; }
+
+	private:
+		LruCache<uint64_t, Tile> cache_;
+		std::vector<uint8_t> coverage_, scratch_;
+		size_t renders_ = 0;
+
+		static int sizeClass_(int length, int radius, int pad) {
+			if (length >= 2 * (radius + pad))
+				return 0;
+			return (std::max)(2, (length + 1) & ~1);
+		}
+
+		std::shared_ptr<Tile> render_(Shadow const& s, color const& c) {
+			int pad = s.pad, r = s.radius;
+			int tw = s.classW ? s.classW + 2 * pad : 2 * s.corner() + kMiddle;
+			int th = s.classH ? s.classH + 2 * pad : 2 * s.corner() + kMiddle;
+
+			// anti-aliased coverage of the rounded rect inset by pad, sampled at texel centres
+			coverage_.assign(size_t(tw) * th, 0);
+			float hw = (tw - 2 * pad) * 0.5f, hh = (th - 2 * pad) * 0.5f, cx = tw * 0.5f, cy = th * 0.5f;
+			float cr = (std::min)({ float(r), hw, hh });
+			for (int y = pad; y < th - pad; y++) {
+				for (int x = pad; x < tw - pad; x++) {
+					float qx = std::abs(x + 0.5f - cx) - (hw - cr), qy = std::abs(y + 0.5f - cy) - (hh - cr);
+					float ox = (std::max)(qx, 0.0f), oy = (std::max)(qy, 0.0f);
+					float d = std::sqrt(ox * ox + oy * oy) + (std::min)((std::max)(qx, qy), 0.0f) - cr;
+					coverage_[size_t(y) * tw + x] = uint8_t(std::clamp(0.5f - d, 0.0f, 1.0f) * 255.0f + 0.5f);
+				}
+			}
+			gaussian_blur(coverage_.data(), tw, th, s.blur * 0.5f, scratch_);
+
+			auto tile = std::make_shared<Tile>();
+			tile->w = tw, tile->h = th;
+			tile->rgba.resize(size_t(tw) * th * 4);
+			uint8_t* out = tile->rgba.data();
+			for (size_t i = 0; i < coverage_.size(); i++, out += 4)
+				out[0] = c.r, out[1] = c.g, out[2] = c.b, out[3] = uint8_t((coverage_[i] * c.a + 127) / 255);
+			return tile;
+		}
+	};
+}
+
+#endif // UI_SHADOW
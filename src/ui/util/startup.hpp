@@ -0,0 +1,198 @@
+#ifndef UI_STARTUP
+#define UI_STARTUP
+
+#include "parallel.hpp"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <stdexcept>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+
+namespace ui {
+	// Dependency graph of startup work. Worker tasks run on a small thread pool, main tasks
+	// (GL uploads, anything touching the context) run on the thread that calls run().
+	class TaskGraph {
+	public:
+		using TaskId = int;
+
+		struct Task {
+			std::string name;
+			std::function<void()> fn;
+			std::vector<TaskId> deps;
+			bool onMain = false;
+			double start = 0.0, end = 0.0; // ms since run() started
+		};
+
+		struct Report {
+			double wallMs = 0.0, criticalMs = 0.0, workMs = 0.0;
+			std::vector<TaskId> criticalPath;
+			std::vector<Task const*> tasks;
+
+			std::string str() const {
+				std::ostringstream out;
+				out << std::fixed << std::setprecision(1);
+				out << "startup " << wallMs << "ms, critical path " << criticalMs << "ms, work " << workMs << "ms\n";
+				for (auto t : tasks)
+					out << "  " << std::setw(24) << std::left << t->name << std::right << std::setw(8) << t->start << " -> " << std::setw(8) << t->end << (t->onMain ? "  main" : "") << "\n";
+				out << "  critical:";
+				for (size_t i = 0; i < criticalPath.size(); i++)
+					out << (i ? " -> " : " ") << tasks[criticalPath[i]]->name;
+				out << "\n";
+				return out.str();
+			}
+		};
+
+		// Dependencies must already have been added, so ids are a topological order.
+		TaskId add(std::string const& name, std::function<void()> fn, std::vector<TaskId> deps = {}, bool onMain = false) {
+			for (auto d : deps)
+				if (d < 0 || d >= int(tasks_.size()))
+					throw std::runtime_error("TaskGraph: unknown dependency for " + name);
+			tasks_.push_back(Task{ name, std::move(fn), std::move(deps), onMain });
+			return TaskId(tasks_.size() - 1);
+		}
+
+		TaskId addMain(std::string const& name, std::function<void()> fn, std::vector<TaskId> deps = {}) {
+			return add(name, std::move(fn), std::move(deps), true);
+		}
+
+		// Runs every task once, rethrows the first exception after the workers have been joined.
+		Report run(int workers = hardware_threads()) {
+			int count = int(tasks_.size());
+			pending_.assign(count, 0);
+			dependents_.assign(count, {});
+			for (int i = 0; i < count; i++) {
+				pending_[i] = int(tasks_[i].deps.size());
+				for (auto d : tasks_[i].deps)
+					dependents_[d].push_back(i);
+			}
+
+			start_ = std::chrono::steady_clock::now();
+			remaining_ = count;
+			error_ = nullptr;
+			for (int i = 0; i < count; i++)
+				if (pending_[i] == 0)
+					push_(i);
+
+			std::vector<std::thread> threads;
+			for (int t = 0; t < (std::max)(workers, 1); t++)
+				threads.emplace_back([this] { work_(false); });
+
+			work_(true);
+
+			{
+				std::lock_guard<std::mutex> lock(mutex_);
+				stop_ = true;
+			}
+			ready_.notify_all();
+			for (auto& t : threads)
+				t.join();
+			stop_ = false;
+
+			if (error_)
+				std::rethrow_exception(error_);
+			return report_();
+		}
+
+		Task const& operator[](TaskId id) const { return tasks_[id]; }
+		size_t size() const { return tasks_.size(); }
+
+	private:
+		std::vector<Task> tasks_;
+		std::vector<int> pending_;
+		std::vector<std::vector<TaskId>> dependents_;
+		std::deque<TaskId> workerQueue_, mainQueue_;
+		std::mutex mutex_;
+		std::condition_variable ready_;
+		std::chrono::steady_clock::time_point start_;
+		std::exception_ptr error_;
+		int remaining_ = 0;
+		bool stop_ = false;
+
+		double now_() const {
+			return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start_).count();
+		}
+
+		// caller holds the lock, or is still single threaded
+		void push_(TaskId id) {
+			(tasks_[id].onMain ? mainQueue_ : workerQueue_).push_back(id);
+		}
+
+		// The main thread only takes main tasks and returns once the graph is finished,
+		// workers take the rest until run() stops them.
+		void work_(bool main) {
+			auto& queue = main ? mainQueue_ : workerQueue_;
+			std::unique_lock<std::mutex> lock(mutex_);
+			for (;;) {
+				ready_.wait(lock, [&] { return !queue.empty() || stop_ || (main && remaining_ == 0); });
+				if (stop_ || (main && remaining_ == 0))
+					return;
+
+				TaskId id = queue.front();
+				queue.pop_front();
+				auto& task = tasks_[id];
+				bool skip = error_ != nullptr;
+				lock.unlock();
+
+				task.start = now_();
+				if (!skip) {
+					try {
+						task.fn();
+					}
+					catch (...) {
+						std::lock_guard<std::mutex> errorLock(mutex_);
+						if (!error_)
+							error_ = std::current_exception();
+					}
+				}
+				task.end = now_();
+
+				lock.lock();
+				for (auto d : dependents_[id])
+					if (--pending_[d] == 0)
+						push_(d);
+				remaining_--;
+				ready_.notify_all();
+			}
+		}
+
+		// Longest chain of measured durations, the time startup would take with unlimited workers.
+		Report report_() const {
+			Report report;
+			int count = int(tasks_.size());
+			std::vector<double> finish(count, 0.0);
+			std::vector<TaskId> via(count, -1);
+
+			for (int i = 0; i < count; i++) {
+				auto const& t = tasks_[i];
+				double longest = 0.0;
+				for (auto d : t.deps) {
+					if (finish[d] > longest)
+						longest = finish[d], via[i] = d;
+				}
+				finish[i] = longest + (t.end - t.start);
+				report.workMs += t.end - t.start;
+				report.wallMs = (std::max)(report.wallMs, t.end);
+				report.tasks.push_back(&t);
+			}
+
+			TaskId last = -1;
+			for (int i = 0; i < count; i++)
+				if (last < 0 || finish[i] > finish[last])
+					last = i;
+			if (last >= 0)
+				report.criticalMs = finish[last];
+			for (TaskId i = last; i >= 0; i = via[i])
+				report.criticalPath.insert(report.criticalPath.begin(), i);
+			return report;
+		}
+	};
+}
+
+#endif // UI_STARTUP
@@ -0,0 +1,227 @@
+#ifndef UI_TRACE
+#define UI_TRACE
+
+#include "event.hpp"
+#include "backend.hpp"
+
+#include <cstdint>
+#include <cstring>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <iterator>
+
+namespace ui {
+	struct TracedInput {
+		double time; // seconds on the recording backend's clock
+		InputEvent event;
+	};
+
+	/*
+		Input trace file, the magic and version then one record per event, read until the end:
+			time since the previous event in microseconds, kind, button, window id,
+			x and y as the change from the previous event, wheel delta and key
+		Bytes are single bytes, the rest varints, signed values zigzag encoded.
+	*/
+	namespace trace {
+		inline constexpr uint32_t kMagic = 0x54495848; // "HXIT"
+		inline constexpr uint32_t kVersion = 1;
+
+		inline void put(std::vector<uint8_t>& out, uint64_t v) {
+			while (v >= 0x80) {
+				out.push_back(uint8_t(v | 0x80));
+				v >>= 7;
+			}
+			out.push_back(uint8_t(v));
+		}
+
+		inline void putSigned(std::vector<uint8_t>& out, int64_t v) {
+			put(out, (uint64_t(v) << 1) ^ uint64_t(v >> 63));
+		}
+	}
+
+	// Appends events to a trace file as they happen, each flushed so a crash keeps what came before.
+	class InputRecorder {
+		std::ofstream file_;
+		std::vector<uint8_t> record_;
+		int64_t lastTime_ = 0;
+		int lastX_ = 0, lastY_ = 0;
+		size_t events_ = 0;
+	public:
+		explicit InputRecorder(std::string const& path) : file_(path, std::ios::binary) {
+			if (!file_.is_open())
+				return;
+			file_.write(reinterpret_cast<char const*>(&trace::kMagic), sizeof(trace::kMagic));
+			file_.write(reinterpret_cast<char const*>(&trace::kVersion), sizeof(trace::kVersion));
+		}
+
+		bool good() const { return file_.is_open() && bool(file_); }
+		size_t events() const { return events_; }
+
+		// Records everything the backend translates from now on.
+		void attach(Backend& backend) {
+			backend.onInput = [this](double time, InputEvent const& e) { record(time, e); };
+		}
+
+		// Times are kept to the microsecond, the first event's time is stored whole.
+		void record(double time, InputEvent const& e) {
+			if (!good())
+				return;
+			int64_t us = int64_t(time * 1e6 + 0.5);
+			record_.clear();
+			trace::putSigned(record_, events_ == 0 ? us : us - lastTime_);
+			record_.push_back(uint8_t(e.kind)), record_.push_back(uint8_t(e.button));
+			trace::putSigned(record_, e.windowID);
+			trace::putSigned(record_, e.x - lastX_), trace::putSigned(record_, e.y - lastY_);
+			trace::putSigned(record_, e.delta), trace::put(record_, uint32_t(e.key));
+			file_.write(reinterpret_cast<char const*>(record_.data()), record_.size());
+			file_.flush();
+
+			lastTime_ = us, lastX_ = e.x, lastY_ = e.y;
+			events_++;
+		}
+	};
+
+	// A loaded or built up event sequence, oldest first.
+	class InputTrace {
+		std::vector<TracedInput> events_;
+	public:
+		bool load(std::string const& path) {
+			events_.clear();
+			std::ifstream file(path, std::ios::binary);
+			if (!file.is_open())
+				return false;
+			std::vector<uint8_t> bytes((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+			if (bytes.size() < 8)
+				return false;
+			uint32_t magic, version;
+			std::memcpy(&magic, bytes.data(), 4), std::memcpy(&version, bytes.data() + 4, 4);
+			if (magic != trace::kMagic || version != trace::kVersion)
+				return false;
+
+			uint8_t const* p = bytes.data() + 8, * end = bytes.data() + bytes.size();
+			auto get = [&](uint64_t& v) {
+				v = 0;
+				for (int shift = 0; shift < 64 && p < end; shift += 7) {
+					uint8_t b = *p++;
+					v |= uint64_t(b & 0x7F) << shift;
+					if (!(b & 0x80))
+						return true;
+				}
+				return false;
+			};
+			auto getSigned = [&](int64_t& v) {
+				uint64_t u;
+				if (!get(u))
+					return false;
+				v = int64_t(u >> 1) ^ -int64_t(u & 1);
+				return true;
+			};
+
+			int64_t time = 0;
+			int x = 0, y = 0;
+			while (p < end) {
+				int64_t dt, window, dx, dy, delta;
+				uint64_t key;
+				if (!getSigned(dt) || end - p < 2)
+					break;
+				uint8_t kind = *p++, button = *p++;
+				if (!getSigned(window) || !getSigned(dx) || !getSigned(dy) || !getSigned(delta) || !get(key))
+					break;
+				time += dt, x += int(dx), y += int(dy);
+
+				InputEvent e;
+				e.windowID = int(window), e.kind = InputEvent::eKind(kind), e.button = eButton(button);
+				e.x = x, e.y = y, e.delta = int(delta), e.key = int(key);
+				events_.push_back({ double(time) / 1e6, e });
+			}
+			return true;
+		}
+
+		bool save(std::string const& path) const {
+			InputRecorder out(path);
+			for (auto const& [time, e] : events_)
+				out.record(time, e);
+			return out.good();
+		}
+
+		void add(double time, InputEvent const& e) { events_.push_back({ time, e }); }
+
+		// Scenario helpers for synthetic benchmarks, each starting at time and returning when it ends.
+		double click(int windowID, int x, int y, double time, eButton button = fLeft) {
+			add(time, { windowID, InputEvent::eMouseMove, fNoButton, x, y });
+			add(time, { windowID, InputEvent::eMousePress, button, x, y });
+			add(time + 0.05, { windowID, InputEvent::eMouseRelease, button, x, y });
+			return time + 0.05;
+		}
+
+		// Press at x0, y0, one move per step towards x1, y1, release at the end.
+		double drag(int windowID, int x0, int y0, int x1, int y1, int steps, double time, double stepTime = 1.0 / 60, eButton button = fLeft) {
+			add(time, { windowID, InputEvent::eMouseMove, fNoButton, x0, y0 });
+			add(time, { windowID, InputEvent::eMousePress, button, x0, y0 });
+			for (int i = 1; i <= steps; i++) {
+				time += stepTime;
+				add(time, { windowID, InputEvent::eMouseMove, button, x0 + (x1 - x0) * i / steps, y0 + (y1 - y0) * i / steps });
+			}
+			add(time, { windowID, InputEvent::eMouseRelease, button, x1, y1 });
+			return time;
+		}
+
+		// Wheel notches over x, y, negative delta scrolls down.
+		double wheel(int windowID, int x, int y, int delta, int notches, double time, double stepTime = 1.0 / 60) {
+			add(time, { windowID, InputEvent::eMouseMove, fNoButton, x, y });
+			for (int i = 0; i < notches; i++, time += stepTime)
+				add(time, { windowID, InputEvent::eWheel, fNoButton, x, y, delta });
+			return time;
+		}
+
+		size_t size() const { return events_.size(); }
+		bool empty() const { return events_.empty(); }
+		TracedInput const& operator[](size_t i) const { return events_[i]; }
+		std::vector<TracedInput> const& events() const { return events_; }
+		double duration() const { return events_.empty() ? 0.0 : events_.back().time - events_.front().time; }
+	};
+
+	/*
+		Feeds a trace to a Backend frame by frame on its manual clock, which starts at the first event's
+		time. Every step posts the events due by the clock, runs update() and moves the clock on by a
+		fixed time, so a replay produces the same frames on every run and machine. Due times are
+		compared in whole microseconds as the trace stores them. Window ids are the recording's, which
+		match when the widget tree is built the same way.
+	*/
+	class InputReplay {
+		InputTrace const& trace_;
+		size_t next_ = 0;
+
+		static int64_t micros_(double t) { return int64_t(std::floor(t * 1e6 + 0.5)); }
+	public:
+		explicit InputReplay(InputTrace const& trace) : trace_(trace) {}
+
+		// Clears pointer and key state left from live input and puts the clock on manual.
+		void start(Backend& backend) {
+			detail::gPointer = {};
+			platform::gKeys = {};
+			backend.clock().setManual(true);
+			backend.clock().set(trace_.empty() ? 0.0 : trace_[0].time);
+			next_ = 0;
+		}
+
+		// One frame, false once every event has been posted and processed.
+		bool step(Backend& backend, double frameTime = 1.0 / 60) {
+			if (done())
+				return false;
+			int64_t now = micros_(backend.clock().now());
+			while (next_ < trace_.size() && micros_(trace_[next_].time) <= now)
+				backend.post(trace_[next_++].event);
+			backend.update();
+			backend.clock().advance(frameTime);
+			return true;
+		}
+
+		bool done() const { return next_ >= trace_.size(); }
+		size_t posted() const { return next_; }
+	};
+}
+
+#endif // UI_TRACE
@@ -6,6 +6,7 @@
 #include "canvas.hpp"
 #include "animation.hpp"
 #include "native.hpp"
+#include "layer.hpp"
 
 namespace ui {
 	class Widget {
@@ -35,6 +36,33 @@ namespace ui {
 		bool wrapChildrenX_ = false;
 		bool wrapChildrenY_ = false;
 
+		// Retained painting: a clean widget replays the display list of its whole subtree.
+		DisplayList displayList_;
+		bool paintDirty_ = true;
+		bool retained_ = true;
+
+		// Layer caching: a clean subtree is composited from an offscreen layer, see LayerCache.
+		// The stamp moves on with every recapture of the display list the layer is made from.
+		bool cacheAsLayer_ = false;
+		uint64_t layerStamp_ = 0;
+
+		// Incremental layout: a clean widget given the rect it was last given keeps its layout.
+		Rect layoutIn_;
+		bool layoutDirty_ = true;
+		bool childLayoutDirty_ = false;
+		bool postLayoutDirty_ = false, childPostLayoutDirty_ = false; // laid out since the last postLayout
+
+		// Measure memo per offered size, valid while the version holds. Two entries, a parent measures
+		// a child within its own rect and the child measures itself again within the size it is given.
+		struct Measured {
+			int maxW, maxH;
+			uint32_t version;
+			SizeHint hint;
+		};
+		Measured measured_[2] = { { -1, -1, ~0u, {} }, { -1, -1, ~0u, {} } };
+		int measuredNext_ = 0;
+		uint32_t measureVersion_ = 0;
+
 		Rect rect_;
 		float xSize_ = 1.0, ySize_ = 1.0;
 		std::optional<int> fixedX_ = std::nullopt, fixedY_ = std::nullopt;
@@ -46,6 +74,7 @@ namespace ui {
 		static inline std::function<Native*(int)> onGetWindow;
 		static inline std::function<void(int)> onRemoveTopLevel;
 		static inline std::function<void(Widget*)> onCloseWidget;
+		static inline LayerCache* layerCache = nullptr; // set by Backend, layers are off without one
 
 		Widget() : parent_(nullptr) {}
 		~Widget() {}
@@ -57,8 +86,11 @@ namespace ui {
 			}
 
 			int idx = index();
+			parent_->invalidate();
+			parent_->relayout();
 			auto temp = std::move(parent_->children_[idx]);
 			parent_->children_.erase(parent_->children_.begin() + idx);
+			temp->parent_ = nullptr;
 
 			return std::move(temp);
 		}
@@ -67,6 +99,8 @@ namespace ui {
 		T* insertChild(int index, std::unique_ptr<T> widget) {
 			children_.insert(children_.begin() + index, std::move(widget));
 			children_[index]->parent_ = this;
+			invalidate();
+			relayout();
 			return static_cast<T*>(children_[index].get());
 		}
 
@@ -76,7 +110,8 @@ namespace ui {
 			child->parent_ = this;
 			child_t* ptr = child.get();
 			children_.insert(children_.begin() + index, std::move(child));
-			
+			invalidate();
+			relayout();
 			return ptr;
 		}
 
@@ -86,6 +121,8 @@ namespace ui {
 			child->parent_ = this;
 			child_t* ptr = child.get();
 			children_.push_back(std::move(child));
+			invalidate();
+			relayout();
 			return ptr;
 		}
 
@@ -103,9 +140,21 @@ namespace ui {
 
 		void event(Event* e);
 
-		void paint(Canvas* c) {
+		// Returns false when something in the subtree repaints every frame, its ancestors then
+		// cannot keep a display list either. A layered widget does so until it composites, the
+		// ancestors then capture its tile rects, which are placed by key and replay like shadows.
+		bool paint(Canvas* c) {
 			if (!visible_)
-				return;
+				return true;
+
+			if (cacheAsLayer_ && !paintDirty_ && layerCache && layerCache->composite(c, uuid_, layerStamp_, displayList_, rect_))
+				return true;
+
+			if (!paintDirty_ && c->replay(displayList_))
+				return !cacheAsLayer_;
+
+			auto mark = c->mark();
+			bool retained = retained_;
 
 			onPaint(c);
 
@@ -113,15 +162,81 @@ namespace ui {
 				c->clip(rect_.x, rect_.y, rect_.w, rect_.h);
 
 			for (auto& ch : children_)
-				ch->paint(c);
+				retained &= ch->paint(c);
 
 			if (clipsChildren_)
 				c->unclip();
+
+			if (retained) {
+				c->capture(mark, displayList_);
+				paintDirty_ = false;
+				layerStamp_++;
+			}
+			return retained && !cacheAsLayer_;
+		}
+
+		// Marks the widget for re-recording, with its ancestors since their lists contain it. The walk
+		// stops at the first ancestor already marked, whose own are then marked too; only a hidden
+		// widget's can be clean, and showing it marks them. Call after changing anything onPaint reads
+		// that is not a hover or layout change, event handlers included.
+		void invalidate() {
+			paintDirty_ = true;
+			for (Widget* w = parent_; w && !w->paintDirty_; w = w->parent_)
+				w->paintDirty_ = true;
+		}
+
+		// Marks the widget for layout, with its ancestors up to the first relayout boundary. A widget of
+		// fixed width and height keeps its rect whatever changes under it, the ones above it only walk
+		// down to it. Call after changing anything onLayout reads that the setters do not cover.
+		void relayout() {
+			Widget* w = this;
+			w->layoutDirty_ = true, w->measureVersion_++;
+			for (; w->parent_ && !w->layoutBoundary(); w = w->parent_)
+				w->parent_->layoutDirty_ = true, w->parent_->measureVersion_++;
+			for (w = w->parent_; w; w = w->parent_)
+				w->childLayoutDirty_ = true;
+		}
+
+		// Intrinsic size within maxW by maxH, memoized until relayout() marks the widget. Fixed and
+		// relative axes report their size, flex and content axes what onMeasure reports.
+		SizeHint measure(int maxW, int maxH) {
+			for (auto const& m : measured_)
+				if (m.version == measureVersion_ && m.maxW == maxW && m.maxH == maxH)
+					return m.hint;
+
+			SizeHint s = onMeasure(maxW, maxH);
+			if (xConstraint_ == fFixed || xConstraint_ == fRelative)
+				s.minW = s.w = xConstraint_ == fFixed ? int(xSize_) : int(maxW * xSize_);
+			if (yConstraint_ == fFixed || yConstraint_ == fRelative)
+				s.minH = s.h = yConstraint_ == fFixed ? int(ySize_) : int(maxH * ySize_);
+
+			measured_[measuredNext_] = { maxW, maxH, measureVersion_, s };
+			measuredNext_ ^= 1;
+			return s;
 		}
 
+		// Hidden widgets are skipped, showing one lays it out again. A clean widget given the rect it
+		// was last given only walks down to the dirty widgets under it, so an idle frame does nothing.
 		void layout(int x, int y, int w, int h) {
-			int rw = xConstraint_ == fRelative ? w * xSize_ : xConstraint_ == fFlex ? w : xSize_;
-			int rh = yConstraint_ == fRelative ? h * ySize_ : yConstraint_ == fFlex ? h : ySize_;
+			if (!visible_)
+				return;
+
+			if (!layoutDirty_ && x == layoutIn_.x && y == layoutIn_.y && w == layoutIn_.w && h == layoutIn_.h) {
+				if (childLayoutDirty_) {
+					childLayoutDirty_ = false;
+					childPostLayoutDirty_ = true;
+					for (auto& child : children_)
+						child->layout(child->layoutIn_.x, child->layoutIn_.y, child->layoutIn_.w, child->layoutIn_.h);
+				}
+				return;
+			}
+			layoutIn_ = { x, y, w, h };
+			layoutDirty_ = childLayoutDirty_ = false;
+			postLayoutDirty_ = childPostLayoutDirty_ = true;
+
+			SizeHint content = xConstraint_ == fContent || yConstraint_ == fContent ? measure(w, h) : SizeHint{};
+			int rw = xConstraint_ == fRelative ? w * xSize_ : xConstraint_ == fFlex ? w : xConstraint_ == fContent ? content.w : xSize_;
+			int rh = yConstraint_ == fRelative ? h * ySize_ : yConstraint_ == fFlex ? h : yConstraint_ == fContent ? content.h : ySize_;
 
 			int rx = xConstraint_ == fFlex || xAlignment_ == fLeading ? x : xAlignment_ == fTrailing ? x + (w - rw)  : x + (w - rw) / 2;
 			int ry = yConstraint_ == fFlex || yAlignment_ == fLeading ? y : yAlignment_ == fTrailing ? y + (h - rh)  : y + (h - rh) / 2;
@@ -129,6 +244,7 @@ namespace ui {
 			int rxx = fixedX_.has_value() ? fixedX_.value() : rx;
 			int ryy = fixedY_.has_value() ? fixedY_.value() : ry;
 
+			Rect old = rect_;
 			rect_ = { rxx, ryy, rw, rh };
 			onLayout(rxx, ryy, rw, rh);
 
@@ -142,9 +258,22 @@ namespace ui {
 					if (child->rect_.y + child->rect_.h > ryy + rh) rect_.h = (child->rect_.y + child->rect_.h) - rect_.y;
 				}
 			}
+
+			if (old.x != rect_.x || old.y != rect_.y || old.w != rect_.w || old.h != rect_.h)
+				invalidate();
 		}
 
-		virtual void postLayout() {}
+		// Runs onPostLayout, parents first, on the widgets layout() laid out since the last call, and
+		// walks only the paths down to them. Positions set from there, see Anchor, apply next layout.
+		virtual void postLayout() {
+			if (!visible_ || !(postLayoutDirty_ || childPostLayoutDirty_))
+				return;
+			if (postLayoutDirty_)
+				onPostLayout();
+			postLayoutDirty_ = childPostLayoutDirty_ = false;
+			for (auto& child : children_)
+				child->postLayout();
+		}
 
 		// getters
 		Widget* root() { return parent_ == nullptr ? this : parent_->root(); }
@@ -177,29 +306,41 @@ namespace ui {
 		fAlignment yAlignment() const { return yAlignment_; }
 		bool wrapChildrenX() const { return wrapChildrenX_; }
 		bool wrapChildrenY() const { return wrapChildrenY_; }
+		bool retained() const { return retained_; }
+		bool cacheAsLayer() const { return cacheAsLayer_; }
+		bool paintDirty() const { return paintDirty_; }
+		bool layoutDirty() const { return layoutDirty_; }
+		bool layoutBoundary() const { return xConstraint_ == fFixed && yConstraint_ == fFixed && !wrapChildrenX_ && !wrapChildrenY_; }
 		int id() const { return uuid_; }
 		Native* window() { return onGetWindow(uuid_); }
 		Native* window(int id) { return onGetWindow(id); }
 
 		// Setters
-		void setClipsChildren(bool v) { clipsChildren_ = v; }
-		void setFixedW(int w) { xSize_ = w, xConstraint_ = fFixed; }
-		void setFixedH(int h) { ySize_ = h, yConstraint_ = fFixed; }
-		void setFixedSize(int w, int h) { xSize_ = w, ySize_ = h, xConstraint_ = fFixed, yConstraint_ = fFixed; }
-		void setRelativeW(float w) { xSize_ = w, xConstraint_ = fRelative; }
-		void setRelativeH(float h) { ySize_ = h, yConstraint_ = fRelative; }
-		void setRelativeSize(float w, float h) { xSize_ = w, ySize_ = h, xConstraint_ = fRelative, yConstraint_ = fRelative; }
-		void setFlexW(int lvl) { xConstraint_ = fFlex, xSize_ = lvl; }
-		void setFlexH(int lvl) { yConstraint_ = fFlex, ySize_ = lvl; }
-		void setFlexSize(int wlvl, int hlvl) { xConstraint_ = fFlex, yConstraint_ = fFlex, xSize_ = wlvl, ySize_ = hlvl; }
-		void setLeft() { xAlignment_ = fLeading; }
-		void setTop() { yAlignment_ = fLeading; }
-		void setCenterX() { xAlignment_ = fCenter; }
-		void setCenterY() { yAlignment_ = fCenter; }
-		void setRight() { xAlignment_ = fTrailing; }
-		void setBottom() { yAlignment_ = fTrailing; }
-		void setVisible(bool v) { if (visible_ != v) { visible_ = v; v ? onShow() : onHide(); } }
-		void setEnabled(bool v) { if (enabled_ != v) { enabled_ = v; v ? onEnabled() : onDisabled(); } }
+		void setClipsChildren(bool v) { clipsChildren_ = v, invalidate(); }
+		void setRetained(bool v) { retained_ = v, invalidate(); }
+		// Draw the subtree from an offscreen layer while it is unchanged, for large and mostly static
+		// subtrees. Needs every widget in it to be retained.
+		void setCacheAsLayer(bool v) { cacheAsLayer_ = v, invalidate(); }
+		void setFixedW(int w) { constrain_(xConstraint_, xSize_, fFixed, w); }
+		void setFixedH(int h) { constrain_(yConstraint_, ySize_, fFixed, h); }
+		void setFixedSize(int w, int h) { setFixedW(w), setFixedH(h); }
+		void setRelativeW(float w) { constrain_(xConstraint_, xSize_, fRelative, w); }
+		void setRelativeH(float h) { constrain_(yConstraint_, ySize_, fRelative, h); }
+		void setRelativeSize(float w, float h) { setRelativeW(w), setRelativeH(h); }
+		void setFlexW(int lvl) { constrain_(xConstraint_, xSize_, fFlex, lvl); }
+		void setFlexH(int lvl) { constrain_(yConstraint_, ySize_, fFlex, lvl); }
+		void setFlexSize(int wlvl, int hlvl) { setFlexW(wlvl), setFlexH(hlvl); }
+		void setContentW() { constrain_(xConstraint_, xSize_, fContent, 0); }
+		void setContentH() { constrain_(yConstraint_, ySize_, fContent, 0); }
+		void setContentSize() { setContentW(), setContentH(); }
+		void setLeft() { align_(xAlignment_, fLeading); }
+		void setTop() { align_(yAlignment_, fLeading); }
+		void setCenterX() { align_(xAlignment_, fCenter); }
+		void setCenterY() { align_(yAlignment_, fCenter); }
+		void setRight() { align_(xAlignment_, fTrailing); }
+		void setBottom() { align_(yAlignment_, fTrailing); }
+		void setVisible(bool v) { if (visible_ != v) { visible_ = v; invalidate(); placed_(); v ? onShow() : onHide(); } }
+		void setEnabled(bool v) { if (enabled_ != v) { enabled_ = v; invalidate(); v ? onEnabled() : onDisabled(); } }
 		void setAcceptsDragDrop(bool v) { acceptsDragDrop_ = v; }
 		void setInitiatesDrag(bool v) { initiatesDrag_ = v; }
 		void setConsumesDrag(bool v) { consumesDrag_ = v; }
@@ -207,9 +348,9 @@ namespace ui {
 		void setKeyFocus(bool v) { keyFocus_ = v; }
 		void setDragStartFocus(bool v) { dragStartFocus_ = v; }
 		void setDragDropFocus(bool v) { dragDropFocus_ = v; }
-		void setFixedX(int x) { fixedX_ = x; }
-		void setFixedY(int y) { fixedY_ = y; }
-		void setFixedPos(int x, int y) { fixedX_ = x; fixedY_ = y; }
+		void setFixedX(int x) { if (fixedX_ != x) fixedX_ = x, relayout(); }
+		void setFixedY(int y) { if (fixedY_ != y) fixedY_ = y, relayout(); }
+		void setFixedPos(int x, int y) { setFixedX(x); setFixedY(y); }
 
 	protected:
 		// Widget Events
@@ -230,6 +371,17 @@ namespace ui {
 				ch->layout(rect_.x, rect_.y, rect_.w, rect_.h);
 		}
 		virtual void onPostLayout() {};
+		// The content's own size, by default the largest of the children's. Call relayout() when
+		// anything read here changes.
+		virtual SizeHint onMeasure(int maxW, int maxH) {
+			SizeHint s;
+			for (auto& ch : children_) {
+				SizeHint c = ch->measure(maxW, maxH);
+				s.minW = (std::max)(s.minW, c.minW), s.minH = (std::max)(s.minH, c.minH);
+				s.w = (std::max)(s.w, c.w), s.h = (std::max)(s.h, c.h);
+			}
+			return s;
+		}
 
 		// Drag Events
 		virtual void onDragEnter(DragEvent* e) {};
@@ -273,6 +425,23 @@ namespace ui {
 			}
 			return -1;
 		}
+
+	private:
+		// The parent places its children by their constraints and visibility, so it lays out again too.
+		void placed_() {
+			layoutDirty_ = true, measureVersion_++;
+			(parent_ ? parent_ : this)->relayout();
+		}
+
+		void constrain_(fConstraint& constraint, float& size, fConstraint c, float s) {
+			if (constraint != c || size != s)
+				constraint = c, size = s, placed_();
+		}
+
+		void align_(fAlignment& alignment, fAlignment a) {
+			if (alignment != a)
+				alignment = a, relayout();
+		}
 	};
 
 	void Widget::event(Event* e) {
@@ -289,9 +458,9 @@ namespace ui {
 
 		bool eventInView = rect().contains(e->x(), e->y());
 
-
+		// Handlers invalidate what they change themselves, hover changes below are marked here. Keys go
+		// to every widget, but only the one holding key focus is taken to repaint on them.
 		if (e->category() == fMouse && eventInView) {
-			std::cout << "Mouse EVent" << e->windowID() << std::endl;
 			auto me = static_cast<MouseEvent*>(e);
 			if (me->action() == fPress) onMousePress(me);
 			if (me->action() == fDoublePress) onMouseDoublePress(me);
@@ -303,6 +472,7 @@ namespace ui {
 			auto ke = static_cast<KeyEvent*>(e);
 			if (ke->action() == fPress) onKeyPress(ke);
 			if (ke->action() == fRelease) onKeyRelease(ke);
+			if (keyFocus_) invalidate();
 		}
 		if (e->category() == fDrag && eventInView) {
 			auto de = static_cast<DragEvent*>(e);
@@ -327,10 +497,10 @@ namespace ui {
 			if (we->action() == fHover) onWindowHover(we);
 		}
 
-		if (e->category() == fMouse && !mouseOver_ && eventInView) mouseOver_ = true, onEnter();
-		if (e->category() == fMouse && mouseOver_ && !eventInView) mouseOver_ = false, onLeave();
-		if (e->category() == fDrag && !mouseOver_ && eventInView) mouseOver_ = true, onDragEnter(static_cast<DragEvent*>(e));
-		if (e->category() == fDrag && mouseOver_ && !eventInView) mouseOver_ = false, onDragLeave(static_cast<DragEvent*>(e));
+		if (e->category() == fMouse && !mouseOver_ && eventInView) mouseOver_ = true, invalidate(), onEnter();
+		if (e->category() == fMouse && mouseOver_ && !eventInView) mouseOver_ = false, invalidate(), onLeave();
+		if (e->category() == fDrag && !mouseOver_ && eventInView) mouseOver_ = true, invalidate(), onDragEnter(static_cast<DragEvent*>(e));
+		if (e->category() == fDrag && mouseOver_ && !eventInView) mouseOver_ = false, invalidate(), onDragLeave(static_cast<DragEvent*>(e));
 	}
 
 	struct BoxWidget : public Widget {
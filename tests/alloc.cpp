@@ -0,0 +1,129 @@
+// Checks that a steady-state frame makes no heap allocations.
+//
+//   alloc [--font path] [--warmup n] [--frames n]
+//
+// Replaces the global operator new with a counting one. The scene re-records part of itself every
+// frame: an animated colour interns new paint records, clipped rows push clip records, a shadow
+// places a tile page slot, and the ancestors capture their display lists again around all of it.
+// Every frame then takes the packet, which computes damage, and the tile bins the CPU renderer
+// asks for. After the warm up frames have grown every buffer to its steady size, the counted
+// frames must allocate nothing.
+// Prints the allocations per phase and exits non-zero when there are any.
+
+#include "../src/ui/layout.hpp"
+#include "../src/ui/label.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <new>
+#include <string>
+#include <vector>
+
+namespace {
+    std::atomic<bool> counting{ false };
+    std::atomic<size_t> allocations{ 0 };
+
+    // repaints every frame in a colour it has not used before
+    struct Pulse : ui::Widget {
+        int frame = 0;
+
+        void onPaint(ui::Canvas* c) override {
+            c->shadow(x() + 8, y() + 8, w() - 16, h() - 16, 6, 8, ui::color(0, 0, 0, 160));
+            c->solid(ui::color(frame & 0xFF, (frame >> 8) & 0xFF, 96, 255));
+            c->rrect(x() + 8, y() + 8, w() - 16, h() - 16, 6);
+        }
+
+        void step() { frame++, invalidate(); }
+    };
+}
+
+void* operator new(std::size_t size)
+{
+    if (counting.load(std::memory_order_relaxed))
+        allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+
+// GCC inlines these into callers of its own operator new and then reports free on a new'd pointer,
+// the replaced operator new above allocates with malloc so the pair does match.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, std::size_t) noexcept { std::free(p); }
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> fonts = { "C:/Windows/Fonts/calibri.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", "/System/Library/Fonts/Supplemental/Arial.ttf" };
+    int warmup = 4000, frames = 4000;
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--font") && i + 1 < argc) fonts = { argv[++i] };
+        else if (!std::strcmp(argv[i], "--warmup") && i + 1 < argc) warmup = (std::max)(0, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--frames") && i + 1 < argc) frames = (std::max)(1, std::atoi(argv[++i]));
+    }
+    for (auto const& f : fonts) {
+        if (std::ifstream(f, std::ios::binary).good()) {
+            uf::LoadGlobal(f, 48);
+            break;
+        }
+    }
+    if (!uf::gLoaded) {
+        std::fprintf(stderr, "no font found, pass --font path\n");
+        return 1;
+    }
+
+    constexpr int kWidth = 1280, kHeight = 800;
+    ui::Canvas canvas(std::make_shared<ui::ImageAtlas>(), std::make_shared<ui::ImageAtlas>());
+
+    // a static clipped list beside columns that each hold a pulse, so both replay and recapture run
+    ui::HLayout root;
+    auto list = root.addChild<ui::VLayout>();
+    list->setClipsChildren(true);
+    for (int i = 0; i < 200; i++)
+        list->addChild<ui::Label>("Row " + std::to_string(i))->setFixedH(24);
+    std::vector<Pulse*> pulses;
+    for (int c = 0; c < 4; c++) {
+        auto column = root.addChild<ui::VLayout>();
+        column->setClipsChildren(true);
+        for (int i = 0; i < 8; i++)
+            column->addChild<ui::Label>("Cell " + std::to_string(c) + " " + std::to_string(i));
+        pulses.push_back(column->addChild<Pulse>());
+    }
+
+    // phase: 0 changes, 1 layout, 2 paint, 3 packet with damage, and bins, 4 clear
+    size_t phases[5] = {}, objects = 0;
+    auto frame = [&](bool count) {
+        auto phase = [&](int i, auto&& f) {
+            counting = count;
+            size_t before = allocations;
+            f();
+            phases[i] += allocations - before;
+            counting = false;
+        };
+        phase(0, [&] { for (auto p : pulses) p->step(); });
+        phase(1, [&] { root.layout(0, 0, kWidth, kHeight), root.postLayout(); });
+        phase(2, [&] { canvas.setViewport(0, 0, kWidth, kHeight), root.paint(&canvas); });
+        phase(3, [&] { objects = canvas.data().size(), canvas.bins(); });
+        phase(4, [&] { canvas.clear(); });
+    };
+
+    for (int i = 0; i < warmup; i++)
+        frame(false);
+    size_t records = canvas.paints.records();
+    for (int i = 0; i < frames; i++)
+        frame(true);
+
+    size_t total = phases[0] + phases[1] + phases[2] + phases[3] + phases[4];
+    std::printf("%d frames of %zu objects, paint records %zu after warm up and %zu after, %zu replays\n", frames, objects, records, canvas.paints.records(), canvas.replays());
+    std::printf("allocations: changes %zu, layout %zu, paint %zu, packet %zu, clear %zu, total %zu\n", phases[0], phases[1], phases[2], phases[3], phases[4], total);
+    return total ? 1 : 0;
+}
@@ -0,0 +1,144 @@
+// Checks the block compressors against decompress_image.
+//
+//   compress
+//
+// Three synthetic images, a gradient, a photo-like mix of smooth shapes and grain, and a disc
+// with a hard alpha edge, go through BC1, BC4 and BC7 and back. Each format must keep a minimum
+// PSNR on each image, and a solid colour must encode to the exact block bytes the formats define
+// and decode to the colour those bytes hold.
+// The sizes are not multiples of 4 so partial edge blocks are covered. Prints one line per check
+// and exits non-zero when any fails.
+
+#include "../src/ui/util/compress.hpp"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+namespace {
+    constexpr int kWidth = 127, kHeight = 93;
+
+    struct Image {
+        char const* name;
+        std::vector<uint8_t> rgba;
+    };
+
+    Image gradient() {
+        Image img{ "gradient", std::vector<uint8_t>(size_t(kWidth) * kHeight * 4) };
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                uint8_t* p = img.rgba.data() + (size_t(y) * kWidth + x) * 4;
+                p[0] = uint8_t(x * 255 / (kWidth - 1)), p[1] = uint8_t(y * 255 / (kHeight - 1));
+                p[2] = uint8_t(255 - p[0] / 2), p[3] = uint8_t((p[0] + p[1]) / 2);
+            }
+        }
+        return img;
+    }
+
+    Image photo() {
+        Image img{ "photo", std::vector<uint8_t>(size_t(kWidth) * kHeight * 4) };
+        uint32_t seed = 1;
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                seed = seed * 1664525u + 1013904223u;
+                int grain = int(seed >> 28) - 8;
+                float sky = 0.5f + 0.5f * std::sin(x * 0.05f) * std::cos(y * 0.07f);
+                bool hill = y > kHeight / 2 + 12 * std::sin(x * 0.1f);
+                uint8_t* p = img.rgba.data() + (size_t(y) * kWidth + x) * 4;
+                int r = hill ? 60 + int(40 * sky) : 120 + int(100 * sky);
+                int g = hill ? 110 + int(50 * sky) : 150 + int(80 * sky);
+                int b = hill ? 40 : 200 + int(50 * sky);
+                p[0] = uint8_t(std::clamp(r + grain, 0, 255)), p[1] = uint8_t(std::clamp(g + grain, 0, 255));
+                p[2] = uint8_t(std::clamp(b + grain, 0, 255)), p[3] = 255;
+            }
+        }
+        return img;
+    }
+
+    Image alphaEdge() {
+        Image img{ "alpha edge", std::vector<uint8_t>(size_t(kWidth) * kHeight * 4) };
+        for (int y = 0; y < kHeight; y++) {
+            for (int x = 0; x < kWidth; x++) {
+                float dx = x - kWidth / 2.0f, dy = y - kHeight / 2.0f;
+                bool inside = dx * dx + dy * dy < 40.0f * 40.0f;
+                uint8_t* p = img.rgba.data() + (size_t(y) * kWidth + x) * 4;
+                p[0] = 230, p[1] = uint8_t(60 + x), p[2] = 40, p[3] = inside ? 255 : 0;
+            }
+        }
+        return img;
+    }
+
+    // The first c channels of every pixel.
+    std::vector<uint8_t> channels(std::vector<uint8_t> const& rgba, int c) {
+        std::vector<uint8_t> out;
+        out.reserve(rgba.size() / 4 * c);
+        for (size_t i = 0; i < rgba.size(); i += 4)
+            out.insert(out.end(), rgba.begin() + i, rgba.begin() + i + c);
+        return out;
+    }
+
+    struct Format {
+        char const* name;
+        ui::eCompression format;
+        int channels;
+        double minPsnr[3]; // gradient, photo, alpha edge
+    };
+}
+
+int main()
+{
+    Format const formats[] = {
+        { "BC1", ui::fBC1, 3, { 38.0, 36.0, 44.0 } },
+        { "BC4", ui::fBC4, 1, { 45.0, 42.0, 45.0 } },
+        { "BC7", ui::fBC7, 4, { 42.0, 44.0, 50.0 } },
+    };
+    Image const images[] = { gradient(), photo(), alphaEdge() };
+
+    int failed = 0;
+    for (auto const& f : formats) {
+        for (int i = 0; i < 3; i++) {
+            auto src = channels(images[i].rgba, f.channels);
+            auto compressed = ui::compress_image(src, kWidth, kHeight, f.channels, f.format);
+            double db = ui::psnr(src, ui::decompress_image(compressed, f.channels));
+            bool ok = compressed.blocks.size() == size_t(compressed.blocksX()) * compressed.blocksY() * ui::block_bytes(f.format) && db >= f.minPsnr[i];
+            failed += !ok;
+            std::printf("%s %-10s %6.2f dB, at least %.0f %s\n", f.name, images[i].name, db, f.minPsnr[i], ok ? "ok" : "FAILED");
+        }
+    }
+
+    // solid (200, 100, 50, 255) as one 4x4 block, with the exact bytes and the pixel they decode to
+    struct Solid {
+        char const* name;
+        ui::eCompression format;
+        int channels;
+        std::vector<uint8_t> bytes, decoded;
+    };
+    Solid const solids[] = {
+        // both endpoints 565 (24, 25, 6) = 0xC326, every index 0
+        { "BC1", ui::fBC1, 3, { 0x26, 0xC3, 0x26, 0xC3, 0, 0, 0, 0 }, { 198, 101, 49 } },
+        // both endpoints 200, every index 0
+        { "BC4", ui::fBC4, 1, { 200, 200, 0, 0, 0, 0, 0, 0 }, { 200 } },
+        // mode 6, both endpoints (100, 50, 25, 127) with p-bit 0, every index 0. The p-bit is shared by
+        // the channels, so alpha loses its low bit rather than the three colour channels theirs.
+        { "BC7", ui::fBC7, 4, { 0x40, 0x32, 0x59, 0x26, 0xCB, 0x64, 0xFE, 0x7F, 0, 0, 0, 0, 0, 0, 0, 0 }, { 200, 100, 50, 254 } },
+    };
+    std::vector<uint8_t> solid;
+    for (int i = 0; i < 16; i++)
+        solid.insert(solid.end(), { 200, 100, 50, 255 });
+    for (auto const& s : solids) {
+        auto compressed = ui::compress_image(channels(solid, s.channels), 4, 4, s.channels, s.format);
+        auto decoded = ui::decompress_image(compressed, s.channels);
+        bool ok = compressed.blocks == s.bytes;
+        for (size_t i = 0; i < decoded.size(); i++)
+            ok &= decoded[i] == s.decoded[i % s.channels];
+        failed += !ok;
+        std::printf("%s solid     ", s.name);
+        for (uint8_t b : compressed.blocks)
+            std::printf(" %02X", b);
+        std::printf(" %s\n", ok ? "ok" : "FAILED");
+    }
+
+    std::printf("%d checks failed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,101 @@
+// Checks the damage Canvas::data() reports between consecutive frames.
+//
+//   damage
+//
+// Frames of solid rects are recorded straight into a Canvas. Each step changes the scene one way,
+// a moved, added, removed or recoloured rect, or many rects moved at once, and the packet's damage
+// must be exactly the rects that changed: both positions of a moved rect, the bounds of an added or
+// removed one, and above DamageTracker::kMaxRects rects a single rect bounding them all. Prints one
+// line per step and exits non-zero when any differs.
+
+#include "../src/ui/util/canvas.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdio>
+#include <vector>
+
+namespace {
+    constexpr int kWidth = 400, kHeight = 300;
+
+    struct Box {
+        int x, y, w, h;
+        ui::color c;
+    };
+
+    using Rects = std::vector<std::array<int, 4>>;
+
+    Rects frame(ui::Canvas& canvas, std::vector<Box> const& boxes) {
+        canvas.setViewport(0, 0, kWidth, kHeight);
+        for (auto const& b : boxes) {
+            canvas.solid(b.c);
+            canvas.rect(float(b.x), float(b.y), float(b.w), float(b.h));
+        }
+        Rects damage = canvas.data().damage->rects;
+        canvas.clear();
+        return damage;
+    }
+
+    // Same rects in any order.
+    bool same(Rects a, Rects b) {
+        std::sort(a.begin(), a.end()), std::sort(b.begin(), b.end());
+        return a == b;
+    }
+
+    int failed = 0;
+
+    void check(char const* name, Rects const& damage, Rects const& expected) {
+        bool ok = same(damage, expected);
+        failed += !ok;
+        std::printf("%-36s %zu rects %s\n", name, damage.size(), ok ? "ok" : "FAILED");
+        if (!ok) {
+            for (auto const& r : damage)
+                std::printf("    got %d %d %d %d\n", r[0], r[1], r[2], r[3]);
+            for (auto const& r : expected)
+                std::printf("    expected %d %d %d %d\n", r[0], r[1], r[2], r[3]);
+        }
+    }
+}
+
+int main()
+{
+    ui::Canvas canvas(std::make_shared<ui::ImageAtlas>(), std::make_shared<ui::ImageAtlas>());
+    ui::color grey(90, 90, 90, 255), red(200, 40, 40, 255), blue(40, 40, 200, 255);
+
+    std::vector<Box> boxes = { { 0, 0, kWidth, kHeight, grey }, { 10, 10, 20, 20, red }, { 200, 100, 40, 30, blue } };
+    check("first frame damages the viewport", frame(canvas, boxes), { { 0, 0, kWidth, kHeight } });
+    check("unchanged frame is empty", frame(canvas, boxes), {});
+
+    boxes[1].x = 100, boxes[1].y = 50;
+    check("moved rect damages both positions", frame(canvas, boxes), { { 10, 10, 20, 20 }, { 100, 50, 20, 20 } });
+
+    boxes.push_back({ 300, 200, 50, 60, red });
+    check("added rect damages its bounds", frame(canvas, boxes), { { 300, 200, 50, 60 } });
+
+    boxes.erase(boxes.begin() + 2);
+    check("removed rect damages its old bounds", frame(canvas, boxes), { { 200, 100, 40, 30 } });
+
+    // the old and the new object are both unmatched, each adds the same rect
+    boxes[1].c = blue;
+    check("recoloured rect damages its bounds", frame(canvas, boxes), { { 100, 50, 20, 20 }, { 100, 50, 20, 20 } });
+
+    // 8 moved rects are 16 damage rects, still kept apart
+    std::vector<Box> row = { boxes[0] };
+    for (int i = 0; i < 17; i++)
+        row.push_back({ 10 + i * 20, 250, 10, 10, red });
+    frame(canvas, row);
+    Rects expected;
+    for (int i = 1; i <= 8; i++) {
+        expected.push_back({ row[i].x, 250, 10, 10 }), expected.push_back({ row[i].x, 240, 10, 10 });
+        row[i].y = 240;
+    }
+    check("16 rects are kept", frame(canvas, row), expected);
+
+    // all 17 moved are 34 damage rects, collapsed to their bounding rect
+    for (int i = 1; i <= 17; i++)
+        row[i].y = 20;
+    check("17 moved rects collapse to one", frame(canvas, row), { { 10, 20, 16 * 20 + 10, 240 } });
+
+    std::printf("%d checks failed\n", failed);
+    return failed ? 1 : 0;
+}
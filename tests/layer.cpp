@@ -0,0 +1,83 @@
+// Checks that a subtree cached as a layer composites to what drawing it directly gives.
+//
+//   layer
+//
+// A grey background is drawn directly and a cached panel over it holds only translucent content,
+// a 50% white rect and an opaque rrect whose antialiased edge is translucent too, so every pixel
+// the layer touches goes through the layer's alpha. The frame is rasterized once with layers off
+// and once compositing the layer, and every channel must agree within the rounding of blending
+// twice. Exits non-zero when a pixel differs by more or the layer is never composited.
+
+#include "../src/ui/util/widget.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+namespace {
+    constexpr int kWidth = 320, kHeight = 200, kTolerance = 2;
+
+    struct Background : ui::Widget {
+        void onPaint(ui::Canvas* c) override {
+            c->solid(ui::color(26, 26, 26, 255));
+            c->rect(x(), y(), w(), h());
+        }
+
+        void onLayout(int x, int y, int w, int h) override {
+            for (auto& ch : children())
+                ch->layout(x + 40, y + 30, w - 80, h - 60);
+        }
+    };
+
+    struct Panel : ui::Widget {
+        void onPaint(ui::Canvas* c) override {
+            c->solid(ui::color(255, 255, 255, 128));
+            c->rect(x() + 10, y() + 10, 100, 60);
+            c->solid(ui::color(200, 80, 40, 255));
+            c->rrect(x() + 120, y() + 20, 90, 90, 30);
+        }
+    };
+
+    std::vector<uint32_t> frame(ui::Widget& root, ui::Canvas& canvas, ui::Rasterizer& raster) {
+        root.layout(0, 0, kWidth, kHeight);
+        canvas.setViewport(0, 0, kWidth, kHeight);
+        root.paint(&canvas);
+        auto packet = canvas.data();
+        raster.render(packet, kWidth, kHeight, &canvas.tilePage);
+        canvas.clear();
+        return std::vector<uint32_t>(raster.pixels(), raster.pixels() + kWidth * kHeight);
+    }
+}
+
+int main()
+{
+    ui::Canvas canvas(std::make_shared<ui::ImageAtlas>(), std::make_shared<ui::ImageAtlas>());
+    ui::Rasterizer raster(canvas.maskAtlas, canvas.imageAtlas);
+
+    Background root;
+    auto panel = root.addChild<Panel>();
+    panel->setCacheAsLayer(true);
+
+    auto direct = frame(root, canvas, raster);
+
+    ui::LayerCache layers;
+    ui::Widget::layerCache = &layers;
+    frame(root, canvas, raster); // records the panel's list
+    auto layered = frame(root, canvas, raster);
+    ui::Widget::layerCache = nullptr;
+
+    int worst = 0, over = 0;
+    for (size_t i = 0; i < direct.size(); i++) {
+        int diff = 0;
+        for (int k = 0; k < 32; k += 8)
+            diff = (std::max)(diff, std::abs(int(direct[i] >> k & 0xFF) - int(layered[i] >> k & 0xFF)));
+        worst = (std::max)(worst, diff);
+        over += diff > kTolerance;
+    }
+
+    // inside the translucent rect, 50% white over 26 grey
+    uint32_t probe = layered[(30 + 40) * kWidth + 40 + 50];
+    std::printf("composites %zu, translucent rect %u (direct %u), largest difference %d, %d pixels over %d\n",
+        layers.composites(), probe & 0xFF, direct[(30 + 40) * kWidth + 40 + 50] & 0xFF, worst, over, kTolerance);
+    return layers.composites() == 0 || over > 0 ? 1 : 0;
+}
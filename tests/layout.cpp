@@ -0,0 +1,141 @@
+// Checks that incremental layout only lays out what changed and ends where a full layout ends.
+//
+//   layout
+//
+// A column holds a plain sibling, a fixed size panel and a fixed size Anchor holding a badge in
+// its bottom right corner.
+// Growing a widget inside the panel must lay out the panel's subtree and nothing beside or above
+// it; growing the badge must stay inside the Anchor too. After each change the tree runs frames,
+// layout() then postLayout() as Backend::update does, until nothing is left to lay out, and every
+// widget's rect must equal the rect in a fresh tree built in the final state and laid out from
+// scratch. The Anchor places its badge from onPostLayout with setFixedPos, so the geometry only
+// matches once postLayout has run. Prints one line per check and exits non-zero when any fails.
+
+#include "../src/ui/layout.hpp"
+#include "../src/ui/alignmnet.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+    int layouts = 0; // onLayout calls across every counted widget
+
+    template<typename Base>
+    struct Counted : Base {
+        int calls = 0;
+
+        template<typename... Args>
+        Counted(Args... args) : Base(args...) {}
+
+        void onLayout(int x, int y, int w, int h) override {
+            calls++, layouts++;
+            Base::onLayout(x, y, w, h);
+        }
+    };
+
+    // Wants contentW by contentH, like a label wants its text.
+    struct Content : Counted<ui::Widget> {
+        int contentW, contentH;
+
+        Content(int w, int h) : contentW(w), contentH(h) { setContentSize(); }
+
+        ui::SizeHint onMeasure(int, int) override { return { contentW, contentH, contentW, contentH }; }
+
+        void resize(int w, int h) { contentW = w, contentH = h, relayout(); }
+    };
+
+    struct Tree {
+        Counted<ui::VLayout> root;
+        Counted<ui::Widget>* sibling;
+        Counted<ui::VLayout>* panel;
+        Content* inner;
+        Counted<ui::Widget>* innerSibling;
+        Counted<ui::Anchor>* anchor;
+        Content* badge;
+
+        Tree(int innerH, int badgeW) {
+            sibling = root.addChild<Counted<ui::Widget>>();
+            panel = root.addChild<Counted<ui::VLayout>>();
+            panel->setFixedSize(300, 200);
+            inner = panel->addChild<Content>(120, innerH);
+            innerSibling = panel->addChild<Counted<ui::Widget>>();
+            anchor = root.addChild<Counted<ui::Anchor>>(ui::Anchor::BottomRight, ui::Anchor::BottomRight);
+            anchor->setFixedSize(400, 150);
+            badge = anchor->addChild<Content>(badgeW, 40);
+        }
+
+        // Frames until one lays nothing out, returns how many did.
+        int settle() {
+            for (int frames = 0; frames < 8; frames++) {
+                int before = layouts;
+                root.layout(0, 0, 800, 600);
+                root.postLayout();
+                if (layouts == before)
+                    return frames;
+            }
+            return -1;
+        }
+    };
+
+    void rects(ui::Widget* w, std::vector<ui::Rect>& out) {
+        out.push_back(w->rect());
+        for (auto& child : w->children())
+            rects(child.get(), out);
+    }
+
+    bool same(Tree& a, Tree& b) {
+        std::vector<ui::Rect> ra, rb;
+        rects(&a.root, ra), rects(&b.root, rb);
+        if (ra.size() != rb.size())
+            return false;
+        for (size_t i = 0; i < ra.size(); i++) {
+            if (ra[i].x != rb[i].x || ra[i].y != rb[i].y || ra[i].w != rb[i].w || ra[i].h != rb[i].h)
+                return false;
+        }
+        return true;
+    }
+
+    int failed = 0;
+
+    void check(char const* name, bool ok) {
+        failed += !ok;
+        std::printf("%-56s %s\n", name, ok ? "ok" : "FAILED");
+    }
+}
+
+int main()
+{
+    Tree tree(30, 100);
+    tree.settle();
+    check("the badge sits in the anchor's corner", tree.badge->x() == tree.anchor->x() + 300 && tree.badge->y() == tree.anchor->y() + 110);
+
+    int before = layouts;
+    tree.root.layout(0, 0, 800, 600);
+    tree.root.postLayout();
+    check("an idle frame lays nothing out", layouts == before);
+
+    int root = tree.root.calls, sibling = tree.sibling->calls, anchor = tree.anchor->calls, panel = tree.panel->calls;
+    tree.inner->resize(120, 60);
+    tree.settle();
+    check("the panel's subtree is laid out again", tree.panel->calls > panel);
+    check("its sibling, the anchor and the root are not", tree.root.calls == root && tree.sibling->calls == sibling && tree.anchor->calls == anchor);
+    {
+        Tree fresh(60, 100);
+        fresh.settle();
+        check("geometry equals a full layout", same(tree, fresh));
+    }
+
+    root = tree.root.calls, sibling = tree.sibling->calls, panel = tree.panel->calls, anchor = tree.anchor->calls;
+    int frames = (tree.badge->resize(180, 40), tree.settle());
+    check("the badge moves within the anchor", tree.anchor->calls > anchor && tree.root.calls == root && tree.sibling->calls == sibling && tree.panel->calls == panel);
+    check("the badge is back in the corner", tree.badge->x() == tree.anchor->x() + 220 && tree.badge->y() == tree.anchor->y() + 110);
+    {
+        Tree fresh(60, 180);
+        fresh.settle();
+        check("geometry equals a full layout after postLayout", same(tree, fresh));
+    }
+    std::printf("badge change settled in %d frames\n", frames);
+
+    std::printf("%d checks failed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,103 @@
+// Checks Widget::measure's memo, its invalidation and the fContent constraint that reads it.
+//
+//   measure
+//
+// A widget counting its onMeasure calls is measured again with the same and with other limits,
+// then marked through relayout() on itself and on a child, then laid out under content, fixed
+// and relative constraints inside a VLayout. Prints one line per check and exits non-zero when
+// any fails.
+
+#include "../src/ui/layout.hpp"
+
+#include <cstdio>
+
+namespace {
+    struct Counted : ui::Widget {
+        int contentW = 120, contentH = 30, calls = 0;
+
+        ui::SizeHint onMeasure(int maxW, int maxH) override {
+            calls++;
+            ui::SizeHint s = Widget::onMeasure(maxW, maxH);
+            s.minW = (std::max)(s.minW, contentW), s.w = (std::max)(s.w, contentW);
+            s.minH = (std::max)(s.minH, contentH), s.h = (std::max)(s.h, contentH);
+            return s;
+        }
+
+        void resize(int w, int h) { contentW = w, contentH = h, relayout(); }
+    };
+
+    int failed = 0;
+
+    void check(char const* name, bool ok) {
+        failed += !ok;
+        std::printf("%-44s %s\n", name, ok ? "ok" : "FAILED");
+    }
+}
+
+int main()
+{
+    {
+        Counted c;
+        c.measure(400, 300);
+        c.measure(400, 300);
+        check("same limits measure once", c.calls == 1);
+
+        c.measure(200, 300);
+        c.measure(400, 300);
+        c.measure(200, 300);
+        check("two limits alternating both hit", c.calls == 2);
+
+        c.measure(100, 100);
+        c.measure(400, 300);
+        check("a third limit evicts the oldest", c.calls == 4);
+    }
+
+    {
+        Counted c;
+        c.measure(400, 300);
+        c.resize(150, 40);
+        auto s = c.measure(400, 300);
+        check("relayout measures again", c.calls == 2 && s.w == 150 && s.h == 40);
+
+        ui::VLayout parent;
+        auto child = parent.addChild<Counted>();
+        parent.measure(400, 300);
+        int before = child->calls;
+        parent.measure(400, 300);
+        check("clean parent does not measure its child", child->calls == before);
+
+        child->resize(200, 50);
+        auto p = parent.measure(400, 300);
+        check("child relayout measures the parent again", child->calls == before + 1 && p.w == 200 && p.h == 50);
+    }
+
+    {
+        ui::VLayout column;
+        auto content = column.addChild<Counted>();
+        content->setContentSize();
+        auto fixed = column.addChild<Counted>();
+        fixed->setFixedSize(80, 20);
+        auto relative = column.addChild<Counted>();
+        relative->setRelativeW(0.5f), relative->setFixedH(10);
+        column.layout(0, 0, 400, 300);
+
+        check("fContent takes the measured size", content->w() == 120 && content->h() == 30);
+        check("fixed axes report their size", fixed->measure(400, 300).w == 80 && fixed->measure(400, 300).h == 20);
+        check("relative axes report their share", relative->measure(400, 300).w == 200);
+
+        int calls = content->calls;
+        column.layout(0, 0, 400, 300);
+        check("idle layout does not measure", content->calls == calls);
+
+        content->resize(60, 24);
+        column.layout(0, 0, 400, 300);
+        check("fContent follows a relayout", content->w() == 60 && content->h() == 24 && content->calls > calls);
+
+        calls = content->calls;
+        column.layout(0, 0, 400, 300);
+        check("and is memoized again after it", content->calls == calls);
+    }
+
+    std::printf("%d checks failed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,227 @@
+// Checks the 24 byte PackedObject upload form against the RenderObjects it is made from, and
+// measures what it saves on the demo's main screen.
+//
+//   packed [--font path]
+//
+// Every object Canvas records for each eType, with pens, gradients, clips and bounds on, must
+// decode to itself, and so must synthetic objects at the edges of each field's range: coordinates
+// at the int16 limits, indices at 0 and the largest 24 bit index, and -1. Values past a limit must
+// clamp the way packed.hpp documents. The main screen is main.cpp's widget tree laid out at
+// 800x600, its frame is encoded object by object and the upload sizes are printed. Exits non-zero
+// when any check fails.
+
+#include "../src/ui/layout.hpp"
+#include "../src/ui/label.hpp"
+#include "../src/ui/menu.hpp"
+#include "../src/ui/slider.hpp"
+#include "../src/ui/tab.hpp"
+#include "../src/ui/list.hpp"
+#include "../src/ui/checkbox.hpp"
+#include "../src/ui/tree.hpp"
+#include "../src/ui/splitter.hpp"
+
+#include <climits>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace {
+    int failures = 0;
+
+    bool same(ui::RenderObject const& a, ui::RenderObject const& b) {
+        return a.x == b.x && a.y == b.y && a.w == b.w && a.h == b.h && a.type == b.type &&
+            a.brushIndex == b.brushIndex && a.penIndex == b.penIndex && a.clipIndex == b.clipIndex &&
+            a.maskIndex == b.maskIndex && a.boundsIndex == b.boundsIndex && a.r1 == b.r1;
+    }
+
+    void check(char const* name, bool ok) {
+        if (!ok) {
+            std::printf("FAILED %s\n", name);
+            failures++;
+        }
+    }
+
+    // r2 is not carried, decode leaves it 0
+    void roundTrip(char const* name, ui::RenderObject ro) {
+        ro.r2 = 0;
+        check(name, same(ui::decode(ui::encode(ro)), ro));
+    }
+
+    ui::RenderObject object(int type) {
+        ui::RenderObject ro{};
+        ro.x = 10, ro.y = 20, ro.w = 30, ro.h = 40, ro.type = type, ro.r1 = 0, ro.r2 = 0;
+        return ro;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> fonts = { "C:/Windows/Fonts/calibri.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", "/System/Library/Fonts/Supplemental/Arial.ttf" };
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--font") && i + 1 < argc) fonts = { argv[++i] };
+    }
+    for (auto const& f : fonts) {
+        if (std::ifstream(f, std::ios::binary).good()) {
+            uf::LoadGlobal(f, 48);
+            break;
+        }
+    }
+    if (!uf::gLoaded) {
+        std::fprintf(stderr, "no font found, pass --font path\n");
+        return 1;
+    }
+
+    using C = ui::Canvas;
+    auto masks = std::make_shared<ui::ImageAtlas>(), images = std::make_shared<ui::ImageAtlas>();
+
+    // every type the canvas records, each drawn plain, stroked, through a gradient and half outside a clip
+    {
+        ui::Canvas canvas(masks, images);
+        uf::TextModel tm;
+        ui::Tile tile;
+        tile.w = tile.h = 16, tile.rgba.assign(16 * 16 * 4, 255);
+        auto region = canvas.place(1, tile);
+        check("tile page place", region.has_value());
+
+        auto draw = [&](int x, int y) {
+            canvas.rect(x, y, 40, 30);
+            canvas.rrect(x, y, 40, 30, 2, 4, 6, 8);
+            canvas.circle(x + 20, y + 20, 15);
+            canvas.ellipse(x, y, 40, 20);
+            canvas.line(x, y, x + 40, y + 30, 3);
+            canvas.text(tm, "Packed", 24, float(x), float(y), 120.0f, 30.0f);
+            if (region)
+                canvas.ninePatchTile(*region, x, y, 60, 40, { 4, 4, 4, 4 });
+        };
+        int row = 0;
+        for (int style = 0; style < 3; style++) {
+            for (int clipped = 0; clipped < 2; clipped++, row++) {
+                if (clipped)
+                    canvas.clip(0, row * 60, 100, 20);
+                for (int i = 0; i < 8; i++) {
+                    if (style == 0) canvas.solid(ui::col.white);
+                    if (style == 1) canvas.solid(ui::col.white), canvas.solid(ui::col.black, 2);
+                    if (style == 2) canvas.linear(ui::col.white, ui::col.black, 0, 0, 100, 0);
+                    draw(i * 12, row * 60);
+                }
+                if (clipped)
+                    canvas.unclip();
+            }
+        }
+
+        bool seen[16] = {}, pen = false, clip = false, r1 = false;
+        auto packet = canvas.data();
+        for (auto const& layer : packet.layers) {
+            for (auto const& ro : layer) {
+                seen[ro.type & 0xF] = true;
+                pen |= ro.penIndex >= 0, clip |= ro.clipIndex >= 0, r1 |= ro.r1 > 0;
+                roundTrip("recorded object", ro);
+            }
+        }
+        check("recorded pens, clips and r1 records", pen && clip && r1);
+        for (int type : { C::eRect, C::eRRect, C::eCircle, C::eEllipse, C::eLine, C::eTextRun, C::eNinePatch })
+            check(("recorded type " + std::to_string(type)).c_str(), seen[type]);
+    }
+
+    // eText is no longer recorded, synthetic objects cover it and every field of every type
+    for (int type = C::eText; type <= C::eNinePatch; type++) {
+        auto ro = object(type);
+        ro.brushIndex = 3, ro.penIndex = 7, ro.clipIndex = 11, ro.maskIndex = 13, ro.r1 = 17;
+        roundTrip("type with mask", ro);
+        ro.maskIndex = -1, ro.boundsIndex = 19;
+        roundTrip("type with bounds", ro);
+    }
+
+    // field ranges
+    for (int v : { -32768, -1, 0, 1, 32767 }) {
+        auto ro = object(C::eRect);
+        ro.x = ro.y = ro.w = ro.h = v;
+        roundTrip("int16 coordinate", ro);
+    }
+    {
+        auto ro = object(C::eRect);
+        ro.x = -40000, ro.y = 40000, ro.w = INT_MIN, ro.h = INT_MAX;
+        auto back = ui::decode(ui::encode(ro));
+        check("coordinates clamp", back.x == -32768 && back.y == 32767 && back.w == -32768 && back.h == 32767);
+    }
+    for (int v : { -1, 0, 1, 0xFFFF, 0x10000, 0xFFFFFE }) {
+        auto ro = object(C::eRRect);
+        ro.brushIndex = ro.penIndex = ro.clipIndex = ro.maskIndex = ro.r1 = v;
+        roundTrip("24 bit index with mask", ro);
+        ro.maskIndex = -1, ro.boundsIndex = v;
+        roundTrip("24 bit index with bounds", ro);
+    }
+    for (int type = 0; type < 16; type++)
+        roundTrip("4 bit type", object(type));
+    {
+        auto ro = object(C::eRect);
+        ro.maskIndex = 5, ro.boundsIndex = 9;
+        auto back = ui::decode(ui::encode(ro));
+        check("mask takes precedence over bounds", back.maskIndex == 5 && back.boundsIndex == -1);
+        ro.r2 = 123;
+        check("r2 is not carried", ui::decode(ui::encode(ro)).r2 == 0);
+    }
+
+    // main.cpp's main screen, built the same way without a window
+    {
+        ui::VLayout widget;
+        auto menuLayout = widget.addChild<ui::HLayout>();
+        menuLayout->setFixedH(50);
+        auto fileMenu = menuLayout->addChild<ui::Menu>("File", widget.id());
+        fileMenu->addItem("New", [](std::string) {});
+        fileMenu->addItem("Open", [](std::string) {});
+        fileMenu->addItem("Save", [](std::string) {});
+        auto saveAsMenu = fileMenu->addSubmenu("Save As");
+        saveAsMenu->addItem("PNG", [](std::string) {});
+        saveAsMenu->addItem("JPG", [](std::string) {});
+        menuLayout->addChild<ui::Menu>("Edit", widget.id());
+        menuLayout->addChild<ui::Menu>("View", widget.id());
+
+        widget.addChild<ui::Slider>([](float) {})->setFixedH(50);
+
+        auto tab = widget.addChild<ui::Tab>();
+        tab->addTab<ui::Label>("Tab 1", "This is the tab 1 content");
+        tab->addTab<ui::Label>("Tab 2", "This is the tab 2 content");
+        tab->addTab<ui::List>("List Tab", std::vector<std::string>{ "Banana", "Apple", "Orange" }, [](std::string const&) {});
+        auto cbg = tab->addTab<ui::CheckboxGroup>("Checkbox", std::vector<std::string>{ "Option 1", "option 2", "option 3" }, [](bool) {});
+        auto tree = tab->addTab<ui::Tree>("Tree", "Root");
+        tree->addItem("Root", "Child 1");
+        tree->addItem("Root", "Child 2");
+        tree->addItem("Child 2", "Child 4");
+        tree->addItem("Root", "Child 3");
+        auto s1 = tab->addTab<ui::VSplitter>("Splitter");
+        s1->setLeading<ui::BoxWidget>();
+        s1->setTrailing<ui::BoxWidget>();
+        cbg->setMultiSelect(true);
+
+        ui::Canvas canvas(masks, images);
+        widget.layout(0, 0, 800, 600);
+        widget.postLayout();
+        canvas.setViewport(0, 0, 800, 600);
+        widget.paint(&canvas);
+
+        auto packet = canvas.data();
+        std::vector<ui::PackedObject> packed;
+        for (auto const& layer : packet.layers) {
+            size_t first = packed.size();
+            packed.resize(first + layer.size());
+            ui::encode(layer.data(), layer.size(), packed.data() + first);
+            for (size_t i = 0; i < layer.size(); i++) {
+                ui::RenderObject ro = layer[i];
+                ro.r2 = 0;
+                check("main screen object", same(ui::decode(packed[first + i]), ro));
+            }
+        }
+
+        size_t objects = packet.size(), data = packet.data.size() * sizeof(int), paints = packet.paints.size() * sizeof(int);
+        size_t wide = objects * sizeof(ui::RenderObject) + data + paints, narrow = objects * sizeof(ui::PackedObject) + data + paints;
+        std::printf("main screen 800x600: %zu objects, %zu data bytes, %zu paint bytes\n", objects, data, paints);
+        std::printf("  objects as RenderObject %zu bytes, as PackedObject %zu bytes\n", objects * sizeof(ui::RenderObject), objects * sizeof(ui::PackedObject));
+        std::printf("  whole frame %zu bytes wide, %zu packed, %.1f%% less\n", wide, narrow, wide ? 100.0 * (wide - narrow) / wide : 0.0);
+    }
+
+    std::printf("%s\n", failures ? "packed checks FAILED" : "packed checks passed");
+    return failures ? 1 : 0;
+}
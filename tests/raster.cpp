@@ -0,0 +1,87 @@
+// Checks exact framebuffer values from the Rasterizer's blending.
+//
+//   raster
+//
+// Each scene is a background and one or two solid rects whose blended value is worked out by hand
+// from the blend the Rasterizer documents: a = alpha + (alpha >> 7), channel = (src * a + dst *
+// (256 - a)) >> 8, alpha taking the source as opaque. Every scene is drawn with its rects 3 pixels
+// wide, which the scalar tail of the blend loop handles alone, and 16 pixels wide, which the SSE2
+// loop handles alone when the build has it. Prints one line per scene and width and exits non-zero
+// when any pixel differs.
+
+#include "../src/ui/util/raster.hpp"
+
+#include <cstdio>
+#include <vector>
+
+namespace {
+    constexpr int kWidth = 64, kHeight = 32;
+
+    struct Scene {
+        char const* name;
+        ui::color clear;
+        std::vector<ui::color> fills; // drawn in order over the same rect
+        uint8_t expected[4];          // r, g, b, a inside the rect
+    };
+
+    int failed = 0;
+
+    void run(Scene const& scene, int width) {
+        ui::Canvas canvas(std::make_shared<ui::ImageAtlas>(), std::make_shared<ui::ImageAtlas>());
+        ui::Rasterizer raster(canvas.maskAtlas, canvas.imageAtlas);
+        raster.setClearColor(scene.clear);
+
+        canvas.setViewport(0, 0, kWidth, kHeight);
+        for (auto const& c : scene.fills) {
+            canvas.solid(c);
+            canvas.rect(8, 8, float(width), 16);
+        }
+        auto packet = canvas.data();
+        raster.render(packet, kWidth, kHeight);
+
+        // every pixel of the rect, and the clear colour just outside it
+        bool ok = true;
+        uint32_t clear = uint32_t(scene.clear.r) | uint32_t(scene.clear.g) << 8 | uint32_t(scene.clear.b) << 16 | uint32_t(scene.clear.a) << 24;
+        for (int y = 8; y < 24; y++) {
+            for (int x = 8; x < 8 + width; x++) {
+                uint32_t p = raster.pixels()[y * kWidth + x];
+                for (int k = 0; k < 4; k++)
+                    ok &= uint8_t(p >> (8 * k)) == scene.expected[k];
+            }
+            ok &= raster.pixels()[y * kWidth + 7] == clear && raster.pixels()[y * kWidth + 8 + width] == clear;
+        }
+
+        uint32_t p = raster.pixels()[16 * kWidth + 8];
+        failed += !ok;
+        std::printf("%-36s %2d wide  %3u %3u %3u %3u  %s\n", scene.name, width, p & 0xFF, p >> 8 & 0xFF, p >> 16 & 0xFF, p >> 24, ok ? "ok" : "FAILED");
+    }
+}
+
+int main()
+{
+    Scene const scenes[] = {
+        // a = 256, the source replaces the background
+        { "opaque red over black", ui::color(0, 0, 0, 255), { ui::color(255, 0, 0, 255) }, { 255, 0, 0, 255 } },
+        // a = 129: (255 * 129 + 26 * 127) >> 8 = 141
+        { "50% white over grey 26", ui::color(26, 26, 26, 255), { ui::color(255, 255, 255, 128) }, { 141, 141, 141, 255 } },
+        // a = 64: red 255 * 192 >> 8 = 191, blue 255 * 64 >> 8 = 63
+        { "25% blue over red", ui::color(255, 0, 0, 255), { ui::color(0, 0, 255, 64) }, { 191, 0, 63, 255 } },
+        // colour and alpha both 255 * 129 >> 8 = 128, the framebuffer holds colour times coverage
+        { "50% white over transparent", ui::color(0, 0, 0, 0), { ui::color(255, 255, 255, 128) }, { 128, 128, 128, 128 } },
+        // 141 as above, then a = 64: (141 * 192) >> 8 = 105, (255 * 64 + 141 * 192) >> 8 = 169
+        { "25% blue over 50% white over grey", ui::color(26, 26, 26, 255), { ui::color(255, 255, 255, 128), ui::color(0, 0, 255, 64) }, { 105, 105, 169, 255 } },
+    };
+
+#ifdef UI_RASTER_SSE2
+    std::printf("SSE2 blend built in\n");
+#else
+    std::printf("scalar blend only\n");
+#endif
+    for (auto const& scene : scenes) {
+        run(scene, 3);
+        run(scene, 16);
+    }
+
+    std::printf("%d checks failed\n", failed);
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,128 @@
+// Checks that retained painting draws what a full re-record draws after the programmatic changes
+// widgets make through their setters.
+//
+//   retained [--font path]
+//
+// Every step changes one widget through its public API, paints a frame that replays whatever is
+// still clean, then marks every widget dirty and paints the same state again. The two packets must
+// match object for object. ImageView is left out, its tiles arrive from the WorkerPool so two
+// paints of the same state can differ. Prints one line per step and exits non-zero when any step
+// differs.
+
+#include "../src/ui/layout.hpp"
+#include "../src/ui/label.hpp"
+#include "../src/ui/checkbox.hpp"
+#include "../src/ui/combobox.hpp"
+#include "../src/ui/scroll.hpp"
+#include "../src/ui/tab.hpp"
+#include "../src/ui/tree.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace {
+    constexpr int kWidth = 1280, kHeight = 800;
+
+    struct Frame {
+        std::vector<ui::RenderObject> objects;
+        std::vector<int> data, paints;
+
+        bool operator==(Frame const& o) const {
+            return objects.size() == o.objects.size() && data == o.data && paints == o.paints &&
+                std::memcmp(objects.data(), o.objects.data(), objects.size() * sizeof(ui::RenderObject)) == 0;
+        }
+    };
+
+    Frame paint(ui::Widget& root, ui::Canvas& canvas) {
+        root.layout(0, 0, kWidth, kHeight);
+        root.postLayout();
+        canvas.setViewport(0, 0, kWidth, kHeight);
+        root.paint(&canvas);
+
+        Frame f;
+        auto packet = canvas.data();
+        for (auto const& layer : packet.layers)
+            f.objects.insert(f.objects.end(), layer.begin(), layer.end());
+        f.data.assign(packet.data.begin(), packet.data.end());
+        f.paints.assign(packet.paints.begin(), packet.paints.end());
+        canvas.clear();
+        return f;
+    }
+
+    void invalidateAll(ui::Widget* w) {
+        w->invalidate();
+        for (auto& child : w->children())
+            invalidateAll(child.get());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<std::string> fonts = { "C:/Windows/Fonts/calibri.ttf", "/usr/share/fonts/truetype/dejavu/DejaVuSans.ttf", "/System/Library/Fonts/Supplemental/Arial.ttf" };
+    for (int i = 1; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--font") && i + 1 < argc) fonts = { argv[++i] };
+    }
+    for (auto const& f : fonts) {
+        if (std::ifstream(f, std::ios::binary).good()) {
+            uf::LoadGlobal(f, 48);
+            break;
+        }
+    }
+    if (!uf::gLoaded) {
+        std::fprintf(stderr, "no font found, pass --font path\n");
+        return 1;
+    }
+
+    ui::Canvas canvas(std::make_shared<ui::ImageAtlas>(), std::make_shared<ui::ImageAtlas>());
+
+    ui::HLayout root;
+    auto left = root.addChild<ui::VLayout>();
+    auto label = left->addChild<ui::Label>("label");
+    auto checkbox = left->addChild<ui::Checkbox>("checkbox");
+    auto combo = left->addChild<ui::ComboBox>(std::vector<std::string>{ "one", "two", "three" });
+    auto scroll = left->addChild<ui::VScroll>();
+    auto rows = scroll->addChild<ui::VLayout>();
+    for (int i = 0; i < 20; i++)
+        rows->addChild<ui::Label>("row " + std::to_string(i))->setFixedH(24);
+
+    auto tab = root.addChild<ui::Tab>();
+    auto tree = tab->addTab<ui::Tree>("Tree", "root");
+    tree->addItem("root", "a");
+    tree->addItem("root", "b");
+    auto page = tab->addTab<ui::VLayout>("Page");
+    auto hidden = page->addChild<ui::Label>("on the second page");
+    tab->changeTab(0);
+
+    std::vector<std::pair<char const*, std::function<void()>>> steps = {
+        { "Label::setText", [&] { label->setText("label, changed"); } },
+        { "Checkbox::setSelected", [&] { checkbox->setSelected(true); } },
+        { "ComboBox::setSelectedIndex", [&] { combo->setSelectedIndex(2); } },
+        { "VScroll::setScrollOffset", [&] { scroll->setScrollOffset(-60); } },
+        { "VScroll::setScrollbarVisible", [&] { scroll->setScrollbarVisible(false); } },
+        { "Tree::addItem", [&] { tree->addItem("a", "a child"); } },
+        { "Tree::selectItem", [&] { tree->selectItem("b"); } },
+        { "Tree::removeItem", [&] { tree->removeItem("b"); } },
+        { "Label::setText while hidden", [&] { hidden->setText("changed while hidden"); } },
+        { "Tab::changeTab", [&] { tab->changeTab(1); } },
+        { "Widget::setVisible", [&] { label->setVisible(false); } },
+        { "Widget::setClipsChildren", [&] { left->setClipsChildren(true); } },
+    };
+
+    paint(root, canvas);
+    int failed = 0;
+    for (auto const& [name, change] : steps) {
+        change();
+        Frame retained = paint(root, canvas);
+        invalidateAll(&root);
+        Frame recorded = paint(root, canvas);
+        bool same = retained == recorded;
+        failed += !same;
+        std::printf("%-32s %s, %zu objects\n", name, same ? "ok" : "DIFFERS", recorded.objects.size());
+    }
+    std::printf("%d of %zu steps differ, %zu replays\n", failed, steps.size(), canvas.replays());
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,126 @@
+// Replays a frame capture through the CPU passes of the renderer and reports their timings.
+//
+//   replay <capture> [--repeat n] [--source id] [--raster] [--png path]
+//
+// Damage, tile binning and draw ordering run on every frame. --raster adds the CPU rasterizer, text,
+// images and masks are skipped there since the capture carries no atlas pixels. --png writes the
+// last rasterized frame.
+
+#include "../src/ui/util/capture.hpp"
+#include "../src/ui/util/raster.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+namespace {
+    struct Timings {
+        std::vector<double> ms;
+
+        void print(char const* name) const {
+            if (ms.empty())
+                return;
+            std::vector<double> sorted = ms;
+            std::sort(sorted.begin(), sorted.end());
+            double total = 0.0;
+            for (double t : sorted)
+                total += t;
+            std::printf("%-8s min %8.3f  median %8.3f  mean %8.3f  max %8.3f ms\n", name, sorted.front(), sorted[sorted.size() / 2], total / sorted.size(), sorted.back());
+        }
+    };
+
+    template<typename F>
+    void timed(Timings& t, F&& f) {
+        auto start = std::chrono::steady_clock::now();
+        f();
+        t.ms.push_back(std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc < 2) {
+        std::fprintf(stderr, "usage: replay <capture> [--repeat n] [--source id] [--raster] [--png path]\n");
+        return 1;
+    }
+
+    int repeat = 1, source = -1;
+    bool raster = false;
+    std::string png;
+    for (int i = 2; i < argc; i++) {
+        if (!std::strcmp(argv[i], "--repeat") && i + 1 < argc) repeat = (std::max)(1, std::atoi(argv[++i]));
+        else if (!std::strcmp(argv[i], "--source") && i + 1 < argc) source = std::atoi(argv[++i]);
+        else if (!std::strcmp(argv[i], "--raster")) raster = true;
+        else if (!std::strcmp(argv[i], "--png") && i + 1 < argc) png = argv[++i], raster = true;
+    }
+
+    ui::CaptureReader capture;
+    if (!capture.load(argv[1])) {
+        std::fprintf(stderr, "%s is not a readable capture\n", argv[1]);
+        return 1;
+    }
+
+    size_t objects = 0, frames = 0;
+    for (auto const& f : capture.frames()) {
+        if (source < 0 || f.source == source)
+            objects += f.objects(), frames++;
+    }
+    std::printf("%zu frames, %zu objects, %zu glyphs, %zu mask and %zu image regions\n", frames, objects,
+        capture.glyphs().size() / ui::Canvas::kGlyphStride, capture.masks().regions.size(), capture.images().regions.size());
+    if (frames == 0)
+        return 0;
+
+    Timings damage, bins, order, rasterize;
+    std::map<int, ui::DamageTracker> trackers;
+    ui::TileBins tileBins;
+    ui::DrawOrder drawOrder;
+    std::vector<ui::PackedObject> packed;
+    ui::Rasterizer rasterizer(std::make_shared<ui::ImageAtlas>(), std::make_shared<ui::ImageAtlas>());
+    ui::CaptureFrame const* last = nullptr;
+
+    for (int r = 0; r < repeat; r++) {
+        trackers.clear();
+        for (auto const& f : capture.frames()) {
+            if (source >= 0 && f.source != source)
+                continue;
+
+            auto packet = f.packet();
+            auto ranges = packet.ranges();
+            auto& tracker = trackers[f.source];
+
+            timed(damage, [&] { tracker.compute(ranges.data(), ranges.size(), packet.data.data(), packet.paints.data(), f.width, f.height); });
+            timed(bins, [&] { tileBins.build(ranges.data(), ranges.size(), packet.data.data(), packet.paints.data(), f.width, f.height); });
+            timed(order, [&] {
+                drawOrder.build(ranges.data(), ranges.size(), packet.data.data(), packet.paints.data());
+                packed.resize(drawOrder.size());
+                drawOrder.encode(packed.data());
+            });
+
+            if (raster && f.width > 0 && f.height > 0) {
+                packet.damage = &tracker.damage();
+                packet.bins = &tileBins;
+                timed(rasterize, [&] { rasterizer.render(packet, f.width, f.height); });
+                last = &f;
+            }
+        }
+    }
+
+    damage.print("damage");
+    bins.print("bins");
+    order.print("order");
+    rasterize.print("raster");
+
+    if (!png.empty() && last) {
+        if (!rasterizer.savePng(png)) {
+            std::fprintf(stderr, "could not write %s\n", png.c_str());
+            return 1;
+        }
+        std::printf("wrote %dx%d frame to %s\n", last->width, last->height, png.c_str());
+    }
+    return 0;
+}